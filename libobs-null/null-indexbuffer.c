@@ -0,0 +1,68 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "null-subsystem.h"
+
+indexbuffer_t device_create_indexbuffer(device_t device,
+		enum gs_index_type type, void *indices, size_t num,
+		uint32_t flags)
+{
+	struct gs_index_buffer *ib = bzalloc(sizeof(struct gs_index_buffer));
+	size_t width = type == GS_UNSIGNED_LONG ? sizeof(uint32_t) :
+	                                         sizeof(uint16_t);
+
+	ib->device  = device;
+	ib->data    = indices;
+	ib->dynamic = (flags & GS_DYNAMIC) != 0;
+	ib->num     = num;
+	ib->width   = width;
+	ib->type    = type;
+	return ib;
+}
+
+void indexbuffer_destroy(indexbuffer_t ib)
+{
+	if (ib) {
+		if (ib->device->cur_index_buffer == ib)
+			ib->device->cur_index_buffer = NULL;
+
+		bfree(ib->data);
+		bfree(ib);
+	}
+}
+
+void indexbuffer_flush(indexbuffer_t ib)
+{
+	/* indices are read straight from the buffer's data */
+	if (!ib->dynamic)
+		blog(LOG_ERROR, "Index buffer is not dynamic");
+}
+
+void *indexbuffer_getdata(indexbuffer_t ib)
+{
+	return ib->data;
+}
+
+size_t indexbuffer_numindices(indexbuffer_t ib)
+{
+	return ib->num;
+}
+
+enum gs_index_type indexbuffer_gettype(indexbuffer_t ib)
+{
+	return ib->type;
+}
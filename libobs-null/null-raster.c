@@ -0,0 +1,1320 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <emmintrin.h>
+
+#include <graphics/vec2.h>
+#include <graphics/vec3.h>
+#include <graphics/vec4.h>
+#include "null-subsystem.h"
+
+/*
+ *   Software rasterizer for the libobs-software module.  Only what libobs
+ * itself draws is supported: triangles transformed by the default vertex
+ * shader (position times ViewProj, uv passed through), shaded by one of the
+ * programs matched in null-shader.c, into 32-bit RGBA/BGRA/BGRX render
+ * targets.  Conventions follow Direct3D: row 0 is the top of a texture,
+ * pixel centers are at +0.5, and edges use a top-left style tie rule.
+ *
+ *   Pixels are handled in spans of RGBA ordered texels, which are sampled,
+ * shaded, blended and stored with SSE2.  Sprites that stay axis aligned
+ * (almost everything libobs draws) use precomputed per-row and per-column
+ * filter taps rather than per-pixel interpolation, and large draws are split
+ * into bands of rows that are processed in parallel.
+ */
+
+#define SPAN_SIZE 256
+
+/* draws with fewer pixels than this are not split between threads */
+#define MIN_THREADED_PIXELS (128 * 128)
+
+/* weights sum to 256, so two weighted 8-bit texels fit 16 bits unsigned */
+#define WEIGHT_BITS 8
+#define WEIGHT_ONE  (1 << WEIGHT_BITS)
+
+/* avoids integer overflow for far out of range texture coordinates */
+#define MAX_TEXEL_COORD 1048576.0f
+
+#define WARN_TARGET_FORMAT  (1 << 0)
+#define WARN_TEXTURE_FORMAT (1 << 1)
+#define WARN_DRAW_MODE      (1 << 2)
+
+enum raster_blend {
+	BLEND_REPLACE,
+	BLEND_ALPHA,
+	BLEND_PREMULTIPLIED,
+	BLEND_GENERIC
+};
+
+struct raster_vert {
+	float x, y;
+	float u, v;
+};
+
+/* the two texels a column or row of pixels is filtered from */
+struct raster_tap {
+	uint32_t i0, i1;
+	uint16_t weight;
+};
+
+struct raster_edge {
+	float a, b, c;
+	bool  include_zero;
+};
+
+/* a single channel or RGBA texture read texel by texel */
+struct raster_plane {
+	const uint8_t        *data;
+	uint32_t             linesize;
+	uint32_t             width;
+	uint32_t             height;
+	uint32_t             bpp;
+};
+
+struct raster_draw {
+	enum null_program    program;
+
+	uint8_t              *dst;
+	uint32_t             dst_linesize;
+	uint32_t             dst_width;
+	bool                 dst_swap;
+	int                  clip_x0, clip_y0, clip_x1, clip_y1;
+
+	const uint8_t        *tex;
+	uint32_t             tex_linesize;
+	uint32_t             tex_width;
+	uint32_t             tex_height;
+	bool                 tex_swap;
+	bool                 tex_opaque;
+	bool                 linear;
+	enum gs_address_mode address_u;
+	enum gs_address_mode address_v;
+
+	/* columns of the color matrix, the last one scaled to 0-255 */
+	float                matrix[4][4];
+	struct vec4          color;
+	uint32_t             solid;
+
+	enum raster_blend    blend;
+	enum gs_blend_type   blend_src;
+	enum gs_blend_type   blend_dest;
+	uint32_t             write_mask;
+
+	/* pixels covered by the current rect or triangle bounds */
+	int                  x0, y0, x1, y1;
+
+	struct raster_tap    *cols;
+	struct raster_tap    *rows;
+	bool                 cols_point;
+	bool                 cols_direct;
+
+	struct raster_vert   tri[3];
+	struct raster_edge   edges[3];
+	float                area_i;
+
+	struct raster_plane  planes[3];
+};
+
+static inline void warn_once(struct gs_device *device, uint32_t warning,
+		const char *message)
+{
+	if ((device->raster_warnings & warning) == 0) {
+		device->raster_warnings |= warning;
+		blog(LOG_WARNING, "%s", message);
+	}
+}
+
+static inline int min_int(int a, int b)
+{
+	return a < b ? a : b;
+}
+
+static inline int max_int(int a, int b)
+{
+	return a > b ? a : b;
+}
+
+static inline bool is_rgba8_format(enum gs_color_format format)
+{
+	return format == GS_RGBA || format == GS_BGRA || format == GS_BGRX;
+}
+
+static inline uint32_t *get_dst_row(const struct raster_draw *draw, int y)
+{
+	return (uint32_t*)(draw->dst + (size_t)y * draw->dst_linesize);
+}
+
+/* ------------------------------------------------------------------------- */
+/* texel swizzling */
+
+static inline uint32_t swap_rb(uint32_t p)
+{
+	return (p & 0xFF00FF00) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16);
+}
+
+static void swap_rb_span(uint32_t *px, int count)
+{
+	const __m128i ga = _mm_set1_epi32((int)0xFF00FF00);
+	const __m128i lo = _mm_set1_epi32(0xFF);
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i p = _mm_loadu_si128((const __m128i*)(px + i));
+		__m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), lo);
+		__m128i b = _mm_slli_epi32(_mm_and_si128(p, lo), 16);
+
+		p = _mm_or_si128(_mm_and_si128(p, ga), _mm_or_si128(r, b));
+		_mm_storeu_si128((__m128i*)(px + i), p);
+	}
+
+	for (; i < count; i++)
+		px[i] = swap_rb(px[i]);
+}
+
+/* converts sampled texels to RGBA order */
+static inline void fix_texels(const struct raster_draw *draw, uint32_t *px,
+		int count)
+{
+	if (draw->tex_swap)
+		swap_rb_span(px, count);
+
+	if (draw->tex_opaque) {
+		for (int i = 0; i < count; i++)
+			px[i] |= 0xFF000000;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* sampling */
+
+static inline uint32_t apply_address(enum gs_address_mode mode, int i,
+		uint32_t size)
+{
+	int period;
+
+	switch (mode) {
+	case GS_ADDRESS_WRAP:
+		i %= (int)size;
+		return (uint32_t)(i < 0 ? i + (int)size : i);
+
+	case GS_ADDRESS_MIRROR:
+		period = (int)size * 2;
+		i %= period;
+		if (i < 0)
+			i += period;
+		return (uint32_t)(i < (int)size ? i : period - 1 - i);
+
+	default:
+		/* border and mirror-once are treated as clamp */
+		if (i < 0)
+			return 0;
+		return (uint32_t)i >= size ? size - 1 : (uint32_t)i;
+	}
+}
+
+/* coord is a normalized texture coordinate */
+static struct raster_tap make_tap(float coord, uint32_t size,
+		enum gs_address_mode mode, bool linear)
+{
+	struct raster_tap tap;
+	float texel = coord * (float)size;
+	float texel_floor;
+	int   i, weight;
+
+	if (texel < -MAX_TEXEL_COORD)
+		texel = -MAX_TEXEL_COORD;
+	else if (texel > MAX_TEXEL_COORD)
+		texel = MAX_TEXEL_COORD;
+
+	if (!linear) {
+		tap.i0 = tap.i1 = apply_address(mode, (int)floorf(texel), size);
+		tap.weight = 0;
+		return tap;
+	}
+
+	texel      -= 0.5f;
+	texel_floor = floorf(texel);
+	i           = (int)texel_floor;
+	weight      = (int)((texel - texel_floor) * WEIGHT_ONE + 0.5f);
+
+	if (weight == WEIGHT_ONE) {
+		weight = 0;
+		i++;
+	}
+
+	tap.i0     = apply_address(mode, i, size);
+	tap.i1     = apply_address(mode, i + 1, size);
+	tap.weight = (uint16_t)weight;
+	return tap;
+}
+
+static inline __m128i load_texel_pair(uint32_t a, uint32_t b)
+{
+	return _mm_unpacklo_epi8(_mm_set_epi32(0, 0, (int)b, (int)a),
+			_mm_setzero_si128());
+}
+
+/* (a * (WEIGHT_ONE - w) + b * w) / WEIGHT_ONE, on 16-bit channels */
+static inline __m128i lerp_texels(__m128i a, __m128i b, __m128i w)
+{
+	__m128i inv = _mm_sub_epi16(_mm_set1_epi16(WEIGHT_ONE), w);
+	__m128i sum = _mm_add_epi16(_mm_mullo_epi16(a, inv),
+			_mm_mullo_epi16(b, w));
+
+	sum = _mm_add_epi16(sum, _mm_set1_epi16(WEIGHT_ONE / 2));
+	return _mm_srli_epi16(sum, WEIGHT_BITS);
+}
+
+/* samples 'count' pixels of one row, two pixels at a time */
+static void sample_span(const struct raster_draw *draw,
+		const struct raster_tap *row, const struct raster_tap *cols,
+		uint32_t *out, int count)
+{
+	const uint32_t *r0 = (const uint32_t*)(draw->tex +
+			(size_t)row->i0 * draw->tex_linesize);
+	const uint32_t *r1 = (const uint32_t*)(draw->tex +
+			(size_t)row->i1 * draw->tex_linesize);
+	__m128i wy;
+
+	if (!row->weight && draw->cols_direct) {
+		memcpy(out, r0 + cols[0].i0, count * sizeof(uint32_t));
+		return;
+	}
+
+	if (!row->weight && draw->cols_point) {
+		for (int i = 0; i < count; i++)
+			out[i] = r0[cols[i].i0];
+		return;
+	}
+
+	wy = _mm_set1_epi16((short)row->weight);
+
+	for (int i = 0; i < count; i += 2) {
+		const struct raster_tap *a = cols + i;
+		const struct raster_tap *b = (i + 1 < count) ? a + 1 : a;
+		short wa = (short)a->weight;
+		short wb = (short)b->weight;
+		__m128i wx = _mm_set_epi16(wb, wb, wb, wb, wa, wa, wa, wa);
+		__m128i top, bottom;
+
+		top = lerp_texels(load_texel_pair(r0[a->i0], r0[b->i0]),
+				load_texel_pair(r0[a->i1], r0[b->i1]), wx);
+
+		if (row->weight) {
+			bottom = lerp_texels(
+				load_texel_pair(r1[a->i0], r1[b->i0]),
+				load_texel_pair(r1[a->i1], r1[b->i1]), wx);
+			top = lerp_texels(top, bottom, wy);
+		}
+
+		top = _mm_packus_epi16(top, top);
+		out[i] = (uint32_t)_mm_cvtsi128_si32(top);
+		if (i + 1 < count)
+			out[i + 1] = (uint32_t)_mm_cvtsi128_si32(
+					_mm_srli_si128(top, 4));
+	}
+}
+
+static inline uint32_t sample_point(const struct raster_draw *draw,
+		float u, float v)
+{
+	struct raster_tap col = make_tap(u, draw->tex_width, draw->address_u,
+			draw->linear);
+	struct raster_tap row = make_tap(v, draw->tex_height, draw->address_v,
+			draw->linear);
+	uint32_t texel;
+
+	sample_span(draw, &row, &col, &texel, 1);
+	return texel;
+}
+
+/* ------------------------------------------------------------------------- */
+/* shading */
+
+static inline __m128 unpack_float(uint32_t p)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i val  = _mm_cvtsi32_si128((int)p);
+
+	val = _mm_unpacklo_epi16(_mm_unpacklo_epi8(val, zero), zero);
+	return _mm_cvtepi32_ps(val);
+}
+
+/* rounds and saturates to 0-255 */
+static inline uint32_t pack_float(__m128 val)
+{
+	__m128i i = _mm_cvtps_epi32(val);
+	i = _mm_packs_epi32(i, i);
+	return (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(i, i));
+}
+
+static void shade_matrix(const struct raster_draw *draw, uint32_t *px,
+		int count)
+{
+	__m128 c0 = _mm_loadu_ps(draw->matrix[0]);
+	__m128 c1 = _mm_loadu_ps(draw->matrix[1]);
+	__m128 c2 = _mm_loadu_ps(draw->matrix[2]);
+	__m128 c3 = _mm_loadu_ps(draw->matrix[3]);
+
+	for (int i = 0; i < count; i++) {
+		__m128 val = unpack_float(px[i]);
+		__m128 r   = _mm_shuffle_ps(val, val, _MM_SHUFFLE(0, 0, 0, 0));
+		__m128 g   = _mm_shuffle_ps(val, val, _MM_SHUFFLE(1, 1, 1, 1));
+		__m128 b   = _mm_shuffle_ps(val, val, _MM_SHUFFLE(2, 2, 2, 2));
+		__m128 out;
+
+		out = _mm_add_ps(_mm_mul_ps(r, c0), _mm_mul_ps(g, c1));
+		out = _mm_add_ps(out, _mm_add_ps(_mm_mul_ps(b, c2), c3));
+		px[i] = pack_float(out);
+	}
+}
+
+static void shade_color(const struct raster_draw *draw, uint32_t *px,
+		int count)
+{
+	__m128 color = _mm_loadu_ps(draw->color.ptr);
+
+	for (int i = 0; i < count; i++)
+		px[i] = pack_float(_mm_mul_ps(unpack_float(px[i]), color));
+}
+
+/* ------------------------------------------------------------------------- */
+/* blending */
+
+/* rounded x / 255 for x <= 255 * 255, on 16-bit channels */
+static inline __m128i div255(__m128i x)
+{
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+static inline __m128i broadcast_alpha(__m128i p)
+{
+	p = _mm_shufflelo_epi16(p, _MM_SHUFFLE(3, 3, 3, 3));
+	return _mm_shufflehi_epi16(p, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+/* two pixels of src * src_alpha + dst * (1 - src_alpha) */
+static inline __m128i blend_alpha(__m128i s, __m128i d, bool premultiplied)
+{
+	__m128i a   = broadcast_alpha(s);
+	__m128i inv = _mm_sub_epi16(_mm_set1_epi16(255), a);
+
+	if (premultiplied)
+		return _mm_adds_epu16(s, div255(_mm_mullo_epi16(d, inv)));
+
+	return div255(_mm_add_epi16(_mm_mullo_epi16(s, a),
+				_mm_mullo_epi16(d, inv)));
+}
+
+static void blend_alpha_span(uint32_t *dst, uint32_t *src, int count,
+		bool premultiplied)
+{
+	const __m128i zero = _mm_setzero_si128();
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+		__m128i lo, hi;
+
+		lo = blend_alpha(_mm_unpacklo_epi8(s, zero),
+				_mm_unpacklo_epi8(d, zero), premultiplied);
+		hi = blend_alpha(_mm_unpackhi_epi8(s, zero),
+				_mm_unpackhi_epi8(d, zero), premultiplied);
+
+		_mm_storeu_si128((__m128i*)(src + i),
+				_mm_packus_epi16(lo, hi));
+	}
+
+	for (; i < count; i++) {
+		__m128i s = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)src[i]),
+				zero);
+		__m128i d = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)dst[i]),
+				zero);
+
+		s = blend_alpha(s, d, premultiplied);
+		src[i] = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(s, s));
+	}
+}
+
+static struct vec4 blend_factor(enum gs_blend_type type,
+		const struct vec4 *s, const struct vec4 *d)
+{
+	struct vec4 f;
+	float sat;
+
+	switch (type) {
+	case GS_BLEND_ZERO:        vec4_zero(&f); break;
+	case GS_BLEND_ONE:         vec4_set(&f, 1.0f, 1.0f, 1.0f, 1.0f); break;
+	case GS_BLEND_SRCCOLOR:    vec4_copy(&f, s); break;
+	case GS_BLEND_INVSRCCOLOR:
+		vec4_set(&f, 1.0f-s->x, 1.0f-s->y, 1.0f-s->z, 1.0f-s->w);
+		break;
+	case GS_BLEND_SRCALPHA:
+		vec4_set(&f, s->w, s->w, s->w, s->w);
+		break;
+	case GS_BLEND_INVSRCALPHA:
+		vec4_set(&f, 1.0f-s->w, 1.0f-s->w, 1.0f-s->w, 1.0f-s->w);
+		break;
+	case GS_BLEND_DSTCOLOR:    vec4_copy(&f, d); break;
+	case GS_BLEND_INVDSTCOLOR:
+		vec4_set(&f, 1.0f-d->x, 1.0f-d->y, 1.0f-d->z, 1.0f-d->w);
+		break;
+	case GS_BLEND_DSTALPHA:
+		vec4_set(&f, d->w, d->w, d->w, d->w);
+		break;
+	case GS_BLEND_INVDSTALPHA:
+		vec4_set(&f, 1.0f-d->w, 1.0f-d->w, 1.0f-d->w, 1.0f-d->w);
+		break;
+	case GS_BLEND_SRCALPHASAT:
+		sat = fminf(s->w, 1.0f - d->w);
+		vec4_set(&f, sat, sat, sat, 1.0f);
+		break;
+	default:
+		vec4_zero(&f);
+	}
+
+	return f;
+}
+
+static void blend_generic_span(const struct raster_draw *draw,
+		uint32_t *dst, uint32_t *src, int count)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+	const __m128 range = _mm_set1_ps(255.0f);
+
+	for (int i = 0; i < count; i++) {
+		struct vec4 s, d, fs, fd;
+
+		s.m = _mm_mul_ps(unpack_float(src[i]), scale);
+		d.m = _mm_mul_ps(unpack_float(dst[i]), scale);
+		fs  = blend_factor(draw->blend_src,  &s, &d);
+		fd  = blend_factor(draw->blend_dest, &s, &d);
+
+		s.m = _mm_add_ps(_mm_mul_ps(s.m, fs.m), _mm_mul_ps(d.m, fd.m));
+		src[i] = pack_float(_mm_mul_ps(s.m, range));
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Shades, blends and stores a span of sampled RGBA texels.  The texels are
+ * converted to the order of the render target first, which blending does
+ * not depend on.
+ */
+static void write_span(const struct raster_draw *draw, uint32_t *dst,
+		uint32_t *px, int count)
+{
+	if (draw->program == NULL_PROGRAM_DRAW_MATRIX)
+		shade_matrix(draw, px, count);
+	else if (draw->program == NULL_PROGRAM_DRAW_COLOR)
+		shade_color(draw, px, count);
+
+	if (draw->dst_swap)
+		swap_rb_span(px, count);
+
+	if (draw->blend == BLEND_ALPHA)
+		blend_alpha_span(dst, px, count, false);
+	else if (draw->blend == BLEND_PREMULTIPLIED)
+		blend_alpha_span(dst, px, count, true);
+	else if (draw->blend == BLEND_GENERIC)
+		blend_generic_span(draw, dst, px, count);
+
+	if (draw->write_mask == 0xFFFFFFFF) {
+		memcpy(dst, px, count * sizeof(uint32_t));
+	} else {
+		uint32_t mask = draw->write_mask;
+		for (int i = 0; i < count; i++)
+			dst[i] = (px[i] & mask) | (dst[i] & ~mask);
+	}
+}
+
+static inline void fill_span(uint32_t *px, uint32_t val, int count)
+{
+	for (int i = 0; i < count; i++)
+		px[i] = val;
+}
+
+static inline void run_rows(struct gs_device *device, slice_proc_t proc,
+		struct raster_draw *draw)
+{
+	uint32_t width  = (uint32_t)(draw->x1 - draw->x0);
+	uint32_t height = (uint32_t)(draw->y1 - draw->y0);
+
+	if (width * height >= MIN_THREADED_PIXELS)
+		slice_pool_run(device->raster_pool, proc, draw, height, 1);
+	else
+		proc(draw, 0, height);
+}
+
+/* ------------------------------------------------------------------------- */
+/* axis aligned rects */
+
+static void rect_rows(void *param, uint32_t start_y, uint32_t end_y)
+{
+	struct raster_draw *draw = param;
+	uint32_t span[SPAN_SIZE];
+	int width = draw->x1 - draw->x0;
+
+	for (uint32_t y = start_y; y < end_y; y++) {
+		uint32_t *dst = get_dst_row(draw, draw->y0 + (int)y) +
+			draw->x0;
+
+		for (int x = 0; x < width; x += SPAN_SIZE) {
+			int count = width - x;
+			if (count > SPAN_SIZE)
+				count = SPAN_SIZE;
+
+			if (draw->program == NULL_PROGRAM_SOLID) {
+				fill_span(span, draw->solid, count);
+			} else {
+				sample_span(draw, draw->rows + y,
+						draw->cols + x, span, count);
+				fix_texels(draw, span, count);
+			}
+
+			write_span(draw, dst + x, span, count);
+		}
+	}
+}
+
+static inline bool nearly_equal(float a, float b)
+{
+	return fabsf(a - b) < 0.001f;
+}
+
+/* returns true if a 4 vertex strip is a rect with an axis aligned mapping */
+static bool is_axis_aligned(const struct raster_vert *v)
+{
+	return nearly_equal(v[0].y, v[1].y) && nearly_equal(v[2].y, v[3].y) &&
+	       nearly_equal(v[0].x, v[2].x) && nearly_equal(v[1].x, v[3].x) &&
+	       nearly_equal(v[0].v, v[1].v) && nearly_equal(v[2].v, v[3].v) &&
+	       nearly_equal(v[0].u, v[2].u) && nearly_equal(v[1].u, v[3].u);
+}
+
+/* first covered pixel for an edge, as pixel centers are at +0.5 */
+static inline int first_pixel(float pos)
+{
+	return (int)ceilf(pos - 0.5f);
+}
+
+static void make_taps(struct raster_tap *taps, int start, int count,
+		float pos0, float pos1, float coord0, float coord1,
+		uint32_t size, enum gs_address_mode mode, bool linear)
+{
+	float scale = (coord1 - coord0) / (pos1 - pos0);
+
+	for (int i = 0; i < count; i++) {
+		float pos = (float)(start + i) + 0.5f;
+		float coord = coord0 + (pos - pos0) * scale;
+		taps[i] = make_tap(coord, size, mode, linear);
+	}
+}
+
+static void draw_rect(struct gs_device *device, struct raster_draw *draw,
+		const struct raster_vert *v)
+{
+	float x0 = v[0].x, x1 = v[1].x, u0 = v[0].u, u1 = v[1].u;
+	float y0 = v[0].y, y1 = v[2].y, v0 = v[0].v, v1 = v[2].v;
+	bool  sample = draw->program != NULL_PROGRAM_SOLID;
+	int   width, height;
+
+	if (x1 < x0) {
+		float t;
+		t = x0; x0 = x1; x1 = t;
+		t = u0; u0 = u1; u1 = t;
+	}
+	if (y1 < y0) {
+		float t;
+		t = y0; y0 = y1; y1 = t;
+		t = v0; v0 = v1; v1 = t;
+	}
+
+	draw->x0 = max_int(first_pixel(x0), draw->clip_x0);
+	draw->x1 = min_int(first_pixel(x1), draw->clip_x1);
+	draw->y0 = max_int(first_pixel(y0), draw->clip_y0);
+	draw->y1 = min_int(first_pixel(y1), draw->clip_y1);
+
+	width  = draw->x1 - draw->x0;
+	height = draw->y1 - draw->y0;
+	if (width <= 0 || height <= 0)
+		return;
+
+	if (sample) {
+		draw->cols = bmalloc(sizeof(struct raster_tap) * width);
+		draw->rows = bmalloc(sizeof(struct raster_tap) * height);
+
+		make_taps(draw->cols, draw->x0, width, x0, x1, u0, u1,
+				draw->tex_width, draw->address_u, draw->linear);
+		make_taps(draw->rows, draw->y0, height, y0, y1, v0, v1,
+				draw->tex_height, draw->address_v,
+				draw->linear);
+
+		/* unscaled columns are copied straight from the texture */
+		draw->cols_point  = true;
+		draw->cols_direct = true;
+		for (int i = 0; i < width; i++) {
+			const struct raster_tap *col = draw->cols + i;
+
+			if (col->weight)
+				draw->cols_point = false;
+			if (col->weight || (i && col->i0 != col[-1].i0 + 1))
+				draw->cols_direct = false;
+		}
+	}
+
+	run_rows(device, rect_rows, draw);
+
+	bfree(draw->cols);
+	bfree(draw->rows);
+	draw->cols = NULL;
+	draw->rows = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* triangles */
+
+static inline float eval_edge(const struct raster_edge *edge, float x,
+		float y)
+{
+	return edge->a * x + edge->b * y + edge->c;
+}
+
+static inline bool edge_inside(const struct raster_edge *edge, float val)
+{
+	return val > 0.0f || (val == 0.0f && edge->include_zero);
+}
+
+static void tri_rows(void *param, uint32_t start_y, uint32_t end_y)
+{
+	struct raster_draw *draw = param;
+	const struct raster_vert *v = draw->tri;
+	uint32_t span[SPAN_SIZE];
+
+	for (uint32_t y = start_y; y < end_y; y++) {
+		int   row = draw->y0 + (int)y;
+		float py  = (float)row + 0.5f;
+		uint32_t *dst = get_dst_row(draw, row);
+		int x = draw->x0;
+
+		while (x < draw->x1) {
+			int start = x;
+			int count = 0;
+
+			for (; x < draw->x1 && count < SPAN_SIZE; x++) {
+				float px = (float)x + 0.5f;
+				float e[3];
+				float u, tv;
+
+				for (int i = 0; i < 3; i++)
+					e[i] = eval_edge(draw->edges+i, px, py);
+
+				if (!edge_inside(draw->edges+0, e[0]) ||
+				    !edge_inside(draw->edges+1, e[1]) ||
+				    !edge_inside(draw->edges+2, e[2])) {
+					if (count)
+						break;
+					continue;
+				}
+
+				if (!count)
+					start = x;
+
+				if (draw->program == NULL_PROGRAM_SOLID) {
+					span[count++] = draw->solid;
+					continue;
+				}
+
+				u  = (e[0]*v[0].u + e[1]*v[1].u + e[2]*v[2].u)
+					* draw->area_i;
+				tv = (e[0]*v[0].v + e[1]*v[1].v + e[2]*v[2].v)
+					* draw->area_i;
+				span[count++] = sample_point(draw, u, tv);
+			}
+
+			if (!count)
+				continue;
+
+			if (draw->program != NULL_PROGRAM_SOLID)
+				fix_texels(draw, span, count);
+
+			write_span(draw, dst + start, span, count);
+		}
+	}
+}
+
+/* edge i is the one opposite vertex i, and is positive inside */
+static void make_edge(struct raster_edge *edge, const struct raster_vert *a,
+		const struct raster_vert *b)
+{
+	edge->a = a->y - b->y;
+	edge->b = b->x - a->x;
+	edge->c = -(edge->a * a->x + edge->b * a->y);
+}
+
+static void draw_triangle(struct gs_device *device, struct raster_draw *draw,
+		const struct raster_vert *v0, const struct raster_vert *v1,
+		const struct raster_vert *v2)
+{
+	float area;
+	float min_x, max_x, min_y, max_y;
+
+	draw->tri[0] = *v0;
+	draw->tri[1] = *v1;
+	draw->tri[2] = *v2;
+
+	make_edge(draw->edges+0, v1, v2);
+	make_edge(draw->edges+1, v2, v0);
+	make_edge(draw->edges+2, v0, v1);
+
+	area = eval_edge(draw->edges+0, v0->x, v0->y);
+	if (area == 0.0f)
+		return;
+
+	/* culling is not applied, so accept either winding */
+	for (int i = 0; i < 3; i++) {
+		struct raster_edge *edge = draw->edges+i;
+
+		if (area < 0.0f) {
+			edge->a = -edge->a;
+			edge->b = -edge->b;
+			edge->c = -edge->c;
+		}
+
+		/* shared edges face opposite ways, so only one side owns
+		 * pixel centers that lie exactly on them */
+		edge->include_zero = edge->a > 0.0f ||
+			(edge->a == 0.0f && edge->b > 0.0f);
+	}
+
+	draw->area_i = 1.0f / fabsf(area);
+
+	min_x = fminf(v0->x, fminf(v1->x, v2->x));
+	max_x = fmaxf(v0->x, fmaxf(v1->x, v2->x));
+	min_y = fminf(v0->y, fminf(v1->y, v2->y));
+	max_y = fmaxf(v0->y, fmaxf(v1->y, v2->y));
+
+	draw->x0 = max_int(first_pixel(min_x), draw->clip_x0);
+	draw->x1 = min_int(first_pixel(max_x) + 1, draw->clip_x1);
+	draw->y0 = max_int(first_pixel(min_y), draw->clip_y0);
+	draw->y1 = min_int(first_pixel(max_y) + 1, draw->clip_y1);
+
+	if (draw->x1 <= draw->x0 || draw->y1 <= draw->y0)
+		return;
+
+	draw->cols_point  = !draw->linear;
+	draw->cols_direct = false;
+	run_rows(device, tri_rows, draw);
+}
+
+/* ------------------------------------------------------------------------- */
+/* format_conversion.effect, Planar420 */
+
+/*
+ * Produces the same bytes as PSPlanar420: an I420 frame written four bytes
+ * per texel, the luma rows (green channel) first and then, a row each, the U
+ * and V rows of every chroma row side by side.  Chroma is the 2x2 average of
+ * red (U) and blue (V).
+ */
+static inline uint32_t planar_texel(const struct raster_draw *draw,
+		uint32_t x, uint32_t y)
+{
+	if (x >= draw->tex_width)
+		x = draw->tex_width - 1;
+	if (y >= draw->tex_height)
+		y = draw->tex_height - 1;
+
+	return ((const uint32_t*)(draw->tex +
+			(size_t)y * draw->tex_linesize))[x];
+}
+
+static inline uint8_t planar_channel(uint32_t texel, int channel)
+{
+	return (uint8_t)(texel >> (channel * 8));
+}
+
+static uint32_t planar_luma(const struct raster_draw *draw, uint32_t x,
+		uint32_t y)
+{
+	uint32_t out = 0;
+
+	if (x + 4 <= draw->tex_width && y < draw->tex_height) {
+		const uint8_t *row = draw->tex + (size_t)y * draw->tex_linesize;
+		__m128i val = _mm_loadu_si128((const __m128i*)(row + x * 4));
+
+		val = _mm_and_si128(_mm_srli_epi32(val, 8),
+				_mm_set1_epi32(0xFF));
+		val = _mm_packs_epi32(val, val);
+		return (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(val, val));
+	}
+
+	for (uint32_t i = 0; i < 4; i++)
+		out |= (uint32_t)planar_channel(
+				planar_texel(draw, x + i, y), 1) << (i * 8);
+	return out;
+}
+
+static uint8_t planar_chroma(const struct raster_draw *draw, uint32_t x,
+		uint32_t y, int channel)
+{
+	uint32_t lx = x * 2;
+	uint32_t ly = y * 2;
+	uint32_t sum = 0;
+
+	for (uint32_t j = 0; j < 4; j++) {
+		uint32_t texel = planar_texel(draw, lx + (j & 1),
+				ly + (j >> 1));
+		sum += planar_channel(texel, channel);
+	}
+
+	return (uint8_t)((sum + 2) / 4);
+}
+
+static void planar420_rows(void *param, uint32_t start_y, uint32_t end_y)
+{
+	struct raster_draw *draw = param;
+	uint32_t chroma_width = draw->tex_width / 2;
+	int u_channel = draw->tex_swap ? 2 : 0;
+	int v_channel = draw->tex_swap ? 0 : 2;
+
+	for (uint32_t y = start_y; y < end_y; y++) {
+		uint32_t *dst = get_dst_row(draw, draw->y0 + (int)y);
+		uint32_t row  = draw->y0 + y;
+
+		for (int x = 0; x < draw->x1; x++) {
+			uint32_t out = 0;
+
+			if (row < draw->tex_height) {
+				out = planar_luma(draw, x * 4, row);
+			} else {
+				uint32_t ch_y = row - draw->tex_height;
+
+				for (uint32_t i = 0; i < 4; i++) {
+					uint32_t b = x * 4 + i;
+					uint8_t  val;
+
+					if (b < chroma_width)
+						val = planar_chroma(draw, b,
+							ch_y, u_channel);
+					else
+						val = planar_chroma(draw,
+							b - chroma_width,
+							ch_y, v_channel);
+
+					out |= (uint32_t)val << (i * 8);
+				}
+			}
+
+			dst[x] = draw->dst_swap ? swap_rb(out) : out;
+		}
+	}
+}
+
+static void draw_planar420(struct gs_device *device, struct raster_draw *draw)
+{
+	/* the whole target is always written, the output being plane data
+	 * rather than an image */
+	draw->x0 = 0;
+	draw->y0 = 0;
+	draw->x1 = (int)draw->dst_width;
+	draw->y1 = draw->clip_y1;
+
+	run_rows(device, planar420_rows, draw);
+}
+
+/* ------------------------------------------------------------------------- */
+/* format_conversion.effect, *_Unpack */
+
+static inline bool is_unpack_program(enum null_program program)
+{
+	return program >= NULL_PROGRAM_UNPACK_I420 &&
+	       program <= NULL_PROGRAM_UNPACK_UYVY;
+}
+
+static inline const uint8_t *plane_texel(const struct raster_plane *plane,
+		uint32_t x, uint32_t y)
+{
+	if (x >= plane->width)
+		x = plane->width - 1;
+	if (y >= plane->height)
+		y = plane->height - 1;
+
+	return plane->data + (size_t)y * plane->linesize + x * plane->bpp;
+}
+
+static inline uint32_t unpack_pixel(const struct raster_draw *draw,
+		uint32_t x, uint32_t y)
+{
+	const struct raster_plane *planes = draw->planes;
+	const uint8_t *pair;
+	uint32_t lum, u, v;
+
+	switch (draw->program) {
+	case NULL_PROGRAM_UNPACK_I420:
+		lum = *plane_texel(planes,   x,     y);
+		u   = *plane_texel(planes+1, x / 2, y / 2);
+		v   = *plane_texel(planes+2, x / 2, y / 2);
+		break;
+	case NULL_PROGRAM_UNPACK_NV12:
+		lum = *plane_texel(planes,   x,             y);
+		u   = *plane_texel(planes+1, x & ~1u,       y / 2);
+		v   = *plane_texel(planes+1, (x & ~1u) + 1, y / 2);
+		break;
+	case NULL_PROGRAM_UNPACK_YUY2:
+		pair = plane_texel(planes, x / 2, y);
+		lum  = pair[(x & 1) ? 2 : 0];
+		u    = pair[1];
+		v    = pair[3];
+		break;
+	case NULL_PROGRAM_UNPACK_YVYU:
+		pair = plane_texel(planes, x / 2, y);
+		lum  = pair[(x & 1) ? 2 : 0];
+		u    = pair[3];
+		v    = pair[1];
+		break;
+	default:
+		pair = plane_texel(planes, x / 2, y);
+		lum  = pair[(x & 1) ? 3 : 1];
+		u    = pair[0];
+		v    = pair[2];
+		break;
+	}
+
+	return lum | (u << 8) | (v << 16) | 0xFF000000;
+}
+
+static void unpack_rows(void *param, uint32_t start_y, uint32_t end_y)
+{
+	struct raster_draw *draw = param;
+
+	for (uint32_t y = start_y; y < end_y; y++) {
+		uint32_t src_y = (uint32_t)draw->y0 + y;
+		uint32_t *dst = get_dst_row(draw, (int)src_y);
+
+		for (int x = draw->x0; x < draw->x1; x++) {
+			uint32_t out = unpack_pixel(draw, (uint32_t)x, src_y);
+			dst[x] = draw->dst_swap ? swap_rb(out) : out;
+		}
+	}
+}
+
+static bool load_plane(struct raster_plane *plane, struct gs_shader *ps,
+		const char *name)
+{
+	struct shader_param *param = shader_getparambyname(ps, name);
+	struct gs_texture *tex = param ? param->texture : NULL;
+
+	if (!tex || tex->type != GS_TEXTURE_2D)
+		return false;
+
+	plane->data     = tex->data;
+	plane->linesize = tex->linesize;
+	plane->width    = tex->width;
+	plane->height   = tex->height;
+	plane->bpp      = gs_get_format_bpp(tex->format) / 8;
+	return plane->bpp == 1 || plane->bpp == 4;
+}
+
+/*
+ * The unpack programs are only used to draw a frame to a target of the same
+ * size, so the target pixels map directly to frame pixels and the planes are
+ * read without filtering, as the point sampled shaders do.
+ */
+static void draw_unpack(struct gs_device *device, struct raster_draw *draw)
+{
+	struct gs_shader *ps = device->cur_pixel_shader;
+	size_t num_planes = 1;
+
+	if (draw->program == NULL_PROGRAM_UNPACK_I420)
+		num_planes = 3;
+	else if (draw->program == NULL_PROGRAM_UNPACK_NV12)
+		num_planes = 2;
+
+	if (!load_plane(draw->planes,   ps, "image") ||
+	    (num_planes > 1 && !load_plane(draw->planes+1, ps, "image1")) ||
+	    (num_planes > 2 && !load_plane(draw->planes+2, ps, "image2")))
+		return;
+
+	draw->x0 = draw->clip_x0;
+	draw->y0 = draw->clip_y0;
+	draw->x1 = draw->clip_x1;
+	draw->y1 = draw->clip_y1;
+
+	run_rows(device, unpack_rows, draw);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline uint32_t pack_rgba(const struct vec4 *color)
+{
+	__m128 val = _mm_mul_ps(_mm_loadu_ps(color->ptr), _mm_set1_ps(255.0f));
+	return pack_float(val);
+}
+
+static void load_shader_params(struct raster_draw *draw,
+		struct gs_shader *ps)
+{
+	struct shader_param *matrix = shader_getparambyname(ps,
+			"color_matrix");
+	struct shader_param *color = shader_getparambyname(ps, "color");
+	float m[16];
+
+	vec4_set(&draw->color, 1.0f, 1.0f, 1.0f, 1.0f);
+	if (color && color->cur_value.num == sizeof(struct vec4))
+		memcpy(draw->color.ptr, color->cur_value.array,
+				sizeof(float) * 4);
+	draw->solid = pack_rgba(&draw->color);
+
+	if (!matrix || matrix->cur_value.num != sizeof(m))
+		return;
+
+	/* out[i] = saturate(dot(row i, float4(rgb, 1.0))), and texels are
+	 * 0-255, so the constant column is scaled by 255 */
+	memcpy(m, matrix->cur_value.array, sizeof(m));
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++)
+			draw->matrix[j][i] = m[i * 4 + j] *
+				(j == 3 ? 255.0f : 1.0f);
+	}
+}
+
+static bool load_texture(struct gs_device *device, struct raster_draw *draw,
+		struct gs_shader *ps)
+{
+	struct gs_texture *tex = ps->image ? ps->image->texture : NULL;
+	struct gs_sampler_state *ss = device->cur_samplers[0];
+
+	if (!tex || tex->type != GS_TEXTURE_2D)
+		return false;
+
+	if (!is_rgba8_format(tex->format)) {
+		warn_once(device, WARN_TEXTURE_FORMAT, "Software rasterizer: "
+				"only RGBA, BGRA and BGRX textures can be "
+				"sampled");
+		return false;
+	}
+
+	draw->tex          = tex->data;
+	draw->tex_linesize = tex->linesize;
+	draw->tex_width    = tex->width;
+	draw->tex_height   = tex->height;
+	draw->tex_swap     = tex->format != GS_RGBA;
+	draw->tex_opaque   = tex->format == GS_BGRX;
+
+	if (ss) {
+		enum gs_sample_filter filter = ss->info.filter;
+		draw->linear = filter != GS_FILTER_POINT &&
+			filter != GS_FILTER_MIN_MAG_POINT_MIP_LINEAR &&
+			filter != GS_FILTER_MIN_LINEAR_MAG_MIP_POINT &&
+			filter != GS_FILTER_MIN_LINEAR_MAG_POINT_MIP_LINEAR;
+		draw->address_u = ss->info.address_u;
+		draw->address_v = ss->info.address_v;
+	} else {
+		draw->linear    = true;
+		draw->address_u = GS_ADDRESS_CLAMP;
+		draw->address_v = GS_ADDRESS_CLAMP;
+	}
+
+	return true;
+}
+
+static void load_blend_state(struct gs_device *device,
+		struct raster_draw *draw)
+{
+	enum gs_blend_type src  = device->blend_src;
+	enum gs_blend_type dest = device->blend_dest;
+
+	draw->blend_src  = src;
+	draw->blend_dest = dest;
+
+	if (!device->blend_enabled ||
+	    (src == GS_BLEND_ONE && dest == GS_BLEND_ZERO))
+		draw->blend = BLEND_REPLACE;
+	else if (src == GS_BLEND_SRCALPHA && dest == GS_BLEND_INVSRCALPHA)
+		draw->blend = BLEND_ALPHA;
+	else if (src == GS_BLEND_ONE && dest == GS_BLEND_INVSRCALPHA)
+		draw->blend = BLEND_PREMULTIPLIED;
+	else
+		draw->blend = BLEND_GENERIC;
+
+	draw->write_mask = 0;
+	for (int i = 0; i < 4; i++) {
+		if (device->color_mask[i])
+			draw->write_mask |= 0xFFu << (i * 8);
+	}
+
+	if (draw->dst_swap)
+		draw->write_mask = swap_rb(draw->write_mask);
+}
+
+static bool load_target(struct gs_device *device, struct raster_draw *draw)
+{
+	struct gs_texture *target = device->cur_render_target;
+	struct gs_rect *viewport = &device->cur_viewport;
+
+	/* swap chains have no back buffer to draw to */
+	if (!target)
+		return false;
+
+	if (!is_rgba8_format(target->format)) {
+		warn_once(device, WARN_TARGET_FORMAT, "Software rasterizer: "
+				"only RGBA, BGRA and BGRX render targets are "
+				"supported");
+		return false;
+	}
+
+	draw->dst          = texture_get_face(target, device->cur_render_side);
+	draw->dst_linesize = target->linesize;
+	draw->dst_width    = target->width;
+	draw->dst_swap     = target->format != GS_RGBA;
+
+	draw->clip_x0 = max_int(viewport->x, 0);
+	draw->clip_y0 = max_int(viewport->y, 0);
+	draw->clip_x1 = min_int(viewport->x + viewport->cx,
+			(int)target->width);
+	draw->clip_y1 = min_int(viewport->y + viewport->cy,
+			(int)target->height);
+
+	return draw->clip_x1 > draw->clip_x0 && draw->clip_y1 > draw->clip_y0;
+}
+
+/* VSDefault: position times ViewProj, then the viewport transform */
+static void transform_verts(struct gs_device *device, struct raster_vert *out,
+		uint32_t start_vert, uint32_t num_verts)
+{
+	struct gs_index_buffer *ib = device->cur_index_buffer;
+	struct vb_data *data = device->cur_vertex_buffer->data;
+	struct gs_rect *viewport = &device->cur_viewport;
+	struct vec2 *uvs = NULL;
+	struct matrix4 viewproj;
+
+	/* vec4_transform expects the transposed matrix */
+	matrix4_mul(&viewproj, &device->cur_view, &device->cur_proj);
+	matrix4_transpose(&viewproj, &viewproj);
+
+	if (data->num_tex && data->tvarray[0].width == 2)
+		uvs = data->tvarray[0].array;
+
+	for (uint32_t i = 0; i < num_verts; i++) {
+		size_t idx = start_vert + i;
+		struct vec4 pos;
+		float w;
+
+		if (ib && ib->type == GS_UNSIGNED_SHORT)
+			idx = ((uint16_t*)ib->data)[idx];
+		else if (ib)
+			idx = ((uint32_t*)ib->data)[idx];
+
+		if (idx >= data->num)
+			idx = 0;
+
+		vec4_set(&pos, data->points[idx].x, data->points[idx].y,
+				data->points[idx].z, 1.0f);
+		vec4_transform(&pos, &pos, &viewproj);
+
+		w = pos.w != 0.0f ? pos.w : 1.0f;
+		out[i].x = (float)viewport->x +
+			(pos.x / w + 1.0f) * 0.5f * (float)viewport->cx;
+		out[i].y = (float)viewport->y +
+			(1.0f - pos.y / w) * 0.5f * (float)viewport->cy;
+		out[i].u = uvs ? uvs[idx].x : 0.0f;
+		out[i].v = uvs ? uvs[idx].y : 0.0f;
+	}
+}
+
+static void draw_primitives(struct gs_device *device,
+		struct raster_draw *draw, enum gs_draw_mode draw_mode,
+		const struct raster_vert *verts, uint32_t num_verts)
+{
+	if (draw_mode == GS_TRISTRIP) {
+		if (num_verts == 4 && is_axis_aligned(verts)) {
+			draw_rect(device, draw, verts);
+			return;
+		}
+
+		for (uint32_t i = 2; i < num_verts; i++)
+			draw_triangle(device, draw, verts+i-2, verts+i-1,
+					verts+i);
+
+	} else if (draw_mode == GS_TRIS) {
+		for (uint32_t i = 2; i < num_verts; i += 3)
+			draw_triangle(device, draw, verts+i-2, verts+i-1,
+					verts+i);
+
+	} else {
+		warn_once(device, WARN_DRAW_MODE, "Software rasterizer: "
+				"points and lines are not drawn");
+	}
+}
+
+void null_raster_draw(struct gs_device *device, enum gs_draw_mode draw_mode,
+		uint32_t start_vert, uint32_t num_verts)
+{
+	struct gs_shader *ps = device->cur_pixel_shader;
+	struct raster_draw draw = {0};
+	struct raster_vert *verts;
+	size_t available;
+
+	if (ps->program == NULL_PROGRAM_UNKNOWN) {
+		if (!ps->warned)
+			blog(LOG_WARNING, "Software rasterizer: pixel shader "
+			                  "is not supported, its draws will be "
+			                  "skipped");
+		ps->warned = true;
+		return;
+	}
+
+	if (!load_target(device, &draw))
+		return;
+
+	draw.program = ps->program;
+
+	if (is_unpack_program(ps->program)) {
+		draw_unpack(device, &draw);
+		return;
+	}
+
+	if (ps->program != NULL_PROGRAM_SOLID &&
+	    !load_texture(device, &draw, ps))
+		return;
+
+	if (ps->program == NULL_PROGRAM_PLANAR420) {
+		draw_planar420(device, &draw);
+		return;
+	}
+
+	load_shader_params(&draw, ps);
+	load_blend_state(device, &draw);
+
+	available = device->cur_index_buffer ?
+		device->cur_index_buffer->num :
+		device->cur_vertex_buffer->data->num;
+	if (!num_verts)
+		num_verts = (uint32_t)available;
+	if (start_vert >= available)
+		return;
+	if (num_verts > available - start_vert)
+		num_verts = (uint32_t)(available - start_vert);
+
+	verts = bmalloc(sizeof(struct raster_vert) * num_verts);
+	transform_verts(device, verts, start_vert, num_verts);
+	draw_primitives(device, &draw, draw_mode, verts, num_verts);
+	bfree(verts);
+}
@@ -0,0 +1,393 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <assert.h>
+
+#include <graphics/vec2.h>
+#include <graphics/vec3.h>
+#include <graphics/vec4.h>
+#include <graphics/matrix3.h>
+#include <graphics/matrix4.h>
+#include <graphics/shader-parser.h>
+#include "null-subsystem.h"
+
+/*
+ *   Shaders are parsed only to find their parameters and samplers, which the
+ * effect system needs to be able to look up.  Parameter values are kept so
+ * they can be read back, but no code is ever generated or run.  Pixel
+ * shaders are also matched to one of the programs the software rasterizer
+ * implements natively.
+ */
+
+static inline void shader_param_free(struct shader_param *param)
+{
+	bfree(param->name);
+	da_free(param->cur_value);
+	da_free(param->def_value);
+}
+
+static void add_param(struct gs_shader *shader, struct shader_var *var)
+{
+	struct shader_param param = {0};
+
+	param.array_count = var->array_count;
+	param.name        = bstrdup(var->name);
+	param.shader      = shader;
+	param.type        = get_shader_param_type(var->type);
+
+	da_move(param.def_value, var->default_val);
+	da_copy(param.cur_value, param.def_value);
+
+	da_push_back(shader->params, &param);
+}
+
+static void add_sampler(struct gs_shader *shader,
+		struct shader_sampler *sampler)
+{
+	samplerstate_t new_sampler;
+	struct gs_sampler_info info;
+
+	shader_sampler_convert(sampler, &info);
+	new_sampler = device_create_samplerstate(shader->device, &info);
+
+	da_push_back(shader->samplers, &new_sampler);
+}
+
+static inline bool is_color_param(struct shader_param *param)
+{
+	return param->type == SHADER_PARAM_VEC4 &&
+		strcmp(param->name, "color") == 0;
+}
+
+/* parameters that any program can ignore */
+static inline bool is_known_param(struct gs_shader *shader,
+		struct shader_param *param)
+{
+	return param == shader->viewproj || param == shader->world ||
+		param == shader->image || is_color_param(param);
+}
+
+static enum null_program get_program(struct gs_shader *shader,
+		struct shader_parser *sp)
+{
+	struct shader_param *color;
+
+	if (shader->type != SHADER_PIXEL)
+		return NULL_PROGRAM_UNKNOWN;
+
+	/* the programs from default.effect and format_conversion.effect */
+	if (shader_parser_getfunc(sp, "PSDrawBare"))
+		return NULL_PROGRAM_DRAW;
+	if (shader_parser_getfunc(sp, "PSDrawMatrix"))
+		return NULL_PROGRAM_DRAW_MATRIX;
+	if (shader_parser_getfunc(sp, "PSPlanar420"))
+		return NULL_PROGRAM_PLANAR420;
+	if (shader_parser_getfunc(sp, "PSI420_Unpack"))
+		return NULL_PROGRAM_UNPACK_I420;
+	if (shader_parser_getfunc(sp, "PSNV12_Unpack"))
+		return NULL_PROGRAM_UNPACK_NV12;
+	if (shader_parser_getfunc(sp, "PSYUY2_Unpack"))
+		return NULL_PROGRAM_UNPACK_YUY2;
+	if (shader_parser_getfunc(sp, "PSYVYU_Unpack"))
+		return NULL_PROGRAM_UNPACK_YVYU;
+	if (shader_parser_getfunc(sp, "PSUYVY_Unpack"))
+		return NULL_PROGRAM_UNPACK_UYVY;
+
+	/* otherwise assume a plain texture lookup and/or a solid color */
+	for (size_t i = 0; i < shader->params.num; i++) {
+		if (!is_known_param(shader, shader->params.array+i))
+			return NULL_PROGRAM_UNKNOWN;
+	}
+
+	color = shader_getparambyname(shader, "color");
+	if (shader->image)
+		return color ? NULL_PROGRAM_DRAW_COLOR : NULL_PROGRAM_DRAW;
+
+	return color ? NULL_PROGRAM_SOLID : NULL_PROGRAM_UNKNOWN;
+}
+
+static struct shader_param *get_image_param(struct gs_shader *shader)
+{
+	for (size_t i = 0; i < shader->params.num; i++) {
+		struct shader_param *param = shader->params.array+i;
+		if (param->type == SHADER_PARAM_TEXTURE)
+			return param;
+	}
+
+	return NULL;
+}
+
+static void shader_init(struct gs_shader *shader, struct shader_parser *sp)
+{
+	size_t i;
+
+	for (i = 0; i < sp->params.num; i++)
+		add_param(shader, sp->params.array+i);
+	for (i = 0; i < sp->samplers.num; i++)
+		add_sampler(shader, sp->samplers.array+i);
+
+	shader->viewproj = shader_getparambyname(shader, "ViewProj");
+	shader->world    = shader_getparambyname(shader, "World");
+	shader->image    = get_image_param(shader);
+	shader->program  = get_program(shader, sp);
+}
+
+static struct gs_shader *shader_create(device_t device, enum shader_type type,
+		const char *shader_str, const char *file, char **error_string)
+{
+	struct gs_shader *shader = NULL;
+	struct shader_parser sp;
+	char *errors;
+
+	shader_parser_init(&sp);
+
+	if (shader_parse(&sp, shader_str, file)) {
+		shader = bzalloc(sizeof(struct gs_shader));
+		shader->device = device;
+		shader->type   = type;
+		shader_init(shader, &sp);
+	}
+
+	errors = shader_parser_geterrors(&sp);
+	if (errors) {
+		blog(LOG_WARNING, "Shader parser errors/warnings:\n%s\n",
+				errors);
+
+		if (error_string)
+			*error_string = errors;
+		else
+			bfree(errors);
+	}
+
+	shader_parser_free(&sp);
+	return shader;
+}
+
+shader_t device_create_vertexshader(device_t device,
+		const char *shader, const char *file,
+		char **error_string)
+{
+	struct gs_shader *ptr;
+	ptr = shader_create(device, SHADER_VERTEX, shader, file, error_string);
+	if (!ptr)
+		blog(LOG_ERROR, "device_create_vertexshader (null) failed");
+	return ptr;
+}
+
+shader_t device_create_pixelshader(device_t device,
+		const char *shader, const char *file,
+		char **error_string)
+{
+	struct gs_shader *ptr;
+	ptr = shader_create(device, SHADER_PIXEL, shader, file, error_string);
+	if (!ptr)
+		blog(LOG_ERROR, "device_create_pixelshader (null) failed");
+	return ptr;
+}
+
+void shader_destroy(shader_t shader)
+{
+	size_t i;
+
+	if (!shader)
+		return;
+
+	if (shader->device->cur_vertex_shader == shader)
+		shader->device->cur_vertex_shader = NULL;
+	if (shader->device->cur_pixel_shader == shader)
+		shader->device->cur_pixel_shader = NULL;
+
+	for (i = 0; i < shader->samplers.num; i++) {
+		samplerstate_t ss = shader->samplers.array[i];
+
+		for (size_t j = 0; j < GS_MAX_TEXTURES; j++) {
+			if (shader->device->cur_samplers[j] == ss)
+				shader->device->cur_samplers[j] = NULL;
+		}
+
+		samplerstate_destroy(ss);
+	}
+
+	for (i = 0; i < shader->params.num; i++)
+		shader_param_free(shader->params.array+i);
+
+	da_free(shader->samplers);
+	da_free(shader->params);
+	bfree(shader);
+}
+
+int shader_numparams(shader_t shader)
+{
+	return (int)shader->params.num;
+}
+
+sparam_t shader_getparambyidx(shader_t shader, uint32_t param)
+{
+	assert(param < shader->params.num);
+	return shader->params.array+param;
+}
+
+sparam_t shader_getparambyname(shader_t shader, const char *name)
+{
+	size_t i;
+	for (i = 0; i < shader->params.num; i++) {
+		struct shader_param *param = shader->params.array+i;
+
+		if (strcmp(param->name, name) == 0)
+			return param;
+	}
+
+	return NULL;
+}
+
+static inline bool matching_shader(shader_t shader, sparam_t sparam)
+{
+	if (shader != sparam->shader) {
+		blog(LOG_ERROR, "Shader and shader parameter do not match");
+		return false;
+	}
+
+	return true;
+}
+
+void shader_getparaminfo(shader_t shader, sparam_t param,
+		struct shader_param_info *info)
+{
+	if (!matching_shader(shader, param))
+		return;
+
+	info->type = param->type;
+	info->name = param->name;
+}
+
+sparam_t shader_getviewprojmatrix(shader_t shader)
+{
+	return shader->viewproj;
+}
+
+sparam_t shader_getworldmatrix(shader_t shader)
+{
+	return shader->world;
+}
+
+static inline void set_value(shader_t shader, sparam_t param,
+		const void *val, size_t size)
+{
+	if (matching_shader(shader, param)) {
+		da_resize(param->cur_value, size);
+		memcpy(param->cur_value.array, val, size);
+	}
+}
+
+void shader_setbool(shader_t shader, sparam_t param, bool val)
+{
+	int b_val = (int)val;
+	set_value(shader, param, &b_val, sizeof(int));
+}
+
+void shader_setfloat(shader_t shader, sparam_t param, float val)
+{
+	set_value(shader, param, &val, sizeof(float));
+}
+
+void shader_setint(shader_t shader, sparam_t param, int val)
+{
+	set_value(shader, param, &val, sizeof(int));
+}
+
+void shader_setmatrix3(shader_t shader, sparam_t param,
+		const struct matrix3 *val)
+{
+	struct matrix4 mat;
+	matrix4_from_matrix3(&mat, val);
+	set_value(shader, param, &mat, sizeof(struct matrix4));
+}
+
+void shader_setmatrix4(shader_t shader, sparam_t param,
+		const struct matrix4 *val)
+{
+	set_value(shader, param, val, sizeof(struct matrix4));
+}
+
+void shader_setvec2(shader_t shader, sparam_t param,
+		const struct vec2 *val)
+{
+	set_value(shader, param, val->ptr, sizeof(float) * 2);
+}
+
+void shader_setvec3(shader_t shader, sparam_t param,
+		const struct vec3 *val)
+{
+	set_value(shader, param, val->ptr, sizeof(float) * 3);
+}
+
+void shader_setvec4(shader_t shader, sparam_t param,
+		const struct vec4 *val)
+{
+	set_value(shader, param, val->ptr, sizeof(float) * 4);
+}
+
+void shader_settexture(shader_t shader, sparam_t param, texture_t val)
+{
+	if (matching_shader(shader, param))
+		param->texture = val;
+}
+
+void shader_setval(shader_t shader, sparam_t param, const void *val,
+		size_t size)
+{
+	int count = param->array_count;
+	size_t expected_size = 0;
+	if (!count)
+		count = 1;
+
+	if (!matching_shader(shader, param))
+		return;
+
+	switch ((uint32_t)param->type) {
+	case SHADER_PARAM_FLOAT:     expected_size = sizeof(float); break;
+	case SHADER_PARAM_BOOL:
+	case SHADER_PARAM_INT:       expected_size = sizeof(int); break;
+	case SHADER_PARAM_VEC2:      expected_size = sizeof(float)*2; break;
+	case SHADER_PARAM_VEC3:      expected_size = sizeof(float)*3; break;
+	case SHADER_PARAM_VEC4:      expected_size = sizeof(float)*4; break;
+	case SHADER_PARAM_MATRIX4X4: expected_size = sizeof(float)*4*4; break;
+	case SHADER_PARAM_TEXTURE:   expected_size = sizeof(void*); break;
+	default:                     expected_size = 0;
+	}
+
+	expected_size *= count;
+	if (!expected_size)
+		return;
+
+	if (expected_size != size) {
+		blog(LOG_ERROR, "shader_setval (null): Size of shader param "
+		                "does not match the size of the input");
+		return;
+	}
+
+	if (param->type == SHADER_PARAM_TEXTURE)
+		shader_settexture(shader, param, *(texture_t*)val);
+	else
+		set_value(shader, param, val, size);
+}
+
+void shader_setdefault(shader_t shader, sparam_t param)
+{
+	shader_setval(shader, param, param->def_value.array,
+			param->def_value.num);
+}
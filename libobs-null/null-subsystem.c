@@ -0,0 +1,811 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <graphics/matrix3.h>
+#include "null-subsystem.h"
+
+/* Goofy Windows.h macros need to be removed */
+#undef far
+#undef near
+
+const char *device_preprocessor_name(void)
+{
+	return "_NULL";
+}
+
+device_t device_create(struct gs_init_data *info)
+{
+	struct gs_device *device = bzalloc(sizeof(struct gs_device));
+
+	device->default_swap.device = device;
+	device->default_swap.info   = *info;
+	device->cur_swap            = &device->default_swap;
+	device->cur_cull_mode       = GS_BACK;
+	device->blend_enabled       = true;
+	device->blend_src           = GS_BLEND_SRCALPHA;
+	device->blend_dest          = GS_BLEND_INVSRCALPHA;
+
+	for (size_t i = 0; i < 4; i++)
+		device->color_mask[i] = true;
+
+#ifdef NULL_RASTERIZE
+	if (slice_pool_create(&device->raster_pool, 0) != SLICE_POOL_SUCCESS)
+		device->raster_pool = NULL;
+
+	blog(LOG_INFO, "Software graphics device created, rasterizing with "
+	               "%u thread(s)",
+	               slice_pool_num_threads(device->raster_pool));
+#else
+	blog(LOG_INFO, "Null graphics device created, nothing will be "
+	               "rendered");
+#endif
+	return device;
+}
+
+void device_destroy(device_t device)
+{
+	if (device) {
+		slice_pool_destroy(device->raster_pool);
+		da_free(device->proj_stack);
+		bfree(device);
+	}
+}
+
+void device_entercontext(device_t device)
+{
+	/* no context to bind */
+	UNUSED_PARAMETER(device);
+}
+
+void device_leavecontext(device_t device)
+{
+	/* no context to unbind */
+	UNUSED_PARAMETER(device);
+}
+
+swapchain_t device_create_swapchain(device_t device, struct gs_init_data *info)
+{
+	struct gs_swap_chain *swap = bzalloc(sizeof(struct gs_swap_chain));
+
+	swap->device = device;
+	swap->info   = *info;
+	return swap;
+}
+
+void device_resize(device_t device, uint32_t cx, uint32_t cy)
+{
+	device->cur_swap->info.cx = cx;
+	device->cur_swap->info.cy = cy;
+}
+
+void device_getsize(device_t device, uint32_t *cx, uint32_t *cy)
+{
+	*cx = device->cur_swap->info.cx;
+	*cy = device->cur_swap->info.cy;
+}
+
+uint32_t device_getwidth(device_t device)
+{
+	return device->cur_swap->info.cx;
+}
+
+uint32_t device_getheight(device_t device)
+{
+	return device->cur_swap->info.cy;
+}
+
+texture_t device_create_volumetexture(device_t device, uint32_t width,
+		uint32_t height, uint32_t depth,
+		enum gs_color_format color_format, uint32_t levels,
+		const void **data, uint32_t flags)
+{
+	/* not supported by any of the other subsystems either */
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(color_format);
+	UNUSED_PARAMETER(levels);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(flags);
+	return NULL;
+}
+
+samplerstate_t device_create_samplerstate(device_t device,
+		struct gs_sampler_info *info)
+{
+	struct gs_sampler_state *sampler;
+
+	sampler = bzalloc(sizeof(struct gs_sampler_state));
+	sampler->device = device;
+	sampler->ref    = 1;
+	sampler->info   = *info;
+	return sampler;
+}
+
+enum gs_texture_type device_gettexturetype(texture_t texture)
+{
+	return texture->type;
+}
+
+void device_load_vertexbuffer(device_t device, vertbuffer_t vertbuffer)
+{
+	device->cur_vertex_buffer = vertbuffer;
+}
+
+void device_load_indexbuffer(device_t device, indexbuffer_t indexbuffer)
+{
+	device->cur_index_buffer = indexbuffer;
+}
+
+static struct shader_param *get_texture_param(device_t device, int unit)
+{
+	struct gs_shader *shader = device->cur_pixel_shader;
+	size_t texture_id = 0;
+
+	for (size_t i = 0; i < shader->params.num; i++) {
+		struct shader_param *param = shader->params.array+i;
+		if (param->type != SHADER_PARAM_TEXTURE)
+			continue;
+
+		if (texture_id++ == (size_t)unit)
+			return param;
+	}
+
+	return NULL;
+}
+
+void device_load_texture(device_t device, texture_t tex, int unit)
+{
+	struct shader_param *param;
+
+	/* need a pixel shader to properly bind textures */
+	if (!device->cur_pixel_shader)
+		tex = NULL;
+
+	if (device->cur_textures[unit] == tex)
+		return;
+
+	device->cur_textures[unit] = tex;
+
+	param = tex ? get_texture_param(device, unit) : NULL;
+	if (param)
+		param->texture = tex;
+}
+
+void device_load_samplerstate(device_t device, samplerstate_t ss, int unit)
+{
+	/* need a pixel shader to properly bind samplers */
+	if (!device->cur_pixel_shader)
+		ss = NULL;
+
+	device->cur_samplers[unit] = ss;
+}
+
+static void clear_textures(struct gs_device *device)
+{
+	memset(device->cur_textures, 0, sizeof(device->cur_textures));
+}
+
+void device_load_vertexshader(device_t device, shader_t vertshader)
+{
+	if (vertshader && vertshader->type != SHADER_VERTEX) {
+		blog(LOG_ERROR, "Specified shader is not a vertex shader");
+		blog(LOG_ERROR, "device_load_vertexshader (null) failed");
+		return;
+	}
+
+	device->cur_vertex_shader = vertshader;
+}
+
+void device_load_pixelshader(device_t device, shader_t pixelshader)
+{
+	if (device->cur_pixel_shader == pixelshader)
+		return;
+
+	if (pixelshader && pixelshader->type != SHADER_PIXEL) {
+		blog(LOG_ERROR, "Specified shader is not a pixel shader");
+		blog(LOG_ERROR, "device_load_pixelshader (null) failed");
+		return;
+	}
+
+	device->cur_pixel_shader = pixelshader;
+	clear_textures(device);
+
+	if (pixelshader) {
+		size_t num = pixelshader->samplers.num;
+		if (num > GS_MAX_TEXTURES)
+			num = GS_MAX_TEXTURES;
+
+		for (size_t i = 0; i < num; i++)
+			device->cur_samplers[i] =
+				pixelshader->samplers.array[i];
+	}
+}
+
+void device_load_defaultsamplerstate(device_t device, bool b_3d, int unit)
+{
+	UNUSED_PARAMETER(b_3d);
+	device->cur_samplers[unit] = NULL;
+}
+
+shader_t device_getvertexshader(device_t device)
+{
+	return device->cur_vertex_shader;
+}
+
+shader_t device_getpixelshader(device_t device)
+{
+	return device->cur_pixel_shader;
+}
+
+texture_t device_getrendertarget(device_t device)
+{
+	return device->cur_render_target;
+}
+
+zstencil_t device_getzstenciltarget(device_t device)
+{
+	return device->cur_zstencil_buffer;
+}
+
+void device_setrendertarget(device_t device, texture_t tex, zstencil_t zstencil)
+{
+	if (tex) {
+		if (tex->type != GS_TEXTURE_2D) {
+			blog(LOG_ERROR, "Texture is not a 2D texture");
+			goto fail;
+		}
+
+		if (!tex->is_render_target) {
+			blog(LOG_ERROR, "Texture is not a render target");
+			goto fail;
+		}
+	}
+
+	device->cur_render_target   = tex;
+	device->cur_render_side     = 0;
+	device->cur_zstencil_buffer = zstencil;
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_setrendertarget (null) failed");
+}
+
+void device_setcuberendertarget(device_t device, texture_t cubetex,
+		int side, zstencil_t zstencil)
+{
+	if (cubetex) {
+		if (cubetex->type != GS_TEXTURE_CUBE) {
+			blog(LOG_ERROR, "Texture is not a cube texture");
+			goto fail;
+		}
+
+		if (!cubetex->is_render_target) {
+			blog(LOG_ERROR, "Texture is not a render target");
+			goto fail;
+		}
+	}
+
+	device->cur_render_target   = cubetex;
+	device->cur_render_side     = side;
+	device->cur_zstencil_buffer = zstencil;
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_setcuberendertarget (null) failed");
+}
+
+static inline void copy_rows(uint8_t *dst, uint32_t dst_linesize,
+		const uint8_t *src, uint32_t src_linesize, uint32_t row_size,
+		uint32_t height)
+{
+	if (dst_linesize == src_linesize) {
+		memcpy(dst, src, (size_t)src_linesize * height);
+		return;
+	}
+
+	for (uint32_t y = 0; y < height; y++)
+		memcpy(dst + (size_t)y * dst_linesize,
+		       src + (size_t)y * src_linesize, row_size);
+}
+
+void device_copy_texture(device_t device, texture_t dst, texture_t src)
+{
+	if (!src) {
+		blog(LOG_ERROR, "Source texture is NULL");
+		goto fail;
+	}
+
+	if (!dst) {
+		blog(LOG_ERROR, "Destination texture is NULL");
+		goto fail;
+	}
+
+	if (dst->type != GS_TEXTURE_2D || src->type != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "Source and destination textures must be 2D "
+		                "textures");
+		goto fail;
+	}
+
+	if (dst->format != src->format) {
+		blog(LOG_ERROR, "Source and destination formats do not match");
+		goto fail;
+	}
+
+	if (dst->width != src->width || dst->height != src->height) {
+		blog(LOG_ERROR, "Source and destination must have "
+		                "the same dimensions");
+		goto fail;
+	}
+
+	copy_rows(dst->data, dst->linesize, src->data, src->linesize,
+			src->linesize, src->height);
+
+	UNUSED_PARAMETER(device);
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_copy_texture (null) failed");
+}
+
+void device_stage_texture(device_t device, stagesurf_t dst, texture_t src)
+{
+	uint32_t row_size;
+
+	if (!src) {
+		blog(LOG_ERROR, "Source texture is NULL");
+		goto fail;
+	}
+
+	if (src->type != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "Source texture must be a 2D texture");
+		goto fail;
+	}
+
+	if (!dst) {
+		blog(LOG_ERROR, "Destination surface is NULL");
+		goto fail;
+	}
+
+	if (src->format != dst->format) {
+		blog(LOG_ERROR, "Source and destination formats do not match");
+		goto fail;
+	}
+
+	if (src->width != dst->width || src->height != dst->height) {
+		blog(LOG_ERROR, "Source and destination must have the same "
+		                "dimensions");
+		goto fail;
+	}
+
+	row_size = src->width * gs_get_format_bpp(src->format) / 8;
+	copy_rows(dst->data, dst->linesize, src->data, src->linesize,
+			row_size, src->height);
+
+	UNUSED_PARAMETER(device);
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_stage_texture (null) failed");
+}
+
+void device_beginscene(device_t device)
+{
+	clear_textures(device);
+}
+
+static inline bool can_render(device_t device)
+{
+	if (!device->cur_vertex_shader) {
+		blog(LOG_ERROR, "No vertex shader specified");
+		return false;
+	}
+
+	if (!device->cur_pixel_shader) {
+		blog(LOG_ERROR, "No pixel shader specified");
+		return false;
+	}
+
+	if (!device->cur_vertex_buffer) {
+		blog(LOG_ERROR, "No vertex buffer specified");
+		return false;
+	}
+
+	return true;
+}
+
+static void update_viewproj_matrix(struct gs_device *device)
+{
+	struct gs_shader *vs = device->cur_vertex_shader;
+	struct matrix3 cur_matrix;
+	gs_matrix_get(&cur_matrix);
+
+	matrix4_from_matrix3(&device->cur_view, &cur_matrix);
+	matrix4_mul(&device->cur_viewproj, &device->cur_view,
+			&device->cur_proj);
+	matrix4_transpose(&device->cur_viewproj, &device->cur_viewproj);
+
+	if (vs->viewproj)
+		shader_setmatrix4(vs, vs->viewproj, &device->cur_viewproj);
+}
+
+/*
+ * Draws go through the same state validation and parameter updates as on a
+ * real device so callers hit the same errors, but nothing is rasterized
+ * unless this is the software module.
+ */
+void device_draw(device_t device, enum gs_draw_mode draw_mode,
+		uint32_t start_vert, uint32_t num_verts)
+{
+	effect_t effect = gs_geteffect();
+
+	if (!can_render(device)) {
+		blog(LOG_ERROR, "device_draw (null) failed");
+		return;
+	}
+
+	if (effect)
+		effect_updateparams(effect);
+
+	update_viewproj_matrix(device);
+
+#ifdef NULL_RASTERIZE
+	null_raster_draw(device, draw_mode, start_vert, num_verts);
+#else
+	UNUSED_PARAMETER(draw_mode);
+	UNUSED_PARAMETER(start_vert);
+	UNUSED_PARAMETER(num_verts);
+#endif
+}
+
+void device_endscene(device_t device)
+{
+	/* does nothing */
+	UNUSED_PARAMETER(device);
+}
+
+void device_load_swapchain(device_t device, swapchain_t swapchain)
+{
+	if (!swapchain)
+		swapchain = &device->default_swap;
+
+	device->cur_swap = swapchain;
+}
+
+static inline uint8_t unorm8(float val)
+{
+	if (val <= 0.0f) return 0;
+	if (val >= 1.0f) return 255;
+	return (uint8_t)(val * 255.0f + 0.5f);
+}
+
+/* packs a clear color into a single pixel, returns its size in bytes */
+static size_t pack_color(enum gs_color_format format, const struct vec4 *color,
+		uint8_t *pixel)
+{
+	switch (format) {
+	case GS_A8:
+		pixel[0] = unorm8(color->w);
+		return 1;
+	case GS_R8:
+		pixel[0] = unorm8(color->x);
+		return 1;
+	case GS_RGBA:
+		pixel[0] = unorm8(color->x);
+		pixel[1] = unorm8(color->y);
+		pixel[2] = unorm8(color->z);
+		pixel[3] = unorm8(color->w);
+		return 4;
+	case GS_BGRX:
+	case GS_BGRA:
+		pixel[0] = unorm8(color->z);
+		pixel[1] = unorm8(color->y);
+		pixel[2] = unorm8(color->x);
+		pixel[3] = format == GS_BGRX ? 255 : unorm8(color->w);
+		return 4;
+	case GS_RGBA32F:
+		memcpy(pixel, color->ptr, sizeof(float) * 4);
+		return sizeof(float) * 4;
+	case GS_R32F:
+		memcpy(pixel, color->ptr, sizeof(float));
+		return sizeof(float);
+	default:
+		/* other formats are cleared to zero */
+		memset(pixel, 0, gs_get_format_bpp(format) / 8);
+		return gs_get_format_bpp(format) / 8;
+	}
+}
+
+static void clear_target(struct gs_texture *tex, int side,
+		const struct vec4 *color)
+{
+	uint8_t *face = texture_get_face(tex, side);
+	uint8_t pixel[16];
+	size_t  size = pack_color(tex->format, color, pixel);
+
+	if (!size || gs_is_compressed_format(tex->format))
+		return;
+
+	for (uint32_t x = 0; x < tex->width; x++)
+		memcpy(face + x * size, pixel, size);
+
+	for (uint32_t y = 1; y < tex->height; y++)
+		memcpy(face + (size_t)y * tex->linesize, face,
+				tex->width * size);
+}
+
+void device_clear(device_t device, uint32_t clear_flags,
+		struct vec4 *color, float depth, uint8_t stencil)
+{
+	/* there is no depth/stencil storage, and nothing to present */
+	if ((clear_flags & GS_CLEAR_COLOR) != 0 && device->cur_render_target)
+		clear_target(device->cur_render_target,
+				device->cur_render_side, color);
+
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(stencil);
+}
+
+void device_present(device_t device)
+{
+	/* nothing to present to */
+	UNUSED_PARAMETER(device);
+}
+
+void device_setcullmode(device_t device, enum gs_cull_mode mode)
+{
+	device->cur_cull_mode = mode;
+}
+
+enum gs_cull_mode device_getcullmode(device_t device)
+{
+	return device->cur_cull_mode;
+}
+
+void device_enable_blending(device_t device, bool enable)
+{
+	device->blend_enabled = enable;
+}
+
+void device_enable_depthtest(device_t device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stenciltest(device_t device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencilwrite(device_t device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_color(device_t device, bool red, bool green,
+		bool blue, bool alpha)
+{
+	device->color_mask[0] = red;
+	device->color_mask[1] = green;
+	device->color_mask[2] = blue;
+	device->color_mask[3] = alpha;
+}
+
+void device_blendfunction(device_t device, enum gs_blend_type src,
+		enum gs_blend_type dest)
+{
+	device->blend_src  = src;
+	device->blend_dest = dest;
+}
+
+void device_depthfunction(device_t device, enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencilfunction(device_t device, enum gs_stencil_side side,
+		enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencilop(device_t device, enum gs_stencil_side side,
+		enum gs_stencil_op fail, enum gs_stencil_op zfail,
+		enum gs_stencil_op zpass)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(fail);
+	UNUSED_PARAMETER(zfail);
+	UNUSED_PARAMETER(zpass);
+}
+
+void device_enable_fullscreen(device_t device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+int device_fullscreen_enabled(device_t device)
+{
+	UNUSED_PARAMETER(device);
+	return false;
+}
+
+void device_setdisplaymode(device_t device,
+		const struct gs_display_mode *mode)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(mode);
+}
+
+void device_getdisplaymode(device_t device,
+		struct gs_display_mode *mode)
+{
+	UNUSED_PARAMETER(device);
+	memset(mode, 0, sizeof(struct gs_display_mode));
+}
+
+void device_setcolorramp(device_t device, float gamma, float brightness,
+		float contrast)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(gamma);
+	UNUSED_PARAMETER(brightness);
+	UNUSED_PARAMETER(contrast);
+}
+
+void device_setviewport(device_t device, int x, int y, int width,
+		int height)
+{
+	device->cur_viewport.x  = x;
+	device->cur_viewport.y  = y;
+	device->cur_viewport.cx = width;
+	device->cur_viewport.cy = height;
+}
+
+void device_getviewport(device_t device, struct gs_rect *rect)
+{
+	*rect = device->cur_viewport;
+}
+
+void device_setscissorrect(device_t device, struct gs_rect *rect)
+{
+	device->cur_scissor = *rect;
+}
+
+void device_ortho(device_t device, float left, float right,
+		float top, float bottom, float near, float far)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml = right-left;
+	float bmt = bottom-top;
+	float fmn = far-near;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x =         2.0f /  rml;
+	dst->t.x = (left+right) / -rml;
+
+	dst->y.y =         2.0f / -bmt;
+	dst->t.y = (bottom+top) /  bmt;
+
+	dst->z.z =        -2.0f /  fmn;
+	dst->t.z =   (far+near) / -fmn;
+
+	dst->t.w = 1.0f;
+}
+
+void device_frustum(device_t device, float left, float right,
+		float top, float bottom, float near, float far)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml    = right-left;
+	float tmb    = top-bottom;
+	float nmf    = near-far;
+	float nearx2 = 2.0f*near;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x =            nearx2 / rml;
+	dst->z.x =      (left+right) / rml;
+
+	dst->y.y =            nearx2 / tmb;
+	dst->z.y =      (bottom+top) / tmb;
+
+	dst->z.z =        (far+near) / nmf;
+	dst->t.z = 2.0f * (near*far) / nmf;
+
+	dst->z.w = -1.0f;
+}
+
+void device_projection_push(device_t device)
+{
+	da_push_back(device->proj_stack, &device->cur_proj);
+}
+
+void device_projection_pop(device_t device)
+{
+	struct matrix4 *end;
+	if (!device->proj_stack.num)
+		return;
+
+	end = da_end(device->proj_stack);
+	device->cur_proj = *end;
+	da_pop_back(device->proj_stack);
+}
+
+void swapchain_destroy(swapchain_t swapchain)
+{
+	if (!swapchain)
+		return;
+
+	if (swapchain->device->cur_swap == swapchain)
+		device_load_swapchain(swapchain->device, NULL);
+
+	bfree(swapchain);
+}
+
+void volumetexture_destroy(texture_t voltex)
+{
+	UNUSED_PARAMETER(voltex);
+}
+
+uint32_t volumetexture_getwidth(texture_t voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+uint32_t volumetexture_getheight(texture_t voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+uint32_t volumetexture_getdepth(texture_t voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+enum gs_color_format volumetexture_getcolorformat(texture_t voltex)
+{
+	UNUSED_PARAMETER(voltex);
+	return GS_UNKNOWN;
+}
+
+void samplerstate_destroy(samplerstate_t samplerstate)
+{
+	if (samplerstate)
+		samplerstate_release(samplerstate);
+}
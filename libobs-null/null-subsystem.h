@@ -0,0 +1,216 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+/*
+ * Null graphics subsystem
+ *
+ *   Implements the graphics module interface entirely in system memory,
+ * without a GPU or a window system.  Textures and staging surfaces are plain
+ * memory buffers, so uploads, copies, clears and downloads behave as they
+ * would on a real device, but draw calls only validate state and do not
+ * produce any pixels.  Useful for running the core on machines without a
+ * GPU and for measuring the CPU side of the pipeline on its own.
+ *
+ *   The same sources built with NULL_RASTERIZE defined make up the
+ * libobs-software module, which also rasterizes draws on the CPU (see
+ * null-raster.c).
+ */
+
+#include <util/darray.h>
+#include <graphics/graphics.h>
+#include <graphics/matrix4.h>
+#include <media-io/slice-pool.h>
+
+#include "null-exports.h"
+
+/* rows are padded so they can be processed with aligned vector loads */
+#define NULL_ROW_ALIGN 16
+
+static inline uint32_t null_get_linesize(enum gs_color_format format,
+		uint32_t width)
+{
+	uint32_t size = width * gs_get_format_bpp(format) / 8;
+	return (size + NULL_ROW_ALIGN - 1) & ~(NULL_ROW_ALIGN - 1);
+}
+
+struct gs_sampler_state {
+	device_t               device;
+	volatile uint32_t      ref;
+
+	struct gs_sampler_info info;
+};
+
+static inline void samplerstate_addref(samplerstate_t ss)
+{
+	ss->ref++;
+}
+
+static inline void samplerstate_release(samplerstate_t ss)
+{
+	if (--ss->ref == 0)
+		bfree(ss);
+}
+
+struct shader_param {
+	enum shader_param_type type;
+
+	char                 *name;
+	shader_t             shader;
+	int                  array_count;
+
+	struct gs_texture    *texture;
+
+	DARRAY(uint8_t)      cur_value;
+	DARRAY(uint8_t)      def_value;
+};
+
+/*
+ * Pixel shaders the software rasterizer can run.  Shaders are never
+ * interpreted; they are matched against the pixel shader functions libobs
+ * uses when they are created.
+ */
+enum null_program {
+	NULL_PROGRAM_UNKNOWN,
+	NULL_PROGRAM_DRAW,
+	NULL_PROGRAM_DRAW_COLOR,
+	NULL_PROGRAM_DRAW_MATRIX,
+	NULL_PROGRAM_SOLID,
+	NULL_PROGRAM_PLANAR420,
+	NULL_PROGRAM_UNPACK_I420,
+	NULL_PROGRAM_UNPACK_NV12,
+	NULL_PROGRAM_UNPACK_YUY2,
+	NULL_PROGRAM_UNPACK_YVYU,
+	NULL_PROGRAM_UNPACK_UYVY
+};
+
+struct gs_shader {
+	device_t             device;
+	enum shader_type     type;
+
+	struct shader_param  *viewproj;
+	struct shader_param  *world;
+
+	enum null_program    program;
+	struct shader_param  *image;
+	bool                 warned;
+
+	DARRAY(struct shader_param)  params;
+	DARRAY(samplerstate_t)       samplers;
+};
+
+struct gs_vertex_buffer {
+	device_t             device;
+	bool                 dynamic;
+	struct vb_data       *data;
+};
+
+struct gs_index_buffer {
+	device_t             device;
+	enum gs_index_type   type;
+	void                 *data;
+	size_t               num;
+	size_t               width;
+	bool                 dynamic;
+};
+
+/*
+ * 2D and cube textures share one structure.  Only the top mip level is
+ * stored; cube textures hold their six faces one after another.
+ */
+struct gs_texture {
+	device_t             device;
+	enum gs_texture_type type;
+	enum gs_color_format format;
+	uint32_t             width;
+	uint32_t             height;
+	uint32_t             levels;
+	bool                 is_dynamic;
+	bool                 is_render_target;
+
+	uint32_t             linesize;
+	uint8_t              *data;
+};
+
+static inline uint8_t *texture_get_face(struct gs_texture *tex, int side)
+{
+	return tex->data + (size_t)side * tex->linesize * tex->height;
+}
+
+struct gs_stage_surface {
+	device_t             device;
+
+	enum gs_color_format format;
+	uint32_t             width;
+	uint32_t             height;
+
+	uint32_t             linesize;
+	uint8_t              *data;
+};
+
+struct gs_zstencil_buffer {
+	device_t             device;
+	enum gs_zstencil_format format;
+	uint32_t             width;
+	uint32_t             height;
+};
+
+struct gs_swap_chain {
+	device_t             device;
+	struct gs_init_data  info;
+};
+
+struct gs_device {
+	texture_t            cur_render_target;
+	zstencil_t           cur_zstencil_buffer;
+	int                  cur_render_side;
+	texture_t            cur_textures[GS_MAX_TEXTURES];
+	samplerstate_t       cur_samplers[GS_MAX_TEXTURES];
+	vertbuffer_t         cur_vertex_buffer;
+	indexbuffer_t        cur_index_buffer;
+	shader_t             cur_vertex_shader;
+	shader_t             cur_pixel_shader;
+	swapchain_t          cur_swap;
+
+	/* stands in for the window the device was created with */
+	struct gs_swap_chain default_swap;
+
+	enum gs_cull_mode    cur_cull_mode;
+	struct gs_rect       cur_viewport;
+	struct gs_rect       cur_scissor;
+
+	bool                 blend_enabled;
+	enum gs_blend_type   blend_src;
+	enum gs_blend_type   blend_dest;
+	bool                 color_mask[4];
+
+	struct matrix4       cur_proj;
+	struct matrix4       cur_view;
+	struct matrix4       cur_viewproj;
+
+	DARRAY(struct matrix4)   proj_stack;
+
+	slice_pool_t         raster_pool;
+	uint32_t             raster_warnings;
+};
+
+#ifdef NULL_RASTERIZE
+extern void null_raster_draw(struct gs_device *device,
+		enum gs_draw_mode draw_mode, uint32_t start_vert,
+		uint32_t num_verts);
+#endif
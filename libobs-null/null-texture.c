@@ -0,0 +1,203 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "null-subsystem.h"
+
+/* source data is tightly packed, with one pointer per mip level per face */
+static void upload_faces(struct gs_texture *tex, uint32_t faces,
+		const void **data)
+{
+	uint32_t row_size   = tex->width * gs_get_format_bpp(tex->format) / 8;
+	uint32_t num_levels = tex->levels;
+
+	if (!num_levels)
+		num_levels = gs_num_total_levels(tex->width, tex->height);
+	if (!num_levels)
+		num_levels = 1;
+
+	for (uint32_t face = 0; face < faces; face++) {
+		const uint8_t *src = data[face * num_levels];
+		uint8_t *dst = texture_get_face(tex, (int)face);
+
+		if (!src)
+			continue;
+
+		for (uint32_t y = 0; y < tex->height; y++)
+			memcpy(dst + (size_t)y * tex->linesize,
+			       src + (size_t)y * row_size, row_size);
+	}
+}
+
+static struct gs_texture *texture_create(device_t device,
+		enum gs_texture_type type, uint32_t width, uint32_t height,
+		enum gs_color_format color_format, uint32_t levels,
+		const void **data, uint32_t flags)
+{
+	struct gs_texture *tex = bzalloc(sizeof(struct gs_texture));
+	uint32_t faces = type == GS_TEXTURE_CUBE ? 6 : 1;
+
+	tex->device           = device;
+	tex->type             = type;
+	tex->format           = color_format;
+	tex->width            = width;
+	tex->height           = height;
+	tex->levels           = levels;
+	tex->is_dynamic       = (flags & GS_DYNAMIC) != 0;
+	tex->is_render_target = (flags & GS_RENDERTARGET) != 0;
+	tex->linesize         = null_get_linesize(color_format, width);
+	tex->data             = bzalloc((size_t)tex->linesize * height * faces);
+
+	if (data)
+		upload_faces(tex, faces, data);
+
+	return tex;
+}
+
+texture_t device_create_texture(device_t device, uint32_t width,
+		uint32_t height, enum gs_color_format color_format,
+		uint32_t levels, const void **data, uint32_t flags)
+{
+	if (!width || !height || gs_is_compressed_format(color_format)) {
+		blog(LOG_ERROR, "device_create_texture (null) failed");
+		return NULL;
+	}
+
+	return texture_create(device, GS_TEXTURE_2D, width, height,
+			color_format, levels, data, flags);
+}
+
+texture_t device_create_cubetexture(device_t device, uint32_t size,
+		enum gs_color_format color_format, uint32_t levels,
+		const void **data, uint32_t flags)
+{
+	if (!size || gs_is_compressed_format(color_format)) {
+		blog(LOG_ERROR, "device_create_cubetexture (null) failed");
+		return NULL;
+	}
+
+	return texture_create(device, GS_TEXTURE_CUBE, size, size,
+			color_format, levels, data, flags);
+}
+
+static inline bool is_texture_2d(texture_t tex, const char *func)
+{
+	bool is_tex2d = tex->type == GS_TEXTURE_2D;
+	if (!is_tex2d)
+		blog(LOG_ERROR, "%s (null) failed:  Not a 2D texture", func);
+	return is_tex2d;
+}
+
+static inline bool is_texture_cube(texture_t tex, const char *func)
+{
+	bool is_texcube = tex->type == GS_TEXTURE_CUBE;
+	if (!is_texcube)
+		blog(LOG_ERROR, "%s (null) failed:  Not a cube texture", func);
+	return is_texcube;
+}
+
+static void texture_free(texture_t tex)
+{
+	struct gs_device *device = tex->device;
+
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++) {
+		if (device->cur_textures[i] == tex)
+			device->cur_textures[i] = NULL;
+	}
+
+	if (device->cur_render_target == tex)
+		device->cur_render_target = NULL;
+
+	bfree(tex->data);
+	bfree(tex);
+}
+
+void texture_destroy(texture_t tex)
+{
+	if (tex && is_texture_2d(tex, "texture_destroy"))
+		texture_free(tex);
+}
+
+uint32_t texture_getwidth(texture_t tex)
+{
+	if (!is_texture_2d(tex, "texture_getwidth"))
+		return 0;
+
+	return tex->width;
+}
+
+uint32_t texture_getheight(texture_t tex)
+{
+	if (!is_texture_2d(tex, "texture_getheight"))
+		return 0;
+
+	return tex->height;
+}
+
+enum gs_color_format texture_getcolorformat(texture_t tex)
+{
+	return tex->format;
+}
+
+bool texture_map(texture_t tex, void **ptr, uint32_t *linesize)
+{
+	if (!is_texture_2d(tex, "texture_map"))
+		goto fail;
+
+	if (!tex->is_dynamic) {
+		blog(LOG_ERROR, "Texture is not dynamic");
+		goto fail;
+	}
+
+	*ptr      = tex->data;
+	*linesize = tex->linesize;
+	return true;
+
+fail:
+	blog(LOG_ERROR, "texture_map (null) failed");
+	return false;
+}
+
+void texture_unmap(texture_t tex)
+{
+	/* the mapped memory is the texture itself */
+	UNUSED_PARAMETER(tex);
+}
+
+bool texture_isrect(texture_t tex)
+{
+	UNUSED_PARAMETER(tex);
+	return false;
+}
+
+void cubetexture_destroy(texture_t cubetex)
+{
+	if (cubetex && is_texture_cube(cubetex, "cubetexture_destroy"))
+		texture_free(cubetex);
+}
+
+uint32_t cubetexture_getsize(texture_t cubetex)
+{
+	if (!is_texture_cube(cubetex, "cubetexture_getsize"))
+		return 0;
+
+	return cubetex->width;
+}
+
+enum gs_color_format cubetexture_getcolorformat(texture_t cubetex)
+{
+	return cubetex->format;
+}
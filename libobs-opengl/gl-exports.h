@@ -148,6 +148,7 @@ EXPORT enum gs_color_format stagesurface_getcolorformat(stagesurf_t stagesurf);
 EXPORT bool     stagesurface_map(stagesurf_t stagesurf, const uint8_t **data,
 		uint32_t *linesize);
 EXPORT void     stagesurface_unmap(stagesurf_t stagesurf);
+EXPORT bool     stagesurface_isready(stagesurf_t stagesurf);
 
 EXPORT void zstencil_destroy(zstencil_t zstencil);
 
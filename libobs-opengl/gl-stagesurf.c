@@ -70,6 +70,8 @@ void stagesurface_destroy(stagesurf_t stagesurf)
 	if (stagesurf) {
 		if (stagesurf->pack_buffer)
 			gl_delete_buffers(1, &stagesurf->pack_buffer);
+		if (stagesurf->sync)
+			glDeleteSync(stagesurf->sync);
 
 		bfree(stagesurf);
 	}
@@ -106,6 +108,20 @@ static bool can_stage(struct gs_stage_surface *dst, struct gs_texture_2d *src)
 	return true;
 }
 
+/* fences let stagesurface_isready query the copy without blocking */
+static void insert_stage_fence(struct gs_stage_surface *surf)
+{
+	if (!ogl_IsVersionGEQ(3, 2) && !ogl_ext_ARB_sync)
+		return;
+
+	if (surf->sync)
+		glDeleteSync(surf->sync);
+
+	surf->sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	if (!gl_success("glFenceSync"))
+		surf->sync = NULL;
+}
+
 #ifdef __APPLE__
 
 /* Apparently for mac, PBOs won't do an asynchronous transfer unless you use
@@ -140,6 +156,7 @@ void device_stage_texture(device_t device, stagesurf_t dst, texture_t src)
 	if (!gl_success("glReadPixels"))
 		goto failed_unbind_all;
 
+	insert_stage_fence(dst);
 	success = true;
 
 failed_unbind_all:
@@ -170,6 +187,8 @@ void device_stage_texture(device_t device, stagesurf_t dst, texture_t src)
 	if (!gl_success("glGetTexImage"))
 		goto failed;
 
+	insert_stage_fence(dst);
+
 	gl_bind_texture(GL_TEXTURE_2D, 0);
 	gl_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
 	return;
@@ -217,6 +236,18 @@ fail:
 	return false;
 }
 
+bool stagesurface_isready(stagesurf_t stagesurf)
+{
+	GLenum result;
+
+	if (!stagesurf->sync)
+		return true;
+
+	result = glClientWaitSync(stagesurf->sync, 0, 0);
+	return result == GL_ALREADY_SIGNALED ||
+	       result == GL_CONDITION_SATISFIED;
+}
+
 void stagesurface_unmap(stagesurf_t stagesurf)
 {
 	if (!gl_bind_buffer(GL_PIXEL_PACK_BUFFER, stagesurf->pack_buffer))
@@ -132,6 +132,7 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT(stagesurface_getcolorformat);
 	GRAPHICS_IMPORT(stagesurface_map);
 	GRAPHICS_IMPORT(stagesurface_unmap);
+	GRAPHICS_IMPORT_OPTIONAL(stagesurface_isready);
 
 	GRAPHICS_IMPORT(zstencil_destroy);
 
@@ -160,6 +160,7 @@ struct gs_exports {
 	bool     (*stagesurface_map)(stagesurf_t stagesurf,
 			const uint8_t **data, uint32_t *linesize);
 	void     (*stagesurface_unmap)(stagesurf_t stagesurf);
+	bool     (*stagesurface_isready)(stagesurf_t stagesurf);
 
 	void (*zstencil_destroy)(zstencil_t zstencil);
 
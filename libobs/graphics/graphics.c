@@ -1574,6 +1574,15 @@ void stagesurface_unmap(stagesurf_t stagesurf)
 	graphics->exports.stagesurface_unmap(stagesurf);
 }
 
+bool stagesurface_isready(stagesurf_t stagesurf)
+{
+	graphics_t graphics = thread_graphics;
+	if (graphics->exports.stagesurface_isready)
+		return graphics->exports.stagesurface_isready(stagesurf);
+	else
+		return true;
+}
+
 void zstencil_destroy(zstencil_t zstencil)
 {
 	thread_graphics->exports.zstencil_destroy(zstencil);
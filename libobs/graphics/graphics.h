@@ -663,6 +663,13 @@ EXPORT bool     stagesurface_map(stagesurf_t stagesurf, const uint8_t **data,
 		uint32_t *linesize);
 EXPORT void     stagesurface_unmap(stagesurf_t stagesurf);
 
+/**
+ * Returns whether the last copy into the surface has completed, i.e. whether
+ * stagesurface_map can be called without stalling.  Always returns true if
+ * the graphics module cannot tell.
+ */
+EXPORT bool     stagesurface_isready(stagesurf_t stagesurf);
+
 EXPORT void     zstencil_destroy(zstencil_t zstencil);
 
 EXPORT void     samplerstate_destroy(samplerstate_t samplerstate);
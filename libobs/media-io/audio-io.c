@@ -24,32 +24,326 @@
 #include "../util/platform.h"
 
 #include "audio-io.h"
+#include "audio-mix.h"
 #include "audio-resampler.h"
 
 /* #define DEBUG_AUDIO */
 
 #define nop() do {int invalid = 0;} while(0)
 
+/* ------------------------------------------------------------------------- */
+/* blocks */
+
+/*
+ *   Each period is handed to the inputs as a reference counted block that
+ * owns a copy of its data.  It goes back to the block pool of its output
+ * once the last input queue holding it has released it.
+ */
+
+struct block_pool;
+
+struct audio_block {
+	struct audio_data          data; /* must be first */
+	struct block_pool          *pool;
+	volatile long              refs;
+	uint8_t                    *buffer;
+	size_t                     capacity;
+	struct audio_block         *next;
+};
+
+struct block_pool {
+	pthread_mutex_t            mutex;
+	struct audio_block         *free_blocks;
+};
+
+static void block_pool_free(struct block_pool *pool)
+{
+	while (pool->free_blocks) {
+		struct audio_block *block = pool->free_blocks;
+		pool->free_blocks = block->next;
+
+		bfree(block->buffer);
+		bfree(block);
+	}
+
+	pthread_mutex_destroy(&pool->mutex);
+}
+
+/* gets a block with room for the given number of planes of plane_size
+ * bytes each */
+static struct audio_block *block_pool_get(struct block_pool *pool,
+		size_t planes, size_t plane_size)
+{
+	struct audio_block *block;
+	size_t size = planes * plane_size;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	block = pool->free_blocks;
+	if (block)
+		pool->free_blocks = block->next;
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (!block) {
+		block = bzalloc(sizeof(struct audio_block));
+		block->pool = pool;
+	}
+
+	if (block->capacity < size) {
+		bfree(block->buffer);
+		block->buffer   = bmalloc(size);
+		block->capacity = size;
+	}
+
+	memset(block->data.data, 0, sizeof(block->data.data));
+	for (size_t i = 0; i < planes; i++)
+		block->data.data[i] = block->buffer + i * plane_size;
+
+	block->data.volume = 1.0f;
+	block->refs        = 1;
+	block->next        = NULL;
+	return block;
+}
+
+static inline void audio_block_addref(struct audio_block *block)
+{
+	os_atomic_inc_long(&block->refs);
+}
+
+static void audio_block_release(struct audio_block *block)
+{
+	struct block_pool *pool;
+
+	if (!block || os_atomic_dec_long(&block->refs) != 0)
+		return;
+
+	pool = block->pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	block->next       = pool->free_blocks;
+	pool->free_blocks = block;
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/* inputs */
+
+/*
+ *   Inputs that request the same conversion share one resampler.  A
+ * resampler carries state from one block to the next, so it has to see
+ * every period in order: it is run once per period on the mixer thread, and
+ * every input sharing it is queued the same converted block.
+ */
+
+struct shared_resampler {
+	struct audio_convert_info  conversion;
+	audio_resampler_t          resampler;
+	long                       refs;
+
+	size_t                     planes;
+	size_t                     block_size;
+
+	/* the converted block of the period being output */
+	struct audio_block         *block;
+};
+
+static void shared_resampler_destroy(struct shared_resampler *sr)
+{
+	if (!sr)
+		return;
+
+	audio_block_release(sr->block);
+	audio_resampler_destroy(sr->resampler);
+	bfree(sr);
+}
+
+static inline bool convert_info_equal(const struct audio_convert_info *a,
+		const struct audio_convert_info *b)
+{
+	return a->samples_per_sec == b->samples_per_sec &&
+	       a->format          == b->format          &&
+	       a->speakers        == b->speakers;
+}
+
+/*
+ *   Each input receives blocks through its own bounded queue and delivery
+ * thread, so a slow consumer only ever delays itself and never the mixer.
+ */
+
 struct audio_input {
-	struct audio_convert_info conversion;
-	audio_resampler_t         resampler;
+	struct audio_convert_info  conversion;
+	struct shared_resampler    *resampler;
 
 	void (*callback)(void *param, const struct audio_data *data);
 	void *param;
+
+	pthread_t                  thread;
+	bool                       thread_active;
+	pthread_mutex_t            queue_mutex;
+	event_t                    queue_event;
+	struct circlebuf           queue;
+	uint32_t                   max_blocks;
+	enum audio_drop_policy     drop_policy;
+	bool                       behind;
+	bool                       stop;
+
+	uint32_t                   max_queued;
+	uint64_t                   delivered;
+	uint64_t                   dropped;
 };
 
-static inline audio_input_free(struct audio_input *input)
+static inline size_t audio_input_queued(struct audio_input *input)
 {
-	audio_resampler_destroy(input->resampler);
+	return input->queue.size / sizeof(struct audio_block*);
 }
 
+static inline struct audio_block *audio_input_pop(struct audio_input *input)
+{
+	struct audio_block *block = NULL;
+
+	if (input->queue.size)
+		circlebuf_pop_front(&input->queue, &block, sizeof(block));
+	return block;
+}
+
+static void audio_input_free(struct audio_input *input)
+{
+	struct audio_block *block;
+
+	if (input->thread_active) {
+		pthread_mutex_lock(&input->queue_mutex);
+		input->stop = true;
+		pthread_mutex_unlock(&input->queue_mutex);
+
+		event_signal(&input->queue_event);
+		pthread_join(input->thread, NULL);
+	}
+
+	while ((block = audio_input_pop(input)) != NULL)
+		audio_block_release(block);
+
+	circlebuf_free(&input->queue);
+	event_destroy(&input->queue_event);
+	pthread_mutex_destroy(&input->queue_mutex);
+
+	bfree(input);
+}
+
+static void *audio_input_thread(void *param)
+{
+	struct audio_input *input = param;
+	bool stop = false;
+
+	while (!stop) {
+		event_wait(&input->queue_event);
+
+		for (;;) {
+			struct audio_block *block;
+
+			pthread_mutex_lock(&input->queue_mutex);
+			stop  = input->stop;
+			block = stop ? NULL : audio_input_pop(input);
+			pthread_mutex_unlock(&input->queue_mutex);
+
+			if (!block)
+				break;
+
+			input->callback(input->param, &block->data);
+			audio_block_release(block);
+
+			pthread_mutex_lock(&input->queue_mutex);
+			input->delivered++;
+			pthread_mutex_unlock(&input->queue_mutex);
+		}
+	}
+
+	return NULL;
+}
+
+static void audio_input_push(const char *name, struct audio_input *input,
+		struct audio_block *block)
+{
+	struct audio_block     *dropped    = NULL;
+	bool                   log_behind = false;
+	enum audio_drop_policy policy;
+	uint32_t               limit;
+	size_t                 queued;
+
+	pthread_mutex_lock(&input->queue_mutex);
+
+	policy = input->drop_policy;
+	limit  = input->max_blocks;
+	queued = audio_input_queued(input);
+
+	if (queued >= limit) {
+		switch (policy) {
+		case AUDIO_DROP_NONE:
+			break;
+		case AUDIO_DROP_OLDEST:
+			dropped = audio_input_pop(input);
+			input->dropped++;
+			break;
+		case AUDIO_DROP_NEWEST:
+			block = NULL;
+			input->dropped++;
+			break;
+		}
+
+		/* logged once until the input catches up to half the limit */
+		log_behind = !input->behind;
+		input->behind = true;
+
+	} else if (queued <= limit / 2) {
+		input->behind = false;
+	}
+
+	if (block) {
+		audio_block_addref(block);
+		circlebuf_push_back(&input->queue, &block, sizeof(block));
+	}
+
+	queued = audio_input_queued(input);
+	if (queued > input->max_queued)
+		input->max_queued = (uint32_t)queued;
+
+	pthread_mutex_unlock(&input->queue_mutex);
+
+	if (log_behind)
+		blog(LOG_WARNING, "Audio output '%s': an input is %"PRIu32" "
+		                  "blocks behind, %s", name, limit,
+		                  policy == AUDIO_DROP_NONE ?
+		                  "queueing further blocks" :
+		                  "dropping blocks");
+
+	audio_block_release(dropped);
+	if (block)
+		event_signal(&input->queue_event);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* a volume change, which applies from the sample at timestamp on */
+struct volume_change {
+	uint64_t                   timestamp;
+	float                      volume;
+};
+
 struct audio_line {
 	char                       *name;
 
 	struct audio_output        *audio;
+	/* one float plane per channel, converted from the output format as
+	 * data arrives.  the volume of each packet is queued with its
+	 * timestamp and applied when its samples are mixed, ramping from
+	 * mix_volume to volume over a period so changes do not click */
 	struct circlebuf           buffers[MAX_AV_PLANES];
 	pthread_mutex_t            mutex;
-	DARRAY(uint8_t)            volume_buffers[MAX_AV_PLANES];
+	DARRAY(float)              convert_buffer;
+	DARRAY(struct volume_change) volume_changes;
+	float                      volume;
+	float                      mix_volume;
+	uint32_t                   ramp_frames;
 	uint64_t                   base_timestamp;
 	uint64_t                   last_timestamp;
 
@@ -63,10 +357,10 @@ struct audio_line {
 
 static inline void audio_line_destroy_data(struct audio_line *line)
 {
-	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
 		circlebuf_free(&line->buffers[i]);
-		da_free(line->volume_buffers[i]);
-	}
+	da_free(line->convert_buffer);
+	da_free(line->volume_changes);
 
 	pthread_mutex_destroy(&line->mutex);
 	bfree(line->name);
@@ -78,19 +372,31 @@ struct audio_output {
 	size_t                     block_size;
 	size_t                     channels;
 	size_t                     planes;
+	uint32_t                   period_frames;
 
 	pthread_t                  thread;
 	event_t                    stop_event;
 
-	DARRAY(uint8_t)            mix_buffers[MAX_AV_PLANES];
+	/* audio time of the first period, timing is kept under line_mutex */
+	uint64_t                   start_time;
+	struct audio_output_timing_stats timing;
+
+	/* the mix is always float planar, whatever info.format is */
+	DARRAY(float)              mix_buffers[MAX_AV_PLANES];
+	DARRAY(struct mix_span)    mix_spans;
 
 	bool                       initialized;
 
 	pthread_mutex_t            line_mutex;
 	struct audio_line          *first_line;
 
+	/* blocks are queued to each input, and converted by resamplers that
+	 * are only used under input_mutex */
+	struct block_pool          blocks;
+
 	pthread_mutex_t            input_mutex;
-	DARRAY(struct audio_input) inputs;
+	DARRAY(struct audio_input*) inputs;
+	DARRAY(struct shared_resampler*) resamplers;
 };
 
 static inline void audio_output_removeline(struct audio_output *audio,
@@ -130,9 +436,10 @@ static size_t ts_diff_frames(audio_t audio, uint64_t ts1, uint64_t ts2)
 	return (size_t)positive_round(diff);
 }
 
+/* byte offset in the float planes of lines and the mix */
 static size_t ts_diff_bytes(audio_t audio, uint64_t ts1, uint64_t ts2)
 {
-	return ts_diff_frames(audio, ts1, ts2) * audio->block_size;
+	return ts_diff_frames(audio, ts1, ts2) * sizeof(float);
 }
 
 /* unless the value is 3+ hours worth of frames, this won't overflow */
@@ -144,6 +451,16 @@ static inline uint64_t conv_frames_to_time(audio_t audio, uint32_t frames)
 
 /* ------------------------------------------------------------------------- */
 
+static inline uint64_t min_uint64(uint64_t a, uint64_t b)
+{
+	return a < b ? a : b;
+}
+
+static inline size_t min_size(size_t a, size_t b)
+{
+	return a < b ? a : b;
+}
+
 static inline void clear_excess_audio_data(struct audio_line *line,
 		uint64_t prev_time)
 {
@@ -156,143 +473,131 @@ static inline void clear_excess_audio_data(struct audio_line *line,
 	                  line->name, (uint32_t)size,
 	                  prev_time, line->base_timestamp);
 
-	for (size_t i = 0; i < line->audio->planes; i++) {
-		size_t clear_size = (size > line->buffers[i].size) ?
-			(size_t)size : line->buffers[i].size;
+	for (size_t i = 0; i < line->audio->channels; i++) {
+		size_t clear_size = min_size(size, line->buffers[i].size);
 
 		circlebuf_pop_front(&line->buffers[i], NULL, clear_size);
 	}
 }
 
-static inline uint64_t min_uint64(uint64_t a, uint64_t b)
+/* mixes size bytes from offset bytes into the buffer where they are stored,
+ * which is at most two spans as it may wrap around.  both are whole samples,
+ * as everything is pushed and popped in whole frames */
+static inline void mix_audio(float *mix, const struct circlebuf *buf,
+		size_t offset, size_t size, float gain, float gain_step)
 {
-	return a < b ? a : b;
+	const uint8_t *data = buf->data;
+	size_t pos = buf->start_pos + offset;
+	size_t first, first_frames;
+
+	if (pos >= buf->capacity)
+		pos -= buf->capacity;
+
+	first        = min_size(size, buf->capacity - pos);
+	first_frames = first / sizeof(float);
+
+	audio_mix_float(mix, (const float*)(data + pos), first_frames,
+			gain, gain_step);
+	if (first < size)
+		audio_mix_float(mix + first_frames, (const float*)data,
+				(size - first) / sizeof(float),
+				gain + (float)first_frames * gain_step,
+				gain_step);
 }
 
-static inline size_t min_size(size_t a, size_t b)
-{
-	return a < b ? a : b;
-}
-
-#ifndef CLAMP
-#define CLAMP(val, minval, maxval) \
-	((val > maxval) ? maxval : ((val < minval) ? minval : val))
-#endif
-
-#define MIN_S8  -128
-#define MAX_S8   127
-#define MIN_S16 -32767
-#define MAX_S16  32767
-#define MIN_S32 -2147483647
-#define MAX_S32  2147483647
-
-#define MIX_BUFFER_SIZE 256
+/*
+ *   A line is mixed in spans of constant gain or constant gain step.  Each
+ * volume change queued with the line's data starts a ramp at the sample it
+ * came with, so changes land with the audio they belong to.
+ */
+
+struct mix_span {
+	size_t                     offset;
+	size_t                     size;
+	float                      gain;
+	float                      gain_step;
+};
 
-/* TODO: optimize mixing */
-static void mix_u8(uint8_t *mix, struct circlebuf *buf, size_t size)
+static inline void push_mix_span(struct audio_output *audio, size_t offset,
+		size_t frames, float gain, float gain_step)
 {
-	uint8_t  vals[MIX_BUFFER_SIZE];
-	register int16_t mix_val;
-
-	while (size) {
-		size_t pop_count = min_size(size, sizeof(vals));
-		size -= pop_count;
-
-		circlebuf_pop_front(buf, vals, pop_count);
-
-		for (size_t i = 0; i < pop_count; i++) {
-			mix_val =  (int16_t)*mix - 128;
-			mix_val += (int16_t)vals[i] - 128;
-			mix_val = CLAMP(mix_val, MIN_S8, MAX_S8) + 128;
-			*(mix++) = (uint8_t)mix_val;
-		}
-	}
+	struct mix_span span = {
+		.offset    = offset,
+		.size      = frames * sizeof(float),
+		.gain      = gain,
+		.gain_step = gain_step
+	};
+
+	da_push_back(audio->mix_spans, &span);
 }
 
-static void mix_s16(uint8_t *mix_in, struct circlebuf *buf, size_t size)
+/* adds the spans of size bytes from offset, carrying on any ramp */
+static void add_mix_spans(struct audio_output *audio, struct audio_line *line,
+		size_t offset, size_t size)
 {
-	int16_t *mix = (int16_t*)mix_in;
-	int16_t vals[MIX_BUFFER_SIZE];
-	register int32_t mix_val;
+	size_t frames = size / sizeof(float);
 
-	while (size) {
-		size_t pop_count = min_size(size, sizeof(vals));
-		size -= pop_count;
+	if (line->ramp_frames) {
+		size_t ramp = min_size(frames, line->ramp_frames);
+		float  step = (line->volume - line->mix_volume) /
+			(float)line->ramp_frames;
 
-		circlebuf_pop_front(buf, vals, pop_count);
-		pop_count /= sizeof(int16_t);
+		push_mix_span(audio, offset, ramp, line->mix_volume, step);
 
-		for (size_t i = 0; i < pop_count; i++) {
-			mix_val =  (int32_t)*mix;
-			mix_val += (int32_t)vals[i];
-			*(mix++) = (int16_t)CLAMP(mix_val, MIN_S16, MAX_S16);
-		}
+		line->ramp_frames -= (uint32_t)ramp;
+		line->mix_volume   = line->ramp_frames ?
+			line->mix_volume + (float)ramp * step : line->volume;
+
+		offset += ramp * sizeof(float);
+		frames -= ramp;
 	}
+
+	if (frames)
+		push_mix_span(audio, offset, frames, line->mix_volume, 0.0f);
 }
 
-static void mix_s32(uint8_t *mix_in, struct circlebuf *buf, size_t size)
+static inline void start_volume_ramp(struct audio_output *audio,
+		struct audio_line *line, float volume)
 {
-	int32_t *mix = (int32_t*)mix_in;
-	int32_t vals[MIX_BUFFER_SIZE];
-	register int64_t mix_val;
-
-	while (size) {
-		size_t pop_count = min_size(size, sizeof(vals));
-		size -= pop_count;
-
-		circlebuf_pop_front(buf, vals, pop_count);
-		pop_count /= sizeof(int32_t);
-
-		for (size_t i = 0; i < pop_count; i++) {
-			mix_val =  (int64_t)*mix;
-			mix_val += (int64_t)vals[i];
-			*(mix++) = (int32_t)CLAMP(mix_val, MIN_S32, MAX_S32);
-		}
-	}
+	line->volume      = volume;
+	line->ramp_frames = (volume != line->mix_volume) ?
+		audio->period_frames : 0;
 }
 
-static void mix_float(uint8_t *mix_in, struct circlebuf *buf, size_t size)
+/* splits the next size bytes of the line into spans at its volume changes,
+ * taking the changes in them off the queue */
+static void get_mix_spans(struct audio_output *audio, struct audio_line *line,
+		size_t size)
 {
-	float *mix = (float*)mix_in;
-	float vals[MIX_BUFFER_SIZE];
-	register float mix_val;
+	size_t pos = 0;
 
-	while (size) {
-		size_t pop_count = min_size(size, sizeof(vals));
-		size -= pop_count;
+	da_resize(audio->mix_spans, 0);
 
-		circlebuf_pop_front(buf, vals, pop_count);
-		pop_count /= sizeof(float);
-
-		for (size_t i = 0; i < pop_count; i++) {
-			mix_val =  *mix + vals[i];
-			*(mix++) = CLAMP(mix_val, -1.0f, 1.0f);
-		}
-	}
-}
+	while (pos < size) {
+		size_t end = size;
 
-static inline void mix_audio(enum audio_format format,
-		uint8_t *mix, struct circlebuf *buf, size_t size)
-{
-	switch (format) {
-	case AUDIO_FORMAT_UNKNOWN:
-		break;
+		if (line->volume_changes.num) {
+			struct volume_change *change =
+				line->volume_changes.array;
+			size_t change_pos = 0;
 
-	case AUDIO_FORMAT_U8BIT:
-	case AUDIO_FORMAT_U8BIT_PLANAR:
-		mix_u8(mix, buf, size); break;
+			if (change->timestamp > line->base_timestamp)
+				change_pos = ts_diff_bytes(audio,
+						change->timestamp,
+						line->base_timestamp);
 
-	case AUDIO_FORMAT_16BIT:
-	case AUDIO_FORMAT_16BIT_PLANAR:
-		mix_s16(mix, buf, size); break;
+			if (change_pos <= pos) {
+				start_volume_ramp(audio, line, change->volume);
+				da_erase(line->volume_changes, 0);
+				continue;
+			}
 
-	case AUDIO_FORMAT_32BIT:
-	case AUDIO_FORMAT_32BIT_PLANAR:
-		mix_s32(mix, buf, size); break;
+			if (change_pos < end)
+				end = change_pos;
+		}
 
-	case AUDIO_FORMAT_FLOAT:
-	case AUDIO_FORMAT_FLOAT_PLANAR:
-		mix_float(mix, buf, size); break;
+		add_mix_spans(audio, line, pos, end - pos);
+		pos = end;
 	}
 }
 
@@ -301,93 +606,158 @@ static inline bool mix_audio_line(struct audio_output *audio,
 {
 	size_t time_offset = ts_diff_bytes(audio,
 			line->base_timestamp, timestamp);
+
 	if (time_offset > size)
 		return false;
 
-	size -= time_offset;
+	/* a line short of data only mixes what it has, and keeps the volume
+	 * changes and ramp frames past it for the data still to come */
+	size = min_size(size - time_offset, line->buffers[0].size);
+	get_mix_spans(audio, line, size);
 
 #ifdef DEBUG_AUDIO
 	blog(LOG_DEBUG, "shaved off %lu bytes", size);
 #endif
 
-	for (size_t i = 0; i < audio->planes; i++) {
-		size_t pop_size = min_size(size, line->buffers[i].size);
+	for (size_t i = 0; i < audio->channels; i++) {
+		struct circlebuf *buf = &line->buffers[i];
+		float *mix = audio->mix_buffers[i].array +
+			time_offset / sizeof(float);
+		size_t pop_size = min_size(size, buf->size);
+
+		for (size_t j = 0; j < audio->mix_spans.num; j++) {
+			struct mix_span *span = audio->mix_spans.array + j;
+
+			if (span->offset >= pop_size)
+				break;
 
-		mix_audio(audio->info.format,
-				audio->mix_buffers[i].array + time_offset,
-				&line->buffers[i], pop_size);
+			mix_audio(mix + span->offset / sizeof(float), buf,
+					span->offset,
+					min_size(span->size,
+						pop_size - span->offset),
+					span->gain, span->gain_step);
+		}
+
+		circlebuf_pop_front(buf, NULL, pop_size);
 	}
 
 	return true;
 }
 
-static bool resample_audio_output(struct audio_input *input,
-		struct audio_data *data)
+/* converts the mix to a new block, or returns NULL if the resampler gave
+ * nothing this period */
+static struct audio_block *shared_resampler_resample(
+		struct shared_resampler *sr, struct block_pool *pool,
+		const struct audio_data *data)
 {
-	bool success = true;
+	struct audio_block *block;
+	uint8_t  *output[MAX_AV_PLANES];
+	uint32_t frames;
+	uint64_t offset;
+	size_t   plane_size;
 
-	if (input->resampler) {
-		uint8_t  *output[MAX_AV_PLANES];
-		uint32_t frames;
-		uint64_t offset;
+	memset(output, 0, sizeof(output));
 
-		memset(output, 0, sizeof(output));
+	if (!audio_resampler_resample(sr->resampler, output, &frames, &offset,
+				data->data, data->frames) || !frames)
+		return NULL;
 
-		success = audio_resampler_resample(input->resampler,
-				output, &frames, &offset,
-				data->data, data->frames);
+	plane_size = frames * sr->block_size;
+	block      = block_pool_get(pool, sr->planes, plane_size);
 
-		for (size_t i = 0; i < MAX_AV_PLANES; i++)
-			data->data[i] = output[i];
-		data->frames     = frames;
-		data->timestamp -= offset;
-	}
+	for (size_t i = 0; i < sr->planes; i++)
+		memcpy(block->buffer + i * plane_size, output[i], plane_size);
 
-	return success;
+	block->data.frames    = frames;
+	block->data.timestamp = data->timestamp - offset;
+	return block;
+}
+
+/* copies the mix to a new block for the inputs that take it unconverted */
+static struct audio_block *copy_mix_block(struct audio_output *audio,
+		const struct audio_data *data)
+{
+	size_t plane_size = data->frames * sizeof(float);
+	struct audio_block *block = block_pool_get(&audio->blocks,
+			audio->channels, plane_size);
+
+	for (size_t i = 0; i < audio->channels; i++)
+		memcpy(block->buffer + i * plane_size, data->data[i],
+				plane_size);
+
+	block->data.frames    = data->frames;
+	block->data.timestamp = data->timestamp;
+	return block;
 }
 
+/* queues the period to every input.  only the conversions are done here,
+ * the callbacks are run by the threads of the inputs */
 static inline void do_audio_output(struct audio_output *audio,
 		uint64_t timestamp, uint32_t frames)
 {
-	struct audio_data data;
+	struct audio_block *mix_block = NULL;
+	struct audio_data  data;
+
+	/* the only clamp the mix gets, where it leaves the float bus */
+	for (size_t i = 0; i < audio->channels; i++)
+		audio_clamp_float(audio->mix_buffers[i].array, frames);
+
 	for (size_t i = 0; i < MAX_AV_PLANES; i++)
-		data.data[i] = audio->mix_buffers[i].array;
+		data.data[i] = (const uint8_t*)audio->mix_buffers[i].array;
 	data.frames = frames;
 	data.timestamp = timestamp;
 	data.volume = 1.0f;
 
 	pthread_mutex_lock(&audio->input_mutex);
 
+	for (size_t i = 0; i < audio->resamplers.num; i++) {
+		struct shared_resampler *sr = audio->resamplers.array[i];
+		sr->block = shared_resampler_resample(sr, &audio->blocks,
+				&data);
+	}
+
 	for (size_t i = 0; i < audio->inputs.num; i++) {
-		struct audio_input *input = audio->inputs.array+i;
+		struct audio_input *input = audio->inputs.array[i];
+		struct audio_block *block;
+
+		if (input->resampler) {
+			block = input->resampler->block;
+		} else {
+			if (!mix_block)
+				mix_block = copy_mix_block(audio, &data);
+			block = mix_block;
+		}
+
+		if (block)
+			audio_input_push(audio->info.name, input, block);
+	}
 
-		if (resample_audio_output(input, &data))
-			input->callback(input->param, &data);
+	for (size_t i = 0; i < audio->resamplers.num; i++) {
+		struct shared_resampler *sr = audio->resamplers.array[i];
+		audio_block_release(sr->block);
+		sr->block = NULL;
 	}
 
+	audio_block_release(mix_block);
+
 	pthread_mutex_unlock(&audio->input_mutex);
 }
 
-static uint64_t mix_and_output(struct audio_output *audio, uint64_t audio_time,
+static void mix_and_output(struct audio_output *audio, uint64_t audio_time,
 		uint64_t prev_time)
 {
 	struct audio_line *line = audio->first_line;
-	uint32_t frames = (uint32_t)ts_diff_frames(audio, audio_time,
-	                                           prev_time);
-	size_t bytes = frames * audio->block_size;
+	uint32_t frames = audio->period_frames;
+	size_t bytes = frames * sizeof(float);
 
 #ifdef DEBUG_AUDIO
 	blog(LOG_DEBUG, "audio_time: %llu, prev_time: %llu, bytes: %lu",
 			audio_time, prev_time, bytes);
 #endif
 
-	/* return an adjusted audio_time according to the amount
-	 * of data that was sampled to ensure seamless transmission */
-	audio_time = prev_time + conv_frames_to_time(audio, frames);
-
 	/* resize and clear mix buffers */
-	for (size_t i = 0; i < audio->planes; i++) {
-		da_resize(audio->mix_buffers[i], bytes);
+	for (size_t i = 0; i < audio->channels; i++) {
+		da_resize(audio->mix_buffers[i], frames);
 		memset(audio->mix_buffers[i].array, 0, bytes);
 	}
 
@@ -421,30 +791,110 @@ static uint64_t mix_and_output(struct audio_output *audio, uint64_t audio_time,
 
 	/* output */
 	do_audio_output(audio, prev_time, frames);
+}
+
+/* a thread stalled for longer than this skips ahead instead of catching up */
+#define AUDIO_MAX_CATCHUP 1000000000ULL
+
+/*
+ * Audio time of the start of a period.  Like the video clock it is computed
+ * from the period count with the exact sample rate, so periods stay aligned
+ * to the sample clock however long the output runs.
+ */
+static uint64_t audio_clock_time(const struct audio_output *audio,
+		uint64_t period)
+{
+	uint64_t frames = period * audio->period_frames;
+	uint64_t rate   = audio->info.samples_per_sec;
 
-	return audio_time;
+	return audio->start_time + frames / rate * 1000000000ULL +
+		frames % rate * 1000000000ULL / rate;
 }
 
-/* sample audio 40 times a second */
-#define AUDIO_WAIT_TIME (1000/40)
+/*
+ * Sleeps to an absolute deadline.  Returns how far past the deadline it
+ * already was, or 0 if on time, in which case wakeup receives how long after
+ * the deadline it woke up.
+ */
+static uint64_t sleep_until(uint64_t target, uint64_t *wakeup)
+{
+	uint64_t now = os_gettime_ns();
+
+	if (now > target)
+		return now - target;
+
+	os_sleepto_ns(target);
+	now = os_gettime_ns();
+
+	*wakeup = now > target ? now - target : 0;
+	return 0;
+}
+
+static inline void update_timing_stats(struct audio_output *audio,
+		uint64_t lateness, uint64_t wakeup, uint64_t period_ns)
+{
+	struct audio_output_timing_stats *timing = &audio->timing;
+
+	timing->total_periods++;
+	if (!lateness)
+		time_stats_add(&timing->wakeup_jitter, wakeup);
+
+	if (lateness) {
+		timing->late_periods++;
+		if (lateness >= period_ns)
+			timing->overruns++;
+		if (lateness > timing->max_lateness_ns)
+			timing->max_lateness_ns = lateness;
+	}
+}
+
+/* moves the clock past a long stall, returning the periods skipped */
+static uint64_t skip_periods(struct audio_output *audio, uint64_t lateness)
+{
+	uint64_t period_ns = conv_frames_to_time(audio, audio->period_frames);
+	uint64_t skipped   = lateness / period_ns;
+
+	blog(LOG_WARNING, "Audio output '%s' stalled for %"PRIu64" ms, "
+	                  "skipping %"PRIu64" periods",
+	                  audio->info.name, lateness / 1000000, skipped);
+	return skipped;
+}
 
 static void *audio_thread(void *param)
 {
 	struct audio_output *audio = param;
 	uint64_t buffer_time = audio->info.buffer_ms * 1000000;
-	uint64_t prev_time = os_gettime_ns() - buffer_time;
-	uint64_t audio_time;
+	uint64_t period = 0;
+
+	audio->start_time = os_gettime_ns() - buffer_time;
 
 	while (event_try(&audio->stop_event) == EAGAIN) {
-		os_sleep_ms(AUDIO_WAIT_TIME);
+		uint64_t prev_time  = audio_clock_time(audio, period);
+		uint64_t audio_time = audio_clock_time(audio, period + 1);
+		uint64_t wakeup     = 0;
+		uint64_t skipped    = 0;
+		uint64_t lateness;
+
+		/* a period is mixed once all of it is buffer_time old */
+		lateness = sleep_until(audio_time + buffer_time, &wakeup);
+
+		if (lateness > AUDIO_MAX_CATCHUP) {
+			skipped     = skip_periods(audio, lateness);
+			period     += skipped;
+			prev_time   = audio_clock_time(audio, period);
+			audio_time  = audio_clock_time(audio, period + 1);
+		}
 
 		pthread_mutex_lock(&audio->line_mutex);
 
-		audio_time = os_gettime_ns() - buffer_time;
-		audio_time = mix_and_output(audio, audio_time, prev_time);
-		prev_time  = audio_time;
+		audio->timing.skipped_periods += skipped;
+		update_timing_stats(audio, lateness, wakeup,
+				audio_time - prev_time);
+		mix_and_output(audio, audio_time, prev_time);
 
 		pthread_mutex_unlock(&audio->line_mutex);
+
+		period++;
 	}
 
 	return NULL;
@@ -452,12 +902,12 @@ static void *audio_thread(void *param)
 
 /* ------------------------------------------------------------------------- */
 
-static size_t audio_get_input_idx(audio_t video,
+static size_t audio_get_input_idx(audio_t audio,
 		void (*callback)(void *param, const struct audio_data *data),
 		void *param)
 {
-	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct audio_input *input = video->inputs.array+i;
+	for (size_t i = 0; i < audio->inputs.num; i++) {
+		struct audio_input *input = audio->inputs.array[i];
 		if (input->callback == callback && input->param == param)
 			return i;
 	}
@@ -465,35 +915,106 @@ static size_t audio_get_input_idx(audio_t video,
 	return DARRAY_INVALID;
 }
 
+/* called with input_mutex held */
+static struct shared_resampler *get_shared_resampler(
+		struct audio_output *audio,
+		const struct audio_convert_info *conversion)
+{
+	struct shared_resampler *sr;
+	size_t channels;
+
+	for (size_t i = 0; i < audio->resamplers.num; i++) {
+		sr = audio->resamplers.array[i];
+
+		if (convert_info_equal(&sr->conversion, conversion)) {
+			sr->refs++;
+			return sr;
+		}
+	}
+
+	struct resample_info from = {
+		.format          = AUDIO_FORMAT_FLOAT_PLANAR,
+		.samples_per_sec = audio->info.samples_per_sec,
+		.speakers        = audio->info.speakers
+	};
+
+	struct resample_info to = {
+		.format          = conversion->format,
+		.samples_per_sec = conversion->samples_per_sec,
+		.speakers        = conversion->speakers
+	};
+
+	sr = bzalloc(sizeof(struct shared_resampler));
+	sr->conversion = *conversion;
+	sr->refs       = 1;
+	sr->resampler  = audio_resampler_create(&to, &from);
+	if (!sr->resampler) {
+		blog(LOG_WARNING, "audio_input_init: Failed to "
+		                  "create resampler");
+		bfree(sr);
+		return NULL;
+	}
+
+	channels = get_audio_channels(conversion->speakers);
+	if (is_audio_planar(conversion->format)) {
+		sr->planes     = channels;
+		sr->block_size = get_audio_bytes_per_channel(
+				conversion->format);
+	} else {
+		sr->planes     = 1;
+		sr->block_size = channels *
+			get_audio_bytes_per_channel(conversion->format);
+	}
+
+	da_push_back(audio->resamplers, &sr);
+	return sr;
+}
+
+/* called with input_mutex held */
+static void release_shared_resampler(struct audio_output *audio,
+		struct shared_resampler *sr)
+{
+	if (!sr || --sr->refs != 0)
+		return;
+
+	da_erase_item(audio->resamplers, &sr);
+	shared_resampler_destroy(sr);
+}
+
+/* called with input_mutex held.  undoes everything it did on failure */
 static inline bool audio_input_init(struct audio_input *input,
 		struct audio_output *audio)
 {
-	if (input->conversion.format          != audio->info.format          ||
+	if (pthread_mutex_init(&input->queue_mutex, NULL) != 0)
+		return false;
+	if (event_init(&input->queue_event, EVENT_TYPE_AUTO) != 0)
+		goto fail_event;
+
+	/* inputs are converted from the float planar mix, so even those
+	 * wanting info.format need a resampler unless it is float planar */
+	if (input->conversion.format          != AUDIO_FORMAT_FLOAT_PLANAR   ||
 	    input->conversion.samples_per_sec != audio->info.samples_per_sec ||
 	    input->conversion.speakers        != audio->info.speakers) {
-		struct resample_info from = {
-			.format          = audio->info.format,
-			.samples_per_sec = audio->info.samples_per_sec,
-			.speakers        = audio->info.speakers
-		};
-
-		struct resample_info to = {
-			.format          = input->conversion.format,
-			.samples_per_sec = input->conversion.samples_per_sec,
-			.speakers        = input->conversion.speakers
-		};
-
-		input->resampler = audio_resampler_create(&to, &from);
-		if (!input->resampler) {
-			blog(LOG_WARNING, "audio_input_init: Failed to "
-			                  "create resampler");
-			return false;
-		}
-	} else {
-		input->resampler = NULL;
+		input->resampler = get_shared_resampler(audio,
+				&input->conversion);
+		if (!input->resampler)
+			goto fail_resampler;
 	}
 
+	if (pthread_create(&input->thread, NULL, audio_input_thread,
+				input) != 0)
+		goto fail_thread;
+
+	input->thread_active = true;
 	return true;
+
+fail_thread:
+	release_shared_resampler(audio, input->resampler);
+fail_resampler:
+	event_destroy(&input->queue_event);
+fail_event:
+	pthread_mutex_destroy(&input->queue_mutex);
+	return false;
 }
 
 bool audio_output_connect(audio_t audio,
@@ -506,22 +1027,28 @@ bool audio_output_connect(audio_t audio,
 	pthread_mutex_lock(&audio->input_mutex);
 
 	if (audio_get_input_idx(audio, callback, param) == DARRAY_INVALID) {
-		struct audio_input input;
-		input.callback = callback;
-		input.param    = param;
+		struct audio_input *input;
+		input = bzalloc(sizeof(struct audio_input));
+
+		input->callback    = callback;
+		input->param       = param;
+		input->max_blocks  = AUDIO_INPUT_DEFAULT_QUEUE;
+		input->drop_policy = AUDIO_DROP_NONE;
 
 		if (conversion) {
-			input.conversion = *conversion;
+			input->conversion = *conversion;
 		} else {
-			input.conversion.format = audio->info.format;
-			input.conversion.speakers = audio->info.speakers;
-			input.conversion.samples_per_sec =
+			input->conversion.format = audio->info.format;
+			input->conversion.speakers = audio->info.speakers;
+			input->conversion.samples_per_sec =
 				audio->info.samples_per_sec;
 		}
 
-		success = audio_input_init(&input, audio);
+		success = audio_input_init(input, audio);
 		if (success)
 			da_push_back(audio->inputs, &input);
+		else
+			bfree(input);
 	}
 
 	pthread_mutex_unlock(&audio->input_mutex);
@@ -533,15 +1060,77 @@ void audio_output_disconnect(audio_t audio,
 		void (*callback)(void *param, const struct audio_data *data),
 		void *param)
 {
+	struct audio_input *input = NULL;
+
 	pthread_mutex_lock(&audio->input_mutex);
 
 	size_t idx = audio_get_input_idx(audio, callback, param);
 	if (idx != DARRAY_INVALID) {
-		audio_input_free(audio->inputs.array+idx);
+		input = audio->inputs.array[idx];
 		da_erase(audio->inputs, idx);
+
+		/* resamplers are only used under input_mutex, so unlike the
+		 * input itself, its resampler can go right away */
+		release_shared_resampler(audio, input->resampler);
+	}
+
+	pthread_mutex_unlock(&audio->input_mutex);
+
+	/* joins the thread of the input, which may still be delivering */
+	if (input)
+		audio_input_free(input);
+}
+
+bool audio_output_set_input_queue(audio_t audio,
+		void (*callback)(void *param, const struct audio_data *data),
+		void *param, uint32_t max_blocks,
+		enum audio_drop_policy drop_policy)
+{
+	struct audio_input *input;
+	size_t idx;
+
+	if (!max_blocks)
+		return false;
+
+	pthread_mutex_lock(&audio->input_mutex);
+
+	idx = audio_get_input_idx(audio, callback, param);
+	if (idx != DARRAY_INVALID) {
+		input = audio->inputs.array[idx];
+
+		pthread_mutex_lock(&input->queue_mutex);
+		input->max_blocks  = max_blocks;
+		input->drop_policy = drop_policy;
+		pthread_mutex_unlock(&input->queue_mutex);
+	}
+
+	pthread_mutex_unlock(&audio->input_mutex);
+	return idx != DARRAY_INVALID;
+}
+
+bool audio_output_get_input_stats(audio_t audio,
+		void (*callback)(void *param, const struct audio_data *data),
+		void *param, struct audio_input_stats *stats)
+{
+	struct audio_input *input;
+	size_t idx;
+
+	pthread_mutex_lock(&audio->input_mutex);
+
+	idx = audio_get_input_idx(audio, callback, param);
+	if (idx != DARRAY_INVALID) {
+		input = audio->inputs.array[idx];
+
+		pthread_mutex_lock(&input->queue_mutex);
+		stats->queued_blocks     = (uint32_t)audio_input_queued(input);
+		stats->max_queued_blocks = input->max_queued;
+		stats->delivered_blocks  = input->delivered;
+		stats->dropped_blocks    = input->dropped;
+		pthread_mutex_unlock(&input->queue_mutex);
 	}
 
 	pthread_mutex_unlock(&audio->input_mutex);
+	return idx != DARRAY_INVALID;
 }
 
 static inline bool valid_audio_params(struct audio_output_info *info)
@@ -563,10 +1152,15 @@ int audio_output_open(audio_t *audio, struct audio_output_info *info)
 
 	memcpy(&out->info, info, sizeof(struct audio_output_info));
 	pthread_mutex_init_value(&out->line_mutex);
+	pthread_mutex_init_value(&out->input_mutex);
+	pthread_mutex_init_value(&out->blocks.mutex);
 	out->channels   = get_audio_channels(info->speakers);
 	out->planes     = planar ? out->channels : 1;
 	out->block_size = (planar ? 1 : out->channels) *
 	                  get_audio_bytes_per_channel(info->format);
+	out->period_frames = info->period_frames ?
+		info->period_frames : AUDIO_OUTPUT_DEFAULT_PERIOD;
+	out->info.period_frames = out->period_frames;
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		goto fail;
@@ -576,6 +1170,8 @@ int audio_output_open(audio_t *audio, struct audio_output_info *info)
 		goto fail;
 	if (pthread_mutex_init(&out->input_mutex, NULL) != 0)
 		goto fail;
+	if (pthread_mutex_init(&out->blocks.mutex, NULL) != 0)
+		goto fail;
 	if (event_init(&out->stop_event, EVENT_TYPE_MANUAL) != 0)
 		goto fail;
 	if (pthread_create(&out->thread, NULL, audio_thread, out) != 0)
@@ -611,14 +1207,23 @@ void audio_output_close(audio_t audio)
 	}
 
 	for (size_t i = 0; i < audio->inputs.num; i++)
-		audio_input_free(audio->inputs.array+i);
+		audio_input_free(audio->inputs.array[i]);
+	da_free(audio->inputs);
+
+	for (size_t i = 0; i < audio->resamplers.num; i++)
+		shared_resampler_destroy(audio->resamplers.array[i]);
+	da_free(audio->resamplers);
 
 	for (size_t i = 0; i < MAX_AV_PLANES; i++)
 		da_free(audio->mix_buffers[i]);
+	da_free(audio->mix_spans);
+
+	/* every block has been released now the inputs are gone */
+	block_pool_free(&audio->blocks);
 
-	da_free(audio->inputs);
 	event_destroy(&audio->stop_event);
 	pthread_mutex_destroy(&audio->line_mutex);
+	pthread_mutex_destroy(&audio->input_mutex);
 	bfree(audio);
 }
 
@@ -681,115 +1286,71 @@ size_t audio_output_channels(audio_t audio)
 	return audio->channels;
 }
 
-/* TODO: Optimization of volume multiplication functions */
-
-static inline void mul_vol_u8bit(void *array, float volume, size_t total_num)
-{
-	uint8_t *vals = array;
-	int16_t vol = (int16_t)(volume * 127.0f);
-
-	for (size_t i = 0; i < total_num; i++) {
-		int16_t val = (int16_t)(vals[i] ^ 0x80) << 8;
-		vals[i] = (uint8_t)((val * vol / 127) + 128);
-	}
-}
-
-static inline void mul_vol_16bit(void *array, float volume, size_t total_num)
+uint32_t audio_output_period_frames(audio_t audio)
 {
-	uint16_t *vals = array;
-	int32_t vol = (int32_t)(volume * 32767.0f);
-
-	for (size_t i = 0; i < total_num; i++)
-		vals[i] = (int32_t)((int32_t)vals[i] * vol / 32767);
+	return audio->period_frames;
 }
 
-static inline float conv_24bit_to_float(uint8_t *vals)
+void audio_output_get_timing_stats(audio_t audio,
+		struct audio_output_timing_stats *stats)
 {
-	int32_t val = ((int32_t)vals[0]) |
-	              ((int32_t)vals[1] << 8) |
-	              ((int32_t)vals[2] << 16);
-
-	if ((val & 0x800000) != 0)
-		val |= 0xFF000000;
-
-	return (float)val / 8388607.0f;
-}
-
-static inline void conv_float_to_24bit(float fval, uint8_t *vals)
-{
-	int32_t val = (int32_t)(fval * 8388607.0f);
-	vals[0] = (val)       & 0xFF;
-	vals[1] = (val >> 8)  & 0xFF;
-	vals[2] = (val >> 16) & 0xFF;
+	pthread_mutex_lock(&audio->line_mutex);
+	*stats = audio->timing;
+	pthread_mutex_unlock(&audio->line_mutex);
 }
 
-static inline void mul_vol_24bit(void *array, float volume, size_t total_num)
+void audio_output_reset_timing_stats(audio_t audio)
 {
-	uint8_t *vals = array;
-
-	for (size_t i = 0; i < total_num; i++) {
-		float val = conv_24bit_to_float(vals) * volume;
-		conv_float_to_24bit(val, vals);
-		vals += 3;
-	}
+	pthread_mutex_lock(&audio->line_mutex);
+	memset(&audio->timing, 0, sizeof(audio->timing));
+	pthread_mutex_unlock(&audio->line_mutex);
 }
 
-static inline void mul_vol_32bit(void *array, float volume, size_t total_num)
+/* queues the volume of data placed at timestamp if it differs from the
+ * volume before it.  changes queued after it are dropped, as they belonged
+ * to data that this replaces */
+static void queue_volume_change(struct audio_line *line, uint64_t timestamp,
+		float volume)
 {
-	int32_t *vals = array;
+	struct volume_change change = {timestamp, volume};
+	struct volume_change *last  = da_end(line->volume_changes);
 
-	for (size_t i = 0; i < total_num; i++) {
-		float val = (float)vals[i] / 2147483647.0f;
-		vals[i] = (int32_t)(val * volume / 2147483647.0f);
+	while (last && last->timestamp >= timestamp) {
+		da_pop_back(line->volume_changes);
+		last = da_end(line->volume_changes);
 	}
-}
-
-static inline void mul_vol_float(void *array, float volume, size_t total_num)
-{
-	float *vals = array;
 
-	for (size_t i = 0; i < total_num; i++)
-		vals[i] *= volume;
+	if (volume != (last ? last->volume : line->volume))
+		da_push_back(line->volume_changes, &change);
 }
 
+/* places the data in the float planes of the line by position, converting
+ * it unless it is float planar already */
 static void audio_line_place_data_pos(struct audio_line *line,
 		const struct audio_data *data, size_t position)
 {
-	bool   planar     = line->audio->planes > 1;
-	size_t total_num  = data->frames * (planar ? 1 : line->audio->channels);
-	size_t total_size = data->frames * line->audio->block_size;
+	struct audio_output *audio = line->audio;
+	size_t total_size = data->frames * sizeof(float);
 
-	for (size_t i = 0; i < line->audio->planes; i++) {
-		da_copy_array(line->volume_buffers[i], data->data[i],
-				total_size);
+	queue_volume_change(line, data->timestamp, data->volume);
 
-		uint8_t *array = line->volume_buffers[i].array;
+	/* float planar data is already in the layout of the line */
+	if (audio->info.format == AUDIO_FORMAT_FLOAT_PLANAR) {
+		for (size_t i = 0; i < audio->channels; i++)
+			circlebuf_place(&line->buffers[i], position,
+					data->data[i], total_size);
+		return;
+	}
 
-		switch (line->audio->info.format) {
-		case AUDIO_FORMAT_U8BIT:
-		case AUDIO_FORMAT_U8BIT_PLANAR:
-			mul_vol_u8bit(array, data->volume, total_num);
-			break;
-		case AUDIO_FORMAT_16BIT:
-		case AUDIO_FORMAT_16BIT_PLANAR:
-			mul_vol_16bit(array, data->volume, total_num);
-			break;
-		case AUDIO_FORMAT_32BIT:
-		case AUDIO_FORMAT_32BIT_PLANAR:
-			mul_vol_32bit(array, data->volume, total_num);
-			break;
-		case AUDIO_FORMAT_FLOAT:
-		case AUDIO_FORMAT_FLOAT_PLANAR:
-			mul_vol_float(array, data->volume, total_num);
-			break;
-		case AUDIO_FORMAT_UNKNOWN:
-			blog(LOG_ERROR, "audio_line_place_data_pos: "
-					"Unknown format");
-			break;
-		}
+	da_resize(line->convert_buffer, data->frames);
+
+	for (size_t i = 0; i < audio->channels; i++) {
+		audio_convert_to_float(line->convert_buffer.array, data->data,
+				audio->info.format, audio->channels, i,
+				data->frames);
 
 		circlebuf_place(&line->buffers[i], position,
-				line->volume_buffers[i].array, total_size);
+				line->convert_buffer.array, total_size);
 	}
 }
 
@@ -803,7 +1364,7 @@ void audio_line_place_data(struct audio_line *line,
 	blog(LOG_DEBUG, "data->timestamp: %llu, line->base_timestamp: %llu, "
 			"pos: %lu, bytes: %lu, buf size: %lu",
 			data->timestamp, line->base_timestamp, pos,
-			data->frames * line->audio->block_size,
+			data->frames * sizeof(float),
 			line->buffers[0].size);
 #endif
 
@@ -822,6 +1383,10 @@ void audio_line_output(audio_line_t line, const struct audio_data *data)
 		 * action in all circumstances */
 		line->base_timestamp = data->timestamp -
 		                       line->audio->info.buffer_ms * 1000000;
+		line->volume      = data->volume;
+		line->mix_volume  = data->volume;
+		line->ramp_frames = 0;
+		da_resize(line->volume_changes, 0);
 		audio_line_place_data(line, data);
 
 	} else if (line->base_timestamp <= data->timestamp) {
@@ -19,6 +19,7 @@
 
 #include "media-io-defs.h"
 #include "../util/c99defs.h"
+#include "../util/time-stats.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -69,13 +70,34 @@ struct audio_data {
 	float               volume;
 };
 
+#define AUDIO_OUTPUT_DEFAULT_PERIOD 1024
+
 struct audio_output_info {
 	const char          *name;
 
 	uint32_t            samples_per_sec;
+
+	/**
+	 * Format of the data given to lines, and of the data given to
+	 * outputs connected without a conversion.  Audio is always mixed as
+	 * float planar, and converted from and to this format at the edges.
+	 */
 	enum audio_format   format;
 	enum speaker_layout speakers;
+
+	/**
+	 * How far behind the clock audio is mixed, to give lines time to
+	 * deliver their data.  Output latency is this plus one period, so
+	 * with 0 it is a single period.
+	 */
 	uint64_t            buffer_ms;
+
+	/**
+	 * Frames mixed and output at a time, or 0 for
+	 * AUDIO_OUTPUT_DEFAULT_PERIOD.  Periods are timed from the sample
+	 * clock, so every output has exactly this many frames.
+	 */
+	uint32_t            period_frames;
 };
 
 struct audio_convert_info {
@@ -157,6 +179,45 @@ static inline size_t get_audio_size(enum audio_format type,
 	       frames;
 }
 
+/*
+ *   Each connected input receives blocks on its own thread through a queue,
+ * so a slow input never holds up the mixer.  When the queue reaches its
+ * limit, the drop policy decides whether the queue keeps growing, or the
+ * oldest queued block or the incoming block is discarded.  Either way a
+ * warning is logged each time an input falls that far behind.
+ *
+ *   Inputs never drop by default, as consumers such as encoders stamp audio
+ * by counting the frames they receive, and a missing block would shift
+ * their audio against their video for the rest of the output.
+ */
+
+enum audio_drop_policy {
+	AUDIO_DROP_NONE,
+	AUDIO_DROP_OLDEST,
+	AUDIO_DROP_NEWEST,
+};
+
+#define AUDIO_INPUT_DEFAULT_QUEUE 16
+
+struct audio_input_stats {
+	uint32_t          queued_blocks;
+	uint32_t          max_queued_blocks;
+	uint64_t          delivered_blocks;
+	uint64_t          dropped_blocks;
+};
+
+/** Mixer thread timing, used to detect periods not mixed on schedule */
+struct audio_output_timing_stats {
+	uint64_t          total_periods;
+	uint64_t          late_periods;    /**< Deadline already passed */
+	uint64_t          overruns;        /**< Late by a period or more */
+	uint64_t          skipped_periods; /**< Dropped to resync the clock */
+	uint64_t          max_lateness_ns;
+
+	/** How long after each period deadline the mixer thread woke up */
+	struct time_stats wakeup_jitter;
+};
+
 #define AUDIO_OUTPUT_SUCCESS       0
 #define AUDIO_OUTPUT_INVALIDPARAM -1
 #define AUDIO_OUTPUT_FAIL         -2
@@ -172,10 +233,22 @@ EXPORT void audio_output_disconnect(audio_t video,
 		void (*callback)(void *param, const struct audio_data *data),
 		void *param);
 
+EXPORT bool audio_output_set_input_queue(audio_t audio,
+		void (*callback)(void *param, const struct audio_data *data),
+		void *param, uint32_t max_blocks,
+		enum audio_drop_policy drop_policy);
+EXPORT bool audio_output_get_input_stats(audio_t audio,
+		void (*callback)(void *param, const struct audio_data *data),
+		void *param, struct audio_input_stats *stats);
+
 EXPORT size_t audio_output_blocksize(audio_t audio);
 EXPORT size_t audio_output_planes(audio_t audio);
 EXPORT size_t audio_output_channels(audio_t audio);
+EXPORT uint32_t audio_output_period_frames(audio_t audio);
 EXPORT const struct audio_output_info *audio_output_getinfo(audio_t audio);
+EXPORT void audio_output_get_timing_stats(audio_t audio,
+		struct audio_output_timing_stats *stats);
+EXPORT void audio_output_reset_timing_stats(audio_t audio);
 
 EXPORT audio_line_t audio_output_createline(audio_t audio, const char *name);
 EXPORT void audio_line_destroy(audio_line_t line);
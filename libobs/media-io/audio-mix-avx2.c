@@ -0,0 +1,70 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/*
+ * AVX2 versions of the audio mixing kernels.  This file is compiled with
+ * AVX2 code generation enabled, so nothing in here may be called unless
+ * cpu_get_features() reports CPU_FEATURE_AVX2.  Every function must produce
+ * output identical to its SSE2 counterpart in audio-mix.c.
+ */
+
+#include "audio-mix.h"
+#include "audio-mix-avx2.h"
+#include <immintrin.h>
+
+void audio_mix_float_avx2(float *mix, const float *src, size_t count,
+		float gain, float gain_step)
+{
+	__m256  gain_base = _mm256_set1_ps(gain);
+	__m256  step      = _mm256_set1_ps(gain_step);
+	__m256i idx       = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i idx_add   = _mm256_set1_epi32(8);
+	size_t  i;
+
+	for (i = 0; i + 8 <= count; i += 8) {
+		__m256 gains = _mm256_add_ps(gain_base,
+				_mm256_mul_ps(_mm256_cvtepi32_ps(idx), step));
+		__m256 val   = _mm256_mul_ps(_mm256_loadu_ps(src + i), gains);
+
+		_mm256_storeu_ps(mix + i,
+				_mm256_add_ps(_mm256_loadu_ps(mix + i), val));
+		idx = _mm256_add_epi32(idx, idx_add);
+	}
+
+	for (; i < count; i++)
+		mix[i] += src[i] * (gain + (float)(int)i * gain_step);
+}
+
+void audio_clamp_float_avx2(float *mix, size_t count)
+{
+	__m256 min_val = _mm256_set1_ps(-1.0f);
+	__m256 max_val = _mm256_set1_ps(1.0f);
+	size_t i;
+
+	for (i = 0; i + 8 <= count; i += 8) {
+		__m256 val = _mm256_loadu_ps(mix + i);
+
+		val = _mm256_min_ps(_mm256_max_ps(val, min_val), max_val);
+		_mm256_storeu_ps(mix + i, val);
+	}
+
+	/* in the same order as the vector body, so NaN becomes -1.0 */
+	for (; i < count; i++) {
+		float val = mix[i] > -1.0f ? mix[i] : -1.0f;
+		mix[i] = val < 1.0f ? val : 1.0f;
+	}
+}
@@ -0,0 +1,30 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+/*
+ * AVX2 audio mixing kernels, private to media-io and selected at run time
+ * by audio-mix.c.  Only callable when cpu_get_features() reports
+ * CPU_FEATURE_AVX2.
+ */
+
+extern void audio_mix_float_avx2(float *mix, const float *src,
+		size_t count, float gain, float gain_step);
+extern void audio_clamp_float_avx2(float *mix, size_t count);
@@ -0,0 +1,161 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "audio-mix.h"
+#include "audio-mix-avx2.h"
+#include "../util/cpu-features.h"
+#include "../util/threading.h"
+#include <string.h>
+#include <emmintrin.h>
+
+/* ------------------------------------------------------------------------- */
+/* SSE2 */
+
+/* the gain of each sample is computed from its index rather than stepped
+ * from the last one, so every kernel gives the same result */
+static void mix_float_sse2(float *mix, const float *src, size_t count,
+		float gain, float gain_step)
+{
+	__m128  gain_base = _mm_set1_ps(gain);
+	__m128  step      = _mm_set1_ps(gain_step);
+	__m128i idx       = _mm_setr_epi32(0, 1, 2, 3);
+	__m128i idx_add   = _mm_set1_epi32(4);
+	size_t  i;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		__m128 gains = _mm_add_ps(gain_base,
+				_mm_mul_ps(_mm_cvtepi32_ps(idx), step));
+		__m128 val   = _mm_mul_ps(_mm_loadu_ps(src + i), gains);
+
+		_mm_storeu_ps(mix + i, _mm_add_ps(_mm_loadu_ps(mix + i), val));
+		idx = _mm_add_epi32(idx, idx_add);
+	}
+
+	for (; i < count; i++)
+		mix[i] += src[i] * (gain + (float)(int)i * gain_step);
+}
+
+static void clamp_float_sse2(float *mix, size_t count)
+{
+	__m128 min_val = _mm_set1_ps(-1.0f);
+	__m128 max_val = _mm_set1_ps(1.0f);
+	size_t i;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		__m128 val = _mm_loadu_ps(mix + i);
+
+		val = _mm_min_ps(_mm_max_ps(val, min_val), max_val);
+		_mm_storeu_ps(mix + i, val);
+	}
+
+	/* in the same order as the vector body, so NaN becomes -1.0 */
+	for (; i < count; i++) {
+		float val = mix[i] > -1.0f ? mix[i] : -1.0f;
+		mix[i] = val < 1.0f ? val : 1.0f;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* runtime kernel selection */
+
+struct mix_procs {
+	void (*mix_float)(float *mix, const float *src, size_t count,
+			float gain, float gain_step);
+	void (*clamp_float)(float *mix, size_t count);
+};
+
+static pthread_once_t   procs_once = PTHREAD_ONCE_INIT;
+static struct mix_procs procs;
+
+static void init_mix_procs(void)
+{
+	procs.mix_float   = mix_float_sse2;
+	procs.clamp_float = clamp_float_sse2;
+
+	if (cpu_has_feature(CPU_FEATURE_AVX2)) {
+		procs.mix_float   = audio_mix_float_avx2;
+		procs.clamp_float = audio_clamp_float_avx2;
+	}
+}
+
+static inline const struct mix_procs *get_procs(void)
+{
+	pthread_once(&procs_once, init_mix_procs);
+	return &procs;
+}
+
+void audio_mix_float(float *mix, const float *src, size_t count,
+		float gain, float gain_step)
+{
+	get_procs()->mix_float(mix, src, count, gain, gain_step);
+}
+
+void audio_clamp_float(float *mix, size_t count)
+{
+	get_procs()->clamp_float(mix, count);
+}
+
+/* ------------------------------------------------------------------------- */
+/* conversion to the mix format */
+
+#define CONVERT_LOOP(type, expr)                                              \
+do {                                                                          \
+	const type *vals = (const type*)src;                                  \
+	for (size_t i = 0; i < frames; i++)                                   \
+		out[i] = (float)(expr) * scale;                               \
+} while (false)
+
+void audio_convert_to_float(float *out, const uint8_t *const in[],
+		enum audio_format format, size_t channels, size_t channel,
+		size_t frames)
+{
+	bool          planar = is_audio_planar(format);
+	size_t        stride = planar ? 1 : channels;
+	const uint8_t *src   = planar ? in[channel] :
+		in[0] + channel * get_audio_bytes_per_channel(format);
+	float         scale;
+
+	switch (format) {
+	case AUDIO_FORMAT_UNKNOWN:
+		memset(out, 0, frames * sizeof(float));
+		break;
+
+	case AUDIO_FORMAT_U8BIT:
+	case AUDIO_FORMAT_U8BIT_PLANAR:
+		scale = 1.0f / 128.0f;
+		CONVERT_LOOP(uint8_t, (int)vals[i * stride] - 128);
+		break;
+
+	case AUDIO_FORMAT_16BIT:
+	case AUDIO_FORMAT_16BIT_PLANAR:
+		scale = 1.0f / 32768.0f;
+		CONVERT_LOOP(int16_t, vals[i * stride]);
+		break;
+
+	case AUDIO_FORMAT_32BIT:
+	case AUDIO_FORMAT_32BIT_PLANAR:
+		scale = 1.0f / 2147483648.0f;
+		CONVERT_LOOP(int32_t, vals[i * stride]);
+		break;
+
+	case AUDIO_FORMAT_FLOAT:
+	case AUDIO_FORMAT_FLOAT_PLANAR:
+		scale = 1.0f;
+		CONVERT_LOOP(float, vals[i * stride]);
+		break;
+	}
+}
@@ -0,0 +1,56 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+#include "audio-io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Audio is mixed as 32-bit float planar.  Lines are converted to it once as
+ * their data arrives, and their volume is applied as they are added to the
+ * mix.  Sums are left unclamped while the lines are added, and the finished
+ * mix is clamped once before it is output.  Neither pointer needs to be
+ * aligned.
+ */
+
+/**
+ * Adds count samples of src to mix, multiplied by a gain of
+ * gain + i * gain_step for sample i.  A step other than 0 ramps the gain
+ * from one volume to the next instead of jumping to it.
+ */
+EXPORT void audio_mix_float(float *mix, const float *src, size_t count,
+		float gain, float gain_step);
+
+/** Clamps count samples to -1.0..1.0 in place, and NaN to -1.0 */
+EXPORT void audio_clamp_float(float *mix, size_t count);
+
+/**
+ * Converts one channel of audio in the given format (packed or planar) to
+ * float samples.
+ */
+EXPORT void audio_convert_to_float(float *out, const uint8_t *const in[],
+		enum audio_format format, size_t channels, size_t channel,
+		size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,416 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/*
+ * AVX2 versions of the format conversion kernels.  This file is compiled
+ * with AVX2 code generation enabled, so nothing in here may be called
+ * unless cpu_get_features() reports CPU_FEATURE_AVX2.  Every function must
+ * produce output identical to its SSE2/scalar counterpart in
+ * format-conversion.c.
+ */
+
+#include "format-conversion.h"
+#include "format-conversion-avx2.h"
+#include <immintrin.h>
+
+static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
+{
+	return a < b ? a : b;
+}
+
+/* ------------------------------------------------------------------------- */
+/* packed 444 -> planar 420 */
+
+/* packs the luma bytes of 8 pixels from each of two lines, returning line1
+ * in the low 64 bits and line2 in the high 64 bits */
+static FORCE_INLINE __m128i pack_lum_avx2(__m256i line1, __m256i line2)
+{
+	const __m256i lum_shuf1 = _mm256_setr_epi8(
+			 1,  5,  9, 13, -1, -1, -1, -1,
+			-1, -1, -1, -1, -1, -1, -1, -1,
+			 1,  5,  9, 13, -1, -1, -1, -1,
+			-1, -1, -1, -1, -1, -1, -1, -1);
+	const __m256i lum_shuf2 = _mm256_setr_epi8(
+			-1, -1, -1, -1,  1,  5,  9, 13,
+			-1, -1, -1, -1, -1, -1, -1, -1,
+			-1, -1, -1, -1,  1,  5,  9, 13,
+			-1, -1, -1, -1, -1, -1, -1, -1);
+	const __m256i lum_perm  = _mm256_setr_epi32(0, 4, 1, 5, 2, 3, 6, 7);
+
+	__m256i lum = _mm256_or_si256(
+			_mm256_shuffle_epi8(line1, lum_shuf1),
+			_mm256_shuffle_epi8(line2, lum_shuf2));
+	lum = _mm256_permutevar8x32_epi32(lum, lum_perm);
+	return _mm256_castsi256_si128(lum);
+}
+
+/* averages the 2x2 chroma of 8 pixels, returning four 16-bit U/V pairs
+ * (U in the low byte, V in the high byte of each pair) */
+static FORCE_INLINE __m128i avg_chroma_avx2(__m256i line1, __m256i line2)
+{
+	const __m256i uv_mask  = _mm256_set1_epi16(0x00FF);
+	const __m256i uv_perm  = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+
+	__m256i add_val = _mm256_add_epi16(
+			_mm256_and_si256(line1, uv_mask),
+			_mm256_and_si256(line2, uv_mask));
+	__m256i avg_val = _mm256_add_epi16(add_val,
+			_mm256_shuffle_epi32(add_val, _MM_SHUFFLE(2, 3, 0, 1)));
+	avg_val = _mm256_srli_epi16(avg_val, 2);
+	avg_val = _mm256_permutevar8x32_epi32(avg_val, uv_perm);
+
+	__m128i uv = _mm256_castsi256_si128(avg_val);
+	return _mm_packus_epi16(uv, uv);
+}
+
+#define get_uv_sum(line1, line2, ch) \
+	((uint32_t)line1[ch] + line1[4 + ch] + line2[ch] + line2[4 + ch])
+
+/* scalar fallback for the last four pixels of a line pair when the width is
+ * not a multiple of eight; uv_step is 2 for interleaved (NV12) chroma */
+static inline void compress_tail(const uint8_t *img, uint32_t in_linesize,
+		uint8_t *lum0, uint8_t *lum1, uint8_t *u_out, uint8_t *v_out,
+		size_t uv_step)
+{
+	const uint8_t *line1 = img;
+	const uint8_t *line2 = img + in_linesize;
+
+	for (size_t i = 0; i < 2; i++) {
+		lum0[i*2]     = line1[1];
+		lum0[i*2 + 1] = line1[5];
+		lum1[i*2]     = line2[1];
+		lum1[i*2 + 1] = line2[5];
+
+		u_out[i*uv_step] = (uint8_t)(get_uv_sum(line1, line2, 0) >> 2);
+		v_out[i*uv_step] = (uint8_t)(get_uv_sum(line1, line2, 2) >> 2);
+
+		line1 += 8;
+		line2 += 8;
+	}
+}
+
+void compress_uyvx_to_i420_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane   = output[0];
+	uint8_t  *u_plane     = output[1];
+	uint8_t  *v_plane     = output[2];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t width_avx    = width & ~7;
+	uint32_t y;
+
+	const __m128i u_shuf = _mm_setr_epi8(0, 2, 4, 6, -1, -1, -1, -1,
+			-1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i v_shuf = _mm_setr_epi8(1, 3, 5, 7, -1, -1, -1, -1,
+			-1, -1, -1, -1, -1, -1, -1, -1);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < width_avx; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint8_t *lum0 = lum_plane + lum_y_pos + x;
+			uint8_t *lum1 = lum0 + out_linesize[0];
+			uint32_t chroma_pos = chroma_y_pos + (x>>1);
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+
+			__m128i lum = pack_lum_avx2(line1, line2);
+			_mm_storel_epi64((__m128i*)lum0, lum);
+			_mm_storel_epi64((__m128i*)lum1,
+					_mm_srli_si128(lum, 8));
+
+			__m128i uv = avg_chroma_avx2(line1, line2);
+			*(uint32_t*)(u_plane + chroma_pos) =
+				(uint32_t)_mm_cvtsi128_si32(
+						_mm_shuffle_epi8(uv, u_shuf));
+			*(uint32_t*)(v_plane + chroma_pos) =
+				(uint32_t)_mm_cvtsi128_si32(
+						_mm_shuffle_epi8(uv, v_shuf));
+		}
+
+		for (; x < width; x += 4) {
+			uint8_t *lum0 = lum_plane + lum_y_pos + x;
+			uint32_t chroma_pos = chroma_y_pos + (x>>1);
+
+			compress_tail(input + y_pos + x*4, in_linesize,
+					lum0, lum0 + out_linesize[0],
+					u_plane + chroma_pos,
+					v_plane + chroma_pos, 1);
+		}
+	}
+}
+
+void compress_uyvx_to_nv12_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane    = output[0];
+	uint8_t  *chroma_plane = output[1];
+	uint32_t width         = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t width_avx     = width & ~7;
+	uint32_t y;
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < width_avx; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint8_t *lum0 = lum_plane + lum_y_pos + x;
+			uint8_t *lum1 = lum0 + out_linesize[0];
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+
+			__m128i lum = pack_lum_avx2(line1, line2);
+			_mm_storel_epi64((__m128i*)lum0, lum);
+			_mm_storel_epi64((__m128i*)lum1,
+					_mm_srli_si128(lum, 8));
+
+			_mm_storel_epi64(
+				(__m128i*)(chroma_plane + chroma_y_pos + x),
+				avg_chroma_avx2(line1, line2));
+		}
+
+		for (; x < width; x += 4) {
+			uint8_t *lum0 = lum_plane + lum_y_pos + x;
+			uint8_t *uv   = chroma_plane + chroma_y_pos + x;
+
+			compress_tail(input + y_pos + x*4, in_linesize,
+					lum0, lum0 + out_linesize[0],
+					uv, uv + 1, 2);
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* planar 420/422 -> packed 444 */
+
+/* expands 8 luma values and 4 interleaved U/V pairs to 8 packed pixels */
+static FORCE_INLINE __m256i expand_444(__m128i lum, __m256i uv)
+{
+	return _mm256_or_si256(_mm256_cvtepu8_epi32(lum), uv);
+}
+
+/* duplicates 4 interleaved U/V pairs to 8 pixels and moves them to the
+ * second and third bytes of each pixel */
+static FORCE_INLINE __m256i expand_uv(__m128i uv)
+{
+	uv = _mm_unpacklo_epi16(uv, uv);
+	return _mm256_slli_epi32(_mm256_cvtepu16_epi32(uv), 8);
+}
+
+static inline void decompress_420_line(const uint8_t *lum0,
+		const uint8_t *lum1, __m256i uv,
+		uint32_t *output0, uint32_t *output1)
+{
+	__m128i lum_line0 = _mm_loadl_epi64((const __m128i*)lum0);
+	__m128i lum_line1 = _mm_loadl_epi64((const __m128i*)lum1);
+
+	_mm256_storeu_si256((__m256i*)output0, expand_444(lum_line0, uv));
+	_mm256_storeu_si256((__m256i*)output1, expand_444(lum_line1, uv));
+}
+
+void decompress_420_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y/2;
+	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize/4)/2;
+	uint32_t width_avx  = width_d2 & ~3;
+	uint32_t height_d2  = end_y/2;
+	uint32_t y;
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
+		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x;
+
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
+
+		for (x = 0; x < width_avx; x += 4) {
+			__m128i u  = _mm_cvtsi32_si128(
+					*(const int*)(chroma0 + x));
+			__m128i v  = _mm_cvtsi32_si128(
+					*(const int*)(chroma1 + x));
+			__m256i uv = expand_uv(_mm_unpacklo_epi8(u, v));
+
+			decompress_420_line(lum0 + x*2, lum1 + x*2, uv,
+					output0 + x*2, output1 + x*2);
+		}
+
+		for (; x < width_d2; x++) {
+			uint32_t out = (chroma0[x] << 8) | (chroma1[x] << 16);
+
+			output0[x*2]   = lum0[x*2]   | out;
+			output0[x*2+1] = lum0[x*2+1] | out;
+			output1[x*2]   = lum1[x*2]   | out;
+			output1[x*2+1] = lum1[x*2+1] | out;
+		}
+	}
+}
+
+void decompress_nv12_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y/2;
+	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize/4)/2;
+	uint32_t width_avx  = width_d2 & ~3;
+	uint32_t height_d2  = end_y/2;
+	uint32_t y;
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint16_t *chroma;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x;
+
+		chroma = (const uint16_t*)(input[1] + y * in_linesize[1]);
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
+
+		for (x = 0; x < width_avx; x += 4) {
+			__m256i uv = expand_uv(_mm_loadl_epi64(
+					(const __m128i*)(chroma + x)));
+
+			decompress_420_line(lum0 + x*2, lum1 + x*2, uv,
+					output0 + x*2, output1 + x*2);
+		}
+
+		for (; x < width_d2; x++) {
+			uint32_t out = chroma[x] << 8;
+
+			output0[x*2]   = lum0[x*2]   | out;
+			output0[x*2+1] = lum0[x*2+1] | out;
+			output1[x*2]   = lum1[x*2]   | out;
+			output1[x*2+1] = lum1[x*2+1] | out;
+		}
+	}
+}
+
+/* byte positions of the two lumas and the chroma of a packed 4:2:2 pair */
+struct packed_422_layout {
+	uint32_t lum0, lum1, u, v;
+};
+
+static inline struct packed_422_layout get_422_layout(
+		enum packed_422_order order)
+{
+	struct packed_422_layout layout = {0, 2, 1, 3};
+
+	if (order == PACKED_422_YVYU) {
+		layout.u = 3;
+		layout.v = 1;
+	} else if (order == PACKED_422_UYVY) {
+		layout.lum0 = 1;
+		layout.lum1 = 3;
+		layout.u    = 0;
+		layout.v    = 2;
+	}
+
+	return layout;
+}
+
+/* picks Y, U and V out of the two copies of each source pair made by
+ * dup_perm, and zeroes the high byte */
+static inline __m256i get_422_shuffle(const struct packed_422_layout *layout)
+{
+	int8_t shuf[32];
+
+	for (int i = 0; i < 32; i += 8) {
+		int8_t pair = (int8_t)(i % 16);
+
+		shuf[i]     = pair + (int8_t)layout->lum0;
+		shuf[i + 1] = pair + (int8_t)layout->u;
+		shuf[i + 2] = pair + (int8_t)layout->v;
+		shuf[i + 3] = -1;
+		shuf[i + 4] = pair + 4 + (int8_t)layout->lum1;
+		shuf[i + 5] = pair + 4 + (int8_t)layout->u;
+		shuf[i + 6] = pair + 4 + (int8_t)layout->v;
+		shuf[i + 7] = -1;
+	}
+
+	return _mm256_loadu_si256((const __m256i*)shuf);
+}
+
+void decompress_422_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize,
+		enum packed_422_order order)
+{
+	struct packed_422_layout layout = get_422_layout(order);
+	uint32_t width_d2  = min_uint32(in_linesize/4, out_linesize/8);
+	uint32_t width_avx = width_d2 & ~3;
+	uint32_t y;
+
+	/* each source pair is duplicated, one copy for each of its pixels */
+	const __m256i dup_perm = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+	const __m256i shuf     = get_422_shuffle(&layout);
+
+	for (y = start_y; y < end_y; y++) {
+		const uint32_t *input32;
+		uint32_t       *output32;
+		uint32_t       x;
+
+		input32  = (const uint32_t*)(input + y*in_linesize);
+		output32 = (uint32_t*)(output + y*out_linesize);
+
+		for (x = 0; x < width_avx; x += 4) {
+			__m128i src = _mm_loadu_si128(
+					(const __m128i*)(input32 + x));
+			__m256i out = _mm256_permutevar8x32_epi32(
+					_mm256_castsi128_si256(src), dup_perm);
+
+			_mm256_storeu_si256((__m256i*)(output32 + x*2),
+					_mm256_shuffle_epi8(out, shuf));
+		}
+
+		for (; x < width_d2; x++) {
+			uint32_t dw   = input32[x];
+			uint32_t lum0 = (dw >> layout.lum0*8) & 0xFF;
+			uint32_t lum1 = (dw >> layout.lum1*8) & 0xFF;
+			uint32_t u    = (dw >> layout.u*8)    & 0xFF;
+			uint32_t v    = (dw >> layout.v*8)    & 0xFF;
+
+			output32[x*2]   = lum0 | (u << 8) | (v << 16);
+			output32[x*2+1] = lum1 | (u << 8) | (v << 16);
+		}
+	}
+}
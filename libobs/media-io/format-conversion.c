@@ -16,6 +16,9 @@
 ******************************************************************************/
 
 #include "format-conversion.h"
+#include "format-conversion-avx2.h"
+#include "../util/cpu-features.h"
+#include "../util/threading.h"
 #include <xmmintrin.h>
 #include <emmintrin.h>
 
@@ -78,7 +81,7 @@ static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
 	return a < b ? a : b;
 }
 
-void compress_uyvx_to_i420(
+static void compress_uyvx_to_i420_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
@@ -116,7 +119,7 @@ void compress_uyvx_to_i420(
 	}
 }
 
-void compress_uyvx_to_nv12(
+static void compress_uyvx_to_nv12_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
@@ -152,55 +155,107 @@ void compress_uyvx_to_nv12(
 	}
 }
 
-void decompress_420(
+/*
+ * Unpacking to packed 444 YUV: each output pixel is a dword with luma in the
+ * low byte, then U and V, and zero in the high byte, whatever the order of
+ * the input.  This matches the *_Unpack techniques of
+ * format_conversion.effect, so a frame looks the same whichever unpacks it.
+ * The vector loops expand 8 chroma pairs (16 pixels) at a time by
+ * interleaving the planes with unpack instructions; the scalar loops handle
+ * the remainder of each line.
+ */
+
+static FORCE_INLINE void expand_420_line(const uint8_t *lum,
+		__m128i u_dup, __m128i v_dup, uint32_t *output)
+{
+	__m128i zero  = _mm_setzero_si128();
+	__m128i lum16 = _mm_loadu_si128((const __m128i*)lum);
+	__m128i yu_lo = _mm_unpacklo_epi8(lum16, u_dup);
+	__m128i yu_hi = _mm_unpackhi_epi8(lum16, u_dup);
+	__m128i v_lo  = _mm_unpacklo_epi8(v_dup, zero);
+	__m128i v_hi  = _mm_unpackhi_epi8(v_dup, zero);
+
+	__m128i *out  = (__m128i*)output;
+
+	_mm_storeu_si128(out,     _mm_unpacklo_epi16(yu_lo, v_lo));
+	_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(yu_lo, v_lo));
+	_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(yu_hi, v_hi));
+	_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(yu_hi, v_hi));
+}
+
+/* u and v hold 8 chroma samples each in their low halves */
+static FORCE_INLINE void expand_420_block(const uint8_t *lum0,
+		const uint8_t *lum1, __m128i u, __m128i v,
+		uint32_t *output0, uint32_t *output1)
+{
+	__m128i u_dup = _mm_unpacklo_epi8(u, u);
+	__m128i v_dup = _mm_unpacklo_epi8(v, v);
+
+	expand_420_line(lum0, u_dup, v_dup, output0);
+	expand_420_line(lum1, u_dup, v_dup, output1);
+}
+
+static void decompress_420_sse2(
 		const uint8_t *const input[], const uint32_t in_linesize[],
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output, uint32_t out_linesize)
 {
 	uint32_t start_y_d2 = start_y/2;
-	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize)/2;
+	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize/4)/2;
+	uint32_t width_sse  = width_d2 & ~7;
 	uint32_t height_d2  = end_y/2;
 	uint32_t y;
 
 	for (y = start_y_d2; y < height_d2; y++) {
 		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
 		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
-		register const uint8_t *lum0, *lum1;
-		register uint32_t *output0, *output1;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
 		uint32_t x;
 
 		lum0 = input[0] + y * 2 * in_linesize[0];
 		lum1 = lum0 + in_linesize[0];
-		output0 = (uint32_t*)(output + y * 2 * in_linesize[0]);
-		output1 = (uint32_t*)((uint8_t*)output0 + in_linesize[0]);
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
+
+		for (x = 0; x < width_sse; x += 8) {
+			__m128i u = _mm_loadl_epi64(
+					(const __m128i*)(chroma0 + x));
+			__m128i v = _mm_loadl_epi64(
+					(const __m128i*)(chroma1 + x));
 
-		for (x = 0; x < width_d2; x++) {
-			uint32_t out;
-			out = (*(chroma0++) << 8) | (*(chroma1++) << 16);
+			expand_420_block(lum0 + x*2, lum1 + x*2, u, v,
+					output0 + x*2, output1 + x*2);
+		}
 
-			*(output0++) = *(lum0++) | out;
-			*(output0++) = *(lum0++) | out;
+		for (; x < width_d2; x++) {
+			uint32_t out = (chroma0[x] << 8) | (chroma1[x] << 16);
 
-			*(output1++) = *(lum1++) | out;
-			*(output1++) = *(lum1++) | out;
+			output0[x*2]   = lum0[x*2]   | out;
+			output0[x*2+1] = lum0[x*2+1] | out;
+			output1[x*2]   = lum1[x*2]   | out;
+			output1[x*2+1] = lum1[x*2+1] | out;
 		}
 	}
 }
 
-void decompress_nv12(
+static void decompress_nv12_sse2(
 		const uint8_t *const input[], const uint32_t in_linesize[],
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output, uint32_t out_linesize)
 {
 	uint32_t start_y_d2 = start_y/2;
-	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize)/2;
+	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize/4)/2;
+	uint32_t width_sse  = width_d2 & ~7;
 	uint32_t height_d2  = end_y/2;
 	uint32_t y;
 
+	__m128i lo_mask = _mm_set1_epi16(0x00FF);
+
 	for (y = start_y_d2; y < height_d2; y++) {
 		const uint16_t *chroma;
-		register const uint8_t *lum0, *lum1;
-		register uint32_t *output0, *output1;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
 		uint32_t x;
 
 		chroma = (const uint16_t*)(input[1] + y * in_linesize[1]);
@@ -209,66 +264,203 @@ void decompress_nv12(
 		output0 = (uint32_t*)(output + y * 2 * out_linesize);
 		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
 
-		for (x = 0; x < width_d2; x++) {
-			uint32_t out = *(chroma++) << 8;
+		for (x = 0; x < width_sse; x += 8) {
+			__m128i uv = _mm_loadu_si128(
+					(const __m128i*)(chroma + x));
+			__m128i u  = _mm_and_si128(uv, lo_mask);
+			__m128i v  = _mm_srli_epi16(uv, 8);
 
-			*(output0++) = *(lum0++) | out;
-			*(output0++) = *(lum0++) | out;
+			expand_420_block(lum0 + x*2, lum1 + x*2,
+					_mm_packus_epi16(u, u),
+					_mm_packus_epi16(v, v),
+					output0 + x*2, output1 + x*2);
+		}
 
-			*(output1++) = *(lum1++) | out;
-			*(output1++) = *(lum1++) | out;
+		for (; x < width_d2; x++) {
+			uint32_t out = chroma[x] << 8;
+
+			output0[x*2]   = lum0[x*2]   | out;
+			output0[x*2+1] = lum0[x*2+1] | out;
+			output1[x*2]   = lum1[x*2]   | out;
+			output1[x*2+1] = lum1[x*2+1] | out;
 		}
 	}
 }
 
-void decompress_422(
+/* byte positions of the two lumas and the chroma of a packed 4:2:2 pair */
+struct packed_422_layout {
+	uint32_t lum0, lum1, u, v;
+};
+
+static inline struct packed_422_layout get_422_layout(
+		enum packed_422_order order)
+{
+	struct packed_422_layout layout = {0, 2, 1, 3};
+
+	if (order == PACKED_422_YVYU) {
+		layout.u = 3;
+		layout.v = 1;
+	} else if (order == PACKED_422_UYVY) {
+		layout.lum0 = 1;
+		layout.lum1 = 3;
+		layout.u    = 0;
+		layout.v    = 2;
+	}
+
+	return layout;
+}
+
+static FORCE_INLINE __m128i get_422_byte(__m128i src, uint32_t pos)
+{
+	return _mm_and_si128(_mm_srl_epi32(src, _mm_cvtsi32_si128(pos*8)),
+			_mm_set1_epi32(0xFF));
+}
+
+static void decompress_422_sse2(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output, uint32_t out_linesize,
-		bool leading_lum)
+		enum packed_422_order order)
 {
-	uint32_t width_d2 = min_uint32(in_linesize, out_linesize)/2;
+	struct packed_422_layout layout = get_422_layout(order);
+	uint32_t width_d2  = min_uint32(in_linesize/4, out_linesize/8);
+	uint32_t width_sse = width_d2 & ~3;
 	uint32_t y;
 
-	register const uint32_t *input32;
-	register const uint32_t *input32_end;
-	register uint32_t       *output32;
+	for (y = start_y; y < end_y; y++) {
+		const uint32_t *input32;
+		uint32_t       *output32;
+		uint32_t       x;
+
+		input32  = (const uint32_t*)(input + y*in_linesize);
+		output32 = (uint32_t*)(output + y*out_linesize);
+
+		for (x = 0; x < width_sse; x += 4) {
+			__m128i src = _mm_loadu_si128(
+					(const __m128i*)(input32 + x));
+			__m128i u = get_422_byte(src, layout.u);
+			__m128i v = get_422_byte(src, layout.v);
+			__m128i chroma = _mm_or_si128(_mm_slli_epi32(u, 8),
+					_mm_slli_epi32(v, 16));
+			__m128i first  = _mm_or_si128(chroma,
+					get_422_byte(src, layout.lum0));
+			__m128i second = _mm_or_si128(chroma,
+					get_422_byte(src, layout.lum1));
+
+			_mm_storeu_si128((__m128i*)(output32 + x*2),
+					_mm_unpacklo_epi32(first, second));
+			_mm_storeu_si128((__m128i*)(output32 + x*2 + 4),
+					_mm_unpackhi_epi32(first, second));
+		}
 
-	if (leading_lum) {
-		for (y = start_y; y < end_y; y++) {
-			input32     = (const uint32_t*)(input + y*in_linesize);
-			input32_end = input32 + width_d2;
-			output32    = (uint32_t*)(output + y*out_linesize);
+		for (; x < width_d2; x++) {
+			uint32_t dw   = input32[x];
+			uint32_t lum0 = (dw >> layout.lum0*8) & 0xFF;
+			uint32_t lum1 = (dw >> layout.lum1*8) & 0xFF;
+			uint32_t u    = (dw >> layout.u*8)    & 0xFF;
+			uint32_t v    = (dw >> layout.v*8)    & 0xFF;
 
-			while(input32 < input32_end) {
-				register uint32_t dw = *input32;
+			output32[x*2]   = lum0 | (u << 8) | (v << 16);
+			output32[x*2+1] = lum1 | (u << 8) | (v << 16);
+		}
+	}
+}
 
-				output32[0] = dw;
-				dw &= 0xFFFFFF00;
-				dw |= (uint8_t)(dw>>16);
-				output32[1] = dw;
+/* ------------------------------------------------------------------------- */
+/* runtime kernel selection */
 
-				output32 += 2;
-				input32++;
-			}
-		}
-	} else {
-		for (y = start_y; y < end_y; y++) {
-			input32     = (const uint32_t*)(input + y*in_linesize);
-			input32_end = input32 + width_d2;
-			output32    = (uint32_t*)(output + y*out_linesize);
-
-			while (input32 < input32_end) {
-				register uint32_t dw = *input32;
-
-				output32[0] = dw;
-				dw &= 0xFFFF00FF;
-				dw |= (dw>>16) & 0xFF00;
-				output32[1] = dw;
-
-				output32 += 2;
-				input32++;
-			}
-		}
+typedef void (*compress_proc_t)(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[]);
+
+typedef void (*decompress_planar_proc_t)(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize);
+
+typedef void (*decompress_packed_proc_t)(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize,
+		enum packed_422_order order);
+
+struct conversion_procs {
+	compress_proc_t          compress_i420;
+	compress_proc_t          compress_nv12;
+	decompress_planar_proc_t decompress_420;
+	decompress_planar_proc_t decompress_nv12;
+	decompress_packed_proc_t decompress_422;
+};
+
+static pthread_once_t          procs_once = PTHREAD_ONCE_INIT;
+static struct conversion_procs procs;
+
+static void init_conversion_procs(void)
+{
+	procs.compress_i420    = compress_uyvx_to_i420_sse2;
+	procs.compress_nv12    = compress_uyvx_to_nv12_sse2;
+	procs.decompress_420   = decompress_420_sse2;
+	procs.decompress_nv12  = decompress_nv12_sse2;
+	procs.decompress_422   = decompress_422_sse2;
+
+	if (cpu_has_feature(CPU_FEATURE_AVX2)) {
+		procs.compress_i420   = compress_uyvx_to_i420_avx2;
+		procs.compress_nv12   = compress_uyvx_to_nv12_avx2;
+		procs.decompress_420  = decompress_420_avx2;
+		procs.decompress_nv12 = decompress_nv12_avx2;
+		procs.decompress_422  = decompress_422_avx2;
 	}
 }
+
+static inline const struct conversion_procs *get_procs(void)
+{
+	pthread_once(&procs_once, init_conversion_procs);
+	return &procs;
+}
+
+void compress_uyvx_to_i420(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	get_procs()->compress_i420(input, in_linesize, start_y, end_y,
+			output, out_linesize);
+}
+
+void compress_uyvx_to_nv12(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	get_procs()->compress_nv12(input, in_linesize, start_y, end_y,
+			output, out_linesize);
+}
+
+void decompress_420(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	get_procs()->decompress_420(input, in_linesize, start_y, end_y,
+			output, out_linesize);
+}
+
+void decompress_nv12(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	get_procs()->decompress_nv12(input, in_linesize, start_y, end_y,
+			output, out_linesize);
+}
+
+void decompress_422(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize,
+		enum packed_422_order order)
+{
+	get_procs()->decompress_422(input, in_linesize, start_y, end_y,
+			output, out_linesize, order);
+}
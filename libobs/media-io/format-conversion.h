@@ -27,6 +27,13 @@ extern "C" {
  * Functions for converting to and from packed 444 YUV
  */
 
+/** Byte order of the pixel pairs of a packed 4:2:2 image */
+enum packed_422_order {
+	PACKED_422_YUYV, /**< YUY2 */
+	PACKED_422_YVYU,
+	PACKED_422_UYVY,
+};
+
 EXPORT void compress_uyvx_to_i420(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
@@ -51,7 +58,7 @@ EXPORT void decompress_422(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output, uint32_t out_linesize,
-		bool leading_lum);
+		enum packed_422_order order);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,244 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "../util/bmem.h"
+#include "../util/platform.h"
+#include "../util/threading.h"
+
+#include "slice-pool.h"
+
+#define MAX_SLICE_THREADS 16
+#define MIN_SLICE_ROWS    16
+
+struct slice_worker {
+	struct slice_pool *pool;
+	pthread_t         thread;
+	uint32_t          band;
+	uint32_t          start_y;
+	uint32_t          end_y;
+};
+
+struct slice_pool {
+	pthread_mutex_t     run_mutex;
+	pthread_mutex_t     mutex;
+	pthread_cond_t      start_cond;
+	pthread_cond_t      done_cond;
+
+	uint64_t            generation;
+	uint32_t            remaining;
+	bool                exit;
+
+	slice_band_proc_t   proc;
+	void                *param;
+
+	struct slice_worker *workers;
+	uint32_t            num_workers;
+};
+
+static void *slice_worker_thread(void *data)
+{
+	struct slice_worker *worker = data;
+	struct slice_pool   *pool   = worker->pool;
+	uint64_t            generation = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	for (;;) {
+		while (generation == pool->generation && !pool->exit)
+			pthread_cond_wait(&pool->start_cond, &pool->mutex);
+
+		if (pool->exit)
+			break;
+
+		generation = pool->generation;
+
+		pthread_mutex_unlock(&pool->mutex);
+
+		if (worker->start_y < worker->end_y)
+			pool->proc(pool->param, worker->band,
+					worker->start_y, worker->end_y);
+
+		pthread_mutex_lock(&pool->mutex);
+
+		if (--pool->remaining == 0)
+			pthread_cond_signal(&pool->done_cond);
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+int slice_pool_create(slice_pool_t *pool_out, uint32_t num_threads)
+{
+	struct slice_pool *pool;
+
+	if (!pool_out)
+		return SLICE_POOL_INVALIDPARAM;
+
+	if (num_threads == 0)
+		num_threads = (uint32_t)os_get_logical_cores();
+	if (num_threads > MAX_SLICE_THREADS)
+		num_threads = MAX_SLICE_THREADS;
+	if (num_threads == 0)
+		num_threads = 1;
+
+	pool = bzalloc(sizeof(struct slice_pool));
+	pool->num_workers = num_threads - 1;
+
+	if (pthread_mutex_init(&pool->run_mutex, NULL) != 0)
+		goto fail_run_mutex;
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0)
+		goto fail_mutex;
+	if (pthread_cond_init(&pool->start_cond, NULL) != 0)
+		goto fail_start_cond;
+	if (pthread_cond_init(&pool->done_cond, NULL) != 0)
+		goto fail_done_cond;
+
+	if (pool->num_workers)
+		pool->workers = bzalloc(sizeof(struct slice_worker) *
+				pool->num_workers);
+
+	for (uint32_t i = 0; i < pool->num_workers; i++) {
+		struct slice_worker *worker = pool->workers+i;
+		worker->pool = pool;
+		worker->band = i + 1;
+
+		if (pthread_create(&worker->thread, NULL, slice_worker_thread,
+					worker) != 0) {
+			blog(LOG_WARNING, "slice_pool_create: Failed to "
+			                  "create worker thread");
+			pool->num_workers = i;
+			break;
+		}
+	}
+
+	*pool_out = pool;
+	return SLICE_POOL_SUCCESS;
+
+fail_done_cond:
+	pthread_cond_destroy(&pool->start_cond);
+fail_start_cond:
+	pthread_mutex_destroy(&pool->mutex);
+fail_mutex:
+	pthread_mutex_destroy(&pool->run_mutex);
+fail_run_mutex:
+	bfree(pool);
+	return SLICE_POOL_FAIL;
+}
+
+void slice_pool_destroy(slice_pool_t pool)
+{
+	if (!pool)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->exit = true;
+	pthread_cond_broadcast(&pool->start_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (uint32_t i = 0; i < pool->num_workers; i++)
+		pthread_join(pool->workers[i].thread, NULL);
+
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->start_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_mutex_destroy(&pool->run_mutex);
+	bfree(pool->workers);
+	bfree(pool);
+}
+
+uint32_t slice_pool_num_threads(slice_pool_t pool)
+{
+	return pool ? pool->num_workers + 1 : 1;
+}
+
+static inline uint32_t get_band_size(uint32_t height, uint32_t bands,
+		uint32_t align)
+{
+	uint32_t size = (height + bands - 1) / bands;
+	if (size < MIN_SLICE_ROWS)
+		size = MIN_SLICE_ROWS;
+	return (size + align - 1) / align * align;
+}
+
+void slice_pool_run_bands(slice_pool_t pool, slice_band_proc_t proc,
+		void *param, uint32_t height, uint32_t align)
+{
+	uint32_t band_size;
+	uint32_t cur_y;
+
+	if (!align)
+		align = 1;
+
+	if (!pool || !pool->num_workers || height <= MIN_SLICE_ROWS) {
+		proc(param, 0, 0, height);
+		return;
+	}
+
+	band_size = get_band_size(height, pool->num_workers + 1, align);
+	cur_y     = band_size < height ? band_size : height;
+
+	/* the workers take one run at a time */
+	pthread_mutex_lock(&pool->run_mutex);
+	pthread_mutex_lock(&pool->mutex);
+
+	pool->proc  = proc;
+	pool->param = param;
+
+	for (uint32_t i = 0; i < pool->num_workers; i++) {
+		struct slice_worker *worker = pool->workers+i;
+		uint32_t end_y = cur_y + band_size;
+
+		worker->start_y = cur_y;
+		worker->end_y   = end_y < height ? end_y : height;
+		cur_y           = worker->end_y;
+	}
+
+	pool->remaining = pool->num_workers;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	proc(param, 0, 0, band_size < height ? band_size : height);
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->remaining)
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+	pthread_mutex_unlock(&pool->run_mutex);
+}
+
+struct slice_run {
+	slice_proc_t proc;
+	void         *param;
+};
+
+static void run_slice(void *param, uint32_t band, uint32_t start_y,
+		uint32_t end_y)
+{
+	struct slice_run *run = param;
+	run->proc(run->param, start_y, end_y);
+
+	UNUSED_PARAMETER(band);
+}
+
+void slice_pool_run(slice_pool_t pool, slice_proc_t proc, void *param,
+		uint32_t height, uint32_t align)
+{
+	struct slice_run run = {proc, param};
+	slice_pool_run_bands(pool, run_slice, &run, height, align);
+}
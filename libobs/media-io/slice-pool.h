@@ -0,0 +1,75 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Persistent worker pool used to split per-frame work (format conversion,
+ * scaling) into horizontal bands of rows.  The calling thread always
+ * processes the first band itself, and slice_pool_run does not return until
+ * every band has been processed.  A pool may be shared between threads, in
+ * which case their runs take turns.
+ */
+
+struct slice_pool;
+typedef struct slice_pool *slice_pool_t;
+
+typedef void (*slice_proc_t)(void *param, uint32_t start_y, uint32_t end_y);
+typedef void (*slice_band_proc_t)(void *param, uint32_t band,
+		uint32_t start_y, uint32_t end_y);
+
+#define SLICE_POOL_SUCCESS       0
+#define SLICE_POOL_INVALIDPARAM -1
+#define SLICE_POOL_FAIL         -2
+
+/**
+ * Creates a slice pool.  num_threads is the total number of threads that
+ * process bands including the caller, so a value of 1 creates no workers.
+ * A value of 0 uses the number of logical cores.
+ */
+EXPORT int slice_pool_create(slice_pool_t *pool, uint32_t num_threads);
+EXPORT void slice_pool_destroy(slice_pool_t pool);
+
+/** Returns the total number of threads that process bands */
+EXPORT uint32_t slice_pool_num_threads(slice_pool_t pool);
+
+/**
+ * Splits the rows [0, height) into bands and calls proc for each band in
+ * parallel.  Each band starts on a multiple of 'align' rows (for example, 2
+ * for 4:2:0 chroma subsampling).  If pool is NULL, proc is called once on
+ * the calling thread for the entire range.
+ */
+EXPORT void slice_pool_run(slice_pool_t pool, slice_proc_t proc, void *param,
+		uint32_t height, uint32_t align);
+
+/**
+ * Same as slice_pool_run, but also passes proc the index of its band, which
+ * is below slice_pool_num_threads(pool).  No two bands of a run have the
+ * same index, so each can use its own scratch memory allocated up front.
+ */
+EXPORT void slice_pool_run_bands(slice_pool_t pool, slice_band_proc_t proc,
+		void *param, uint32_t height, uint32_t align);
+
+#ifdef __cplusplus
+}
+#endif
@@ -16,33 +16,486 @@
 ******************************************************************************/
 
 #include <assert.h>
+#include <stddef.h>
 #include "../util/bmem.h"
 #include "../util/platform.h"
 #include "../util/threading.h"
 #include "../util/darray.h"
+#include "../util/circlebuf.h"
 
 #include "format-conversion.h"
 #include "video-io.h"
 #include "video-frame.h"
 #include "video-scaler.h"
 
-#define MAX_CONVERT_BUFFERS 3
+/* ------------------------------------------------------------------------- */
+/* frame pool */
+
+/*
+ *   Every frame given to a video input callback is a pool_frame, which owns
+ * its buffer and is returned to its pool once the last reference is
+ * released.
+ */
+
+struct frame_pool;
+struct derived_frame;
+
+struct pool_frame {
+	struct video_data          data; /* must be first */
+	struct video_frame         frame;
+	struct frame_pool          *pool;
+	volatile long              refs;
+	struct pool_frame          *next;
+
+	/* scaled frames made along with this one, and whether this one was
+	 * left unconverted because only they are used */
+	struct derived_frame       *derived;
+	bool                       unconverted;
+
+	/* set on frames that wrap planes owned by the caller rather than a
+	 * pool buffer, which are handed back once the last reference goes */
+	void                       (*release)(void *param);
+	void                       *release_param;
+};
 
-struct video_input {
+struct derived_frame {
+	struct pool_frame          *frame;
+	struct derived_frame       *next;
+};
+
+struct frame_pool {
+	pthread_mutex_t            mutex;
+	volatile long              refs;
+
+	enum video_format          format;
+	uint32_t                   width;
+	uint32_t                   height;
+
+	struct pool_frame          *free_frames;
+	uint32_t                   num_frames;
+	uint32_t                   num_free;
+	uint64_t                   allocations;
+	uint64_t                   reuses;
+};
+
+static struct frame_pool *frame_pool_create(enum video_format format,
+		uint32_t width, uint32_t height)
+{
+	struct frame_pool *pool = bzalloc(sizeof(struct frame_pool));
+
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0) {
+		bfree(pool);
+		return NULL;
+	}
+
+	pool->refs   = 1;
+	pool->format = format;
+	pool->width  = width;
+	pool->height = height;
+	return pool;
+}
+
+static void frame_pool_release(struct frame_pool *pool)
+{
+	if (!pool || os_atomic_dec_long(&pool->refs) != 0)
+		return;
+
+	while (pool->free_frames) {
+		struct pool_frame *frame = pool->free_frames;
+		pool->free_frames = frame->next;
+
+		video_frame_free(&frame->frame);
+		bfree(frame);
+	}
+
+	pthread_mutex_destroy(&pool->mutex);
+	bfree(pool);
+}
+
+static struct pool_frame *frame_pool_get(struct frame_pool *pool)
+{
+	struct pool_frame *frame;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	frame = pool->free_frames;
+	if (frame) {
+		pool->free_frames = frame->next;
+		pool->num_free--;
+		pool->reuses++;
+	} else {
+		pool->num_frames++;
+		pool->allocations++;
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (!frame) {
+		frame = bzalloc(sizeof(struct pool_frame));
+		frame->pool = pool;
+		video_frame_init(&frame->frame, pool->format,
+				pool->width, pool->height);
+	}
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		frame->data.data[i]     = frame->frame.data[i];
+		frame->data.linesize[i] = frame->frame.linesize[i];
+	}
+
+	frame->data.timestamp = 0;
+	frame->next        = NULL;
+	frame->derived     = NULL;
+	frame->unconverted = false;
+	frame->refs        = 1;
+
+	os_atomic_inc_long(&pool->refs);
+	return frame;
+}
+
+static void pool_frame_release(struct pool_frame *frame)
+{
+	struct frame_pool *pool;
+
+	if (!frame)
+		return;
+	if (os_atomic_dec_long(&frame->refs) != 0)
+		return;
+
+	while (frame->derived) {
+		struct derived_frame *derived = frame->derived;
+		frame->derived = derived->next;
+
+		pool_frame_release(derived->frame);
+		bfree(derived);
+	}
+
+	if (frame->release) {
+		frame->release(frame->release_param);
+		bfree(frame);
+		return;
+	}
+
+	pool = frame->pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	frame->next       = pool->free_frames;
+	pool->free_frames = frame;
+	pool->num_free++;
+	pthread_mutex_unlock(&pool->mutex);
+
+	frame_pool_release(pool);
+}
+
+static inline void frame_pool_add_stats(struct frame_pool *pool,
+		struct video_frame_pool_stats *stats)
+{
+	if (!pool)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	stats->frames_allocated  += pool->num_frames;
+	stats->frames_free       += pool->num_free;
+	stats->total_allocations += pool->allocations;
+	stats->total_reuses      += pool->reuses;
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+static inline struct pool_frame *get_pool_frame(struct video_frame *frame)
+{
+	return (struct pool_frame*)((uint8_t*)frame -
+			offsetof(struct pool_frame, frame));
+}
+
+static inline void pool_frame_addref(struct pool_frame *frame)
+{
+	os_atomic_inc_long(&frame->refs);
+}
+
+const struct video_data *video_data_retain(const struct video_data *data)
+{
+	if (data)
+		pool_frame_addref((struct pool_frame*)data);
+	return data;
+}
+
+void video_data_release(const struct video_data *data)
+{
+	pool_frame_release((struct pool_frame*)data);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/*
+ *   Inputs that request the same conversion share one scaler.  The first
+ * input to receive a frame scales it, and the result is cached so the other
+ * inputs are handed the same scaled frame rather than scaling it again.
+ *
+ *   When frames are converted from UYVX on the CPU, the scaled frames are
+ * instead made from the UYVX image before the output frame is submitted
+ * (see video_output_prescale_uyvx), and travel with it as derived frames.
+ */
+
+/* threads every scaler of an output shares */
+#define MAX_SCALE_THREADS 4
+
+struct shared_scaler {
 	struct video_scale_info   conversion;
 	video_scaler_t            scaler;
-	struct video_frame        frame[MAX_CONVERT_BUFFERS];
-	int                       cur_frame;
+	struct frame_pool         *pool;
+	slice_pool_t              scale_pool;
+	long                      refs;
+
+	pthread_mutex_t           mutex;
+	struct pool_frame         *last_source;
+	struct pool_frame         *last_scaled;
+
+	/* only used by the thread that submits output frames */
+	video_scaler_t            uyvx_scaler;
+	bool                      uyvx_failed;
+};
+
+static void shared_scaler_destroy(struct shared_scaler *ss)
+{
+	if (!ss)
+		return;
+
+	pool_frame_release(ss->last_source);
+	pool_frame_release(ss->last_scaled);
+	frame_pool_release(ss->pool);
+	video_scaler_destroy(ss->scaler);
+	video_scaler_destroy(ss->uyvx_scaler);
+	pthread_mutex_destroy(&ss->mutex);
+	bfree(ss);
+}
+
+static struct shared_scaler *shared_scaler_create(
+		const struct video_scale_info *conversion,
+		const struct video_output_info *info, slice_pool_t scale_pool)
+{
+	struct shared_scaler *ss = bzalloc(sizeof(struct shared_scaler));
+	struct video_scale_info from = {
+		.format = info->format,
+		.width  = info->width,
+		.height = info->height,
+	};
+	int ret;
+
+	pthread_mutex_init_value(&ss->mutex);
+
+	ss->conversion = *conversion;
+	ss->scale_pool = scale_pool;
+	ss->refs       = 1;
+
+	if (pthread_mutex_init(&ss->mutex, NULL) != 0)
+		goto fail;
+
+	ret = video_scaler_create_pooled(&ss->scaler, conversion, &from,
+			VIDEO_SCALE_FAST_BILINEAR, scale_pool);
+	if (ret != VIDEO_SCALER_SUCCESS) {
+		if (ret == VIDEO_SCALER_BAD_CONVERSION)
+			blog(LOG_WARNING, "video_input_init: Bad "
+			                  "scale conversion type");
+		else
+			blog(LOG_WARNING, "video_input_init: Failed to "
+					  "create scaler");
+		goto fail;
+	}
+
+	ss->pool = frame_pool_create(conversion->format, conversion->width,
+			conversion->height);
+	if (!ss->pool)
+		goto fail;
+
+	return ss;
+
+fail:
+	shared_scaler_destroy(ss);
+	return NULL;
+}
+
+/* the scaler's pool tells its frames apart, and stays alive while any of
+ * its frames are held */
+static inline struct pool_frame *find_derived_frame(
+		const struct pool_frame *frame, const struct frame_pool *pool)
+{
+	for (struct derived_frame *d = frame->derived; d; d = d->next) {
+		if (d->frame->pool == pool)
+			return d->frame;
+	}
+
+	return NULL;
+}
+
+/* returns a new reference to the scaled frame, or NULL on failure */
+static struct pool_frame *shared_scaler_scale(struct shared_scaler *ss,
+		struct pool_frame *frame)
+{
+	struct pool_frame *scaled = find_derived_frame(frame, ss->pool);
+
+	/* derived frames are only added before the frame is submitted */
+	if (scaled) {
+		pool_frame_addref(scaled);
+		return scaled;
+	}
+
+	if (frame->unconverted)
+		return NULL;
+
+	pthread_mutex_lock(&ss->mutex);
+
+	/* last_source holds a reference, so it cannot have been recycled
+	 * into a different frame while cached */
+	if (ss->last_source != frame) {
+		scaled = frame_pool_get(ss->pool);
+
+		if (video_scaler_scale(ss->scaler,
+					scaled->frame.data,
+					scaled->frame.linesize,
+					frame->data.data,
+					frame->data.linesize)) {
+			scaled->data.timestamp = frame->data.timestamp;
+
+			pool_frame_release(ss->last_source);
+			pool_frame_release(ss->last_scaled);
+
+			pool_frame_addref(frame);
+			ss->last_source = frame;
+			ss->last_scaled = scaled;
+		} else {
+			pool_frame_release(scaled);
+			scaled = NULL;
+			goto unlock;
+		}
+	}
+
+	scaled = ss->last_scaled;
+	pool_frame_addref(scaled);
+
+unlock:
+	pthread_mutex_unlock(&ss->mutex);
+	return scaled;
+}
+
+static inline void add_derived_frame(struct pool_frame *frame,
+		struct pool_frame *derived_frame)
+{
+	struct derived_frame *derived = bmalloc(sizeof(struct derived_frame));
+
+	derived->frame = derived_frame;
+	derived->next  = frame->derived;
+	frame->derived = derived;
+}
+
+/* scales the UYVX image that the source frame is converted from.  only
+ * called from the thread submitting output frames, before submitting */
+static bool shared_scaler_prescale(struct shared_scaler *ss,
+		const struct video_output_info *info,
+		struct pool_frame *source, const uint8_t *data,
+		uint32_t linesize, uint64_t timestamp)
+{
+	struct pool_frame *scaled;
+
+	if (!ss->uyvx_scaler && !ss->uyvx_failed) {
+		struct video_scale_info from = {
+			.format = info->format,
+			.width  = info->width,
+			.height = info->height,
+		};
+
+		ss->uyvx_failed = video_scaler_create_uyvx(&ss->uyvx_scaler,
+				&ss->conversion, &from,
+				VIDEO_SCALE_FAST_BILINEAR, ss->scale_pool) !=
+			VIDEO_SCALER_SUCCESS;
+	}
+
+	if (!ss->uyvx_scaler)
+		return false;
+
+	scaled = frame_pool_get(ss->pool);
+
+	if (!video_scaler_scale_uyvx(ss->uyvx_scaler,
+				scaled->frame.data, scaled->frame.linesize,
+				data, linesize)) {
+		pool_frame_release(scaled);
+		return false;
+	}
+
+	scaled->data.timestamp = timestamp;
+	add_derived_frame(source, scaled);
+	return true;
+}
+
+static inline bool scale_info_equal(const struct video_scale_info *a,
+		const struct video_scale_info *b)
+{
+	return a->format     == b->format     &&
+	       a->width      == b->width      &&
+	       a->height     == b->height     &&
+	       a->full_range == b->full_range &&
+	       a->colorspace == b->colorspace;
+}
+
+/*
+ *   Each input receives frames through its own bounded queue and delivery
+ * thread, so a slow consumer (or its scaler) only ever delays itself.
+ */
+
+struct video_input {
+	struct video_scale_info   conversion;
+	struct shared_scaler      *scaler;
 
 	void (*callback)(void *param, const struct video_data *frame);
 	void *param;
+
+	pthread_t                 thread;
+	bool                      thread_active;
+	pthread_mutex_t           queue_mutex;
+	event_t                   queue_event;
+	struct circlebuf          queue;
+	uint32_t                  max_frames;
+	enum video_drop_policy    drop_policy;
+	bool                      stop;
+
+	uint32_t                  max_queued;
+	uint64_t                  delivered;
+	uint64_t                  dropped;
 };
 
+static inline size_t video_input_queued(struct video_input *input)
+{
+	return input->queue.size / sizeof(struct pool_frame*);
+}
+
+static inline struct pool_frame *video_input_pop(struct video_input *input)
+{
+	struct pool_frame *frame = NULL;
+
+	if (input->queue.size)
+		circlebuf_pop_front(&input->queue, &frame, sizeof(frame));
+	return frame;
+}
+
 static inline void video_input_free(struct video_input *input)
 {
-	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-		video_frame_free(&input->frame[i]);
-	video_scaler_destroy(input->scaler);
+	struct pool_frame *frame;
+
+	if (input->thread_active) {
+		pthread_mutex_lock(&input->queue_mutex);
+		input->stop = true;
+		pthread_mutex_unlock(&input->queue_mutex);
+
+		event_signal(&input->queue_event);
+		pthread_join(input->thread, NULL);
+	}
+
+	while ((frame = video_input_pop(input)) != NULL)
+		pool_frame_release(frame);
+
+	circlebuf_free(&input->queue);
+	event_destroy(&input->queue_event);
+	pthread_mutex_destroy(&input->queue_mutex);
+
+	bfree(input);
 }
 
 struct video_output {
@@ -52,94 +505,261 @@ struct video_output {
 	pthread_mutex_t            data_mutex;
 	event_t                    stop_event;
 
-	struct video_data          cur_frame;
-	struct video_data          next_frame;
-	bool                       new_frame;
+	struct frame_pool          *pool;
+	struct pool_frame          *cur_frame;
+	struct pool_frame          *next_frame;
 
 	event_t                    update_event;
 	uint64_t                   frame_time;
 	volatile uint64_t          cur_video_time;
 
+	/* clock start time, and the spin before each deadline */
+	uint64_t                   start_time;
+	volatile uint64_t          spin_ns;
+
+	struct video_output_timing_stats timing;
+
 	bool                       initialized;
 
 	pthread_mutex_t            input_mutex;
-	DARRAY(struct video_input) inputs;
+	DARRAY(struct video_input*) inputs;
+	DARRAY(struct shared_scaler*) scalers;
+
+	/* shared by the scalers, created along with the first one */
+	slice_pool_t               scale_pool;
+
+	/* outputs without a clock of their own, swapped on this one's tick */
+	struct video_output        *parent;
+	pthread_mutex_t            linked_mutex;
+	DARRAY(struct video_output*) linked;
 };
 
 /* ------------------------------------------------------------------------- */
 
 static inline void video_swapframes(struct video_output *video)
 {
-	if (video->new_frame) {
-		video->cur_frame = video->next_frame;
-		video->new_frame = false;
+	if (video->next_frame) {
+		pool_frame_release(video->cur_frame);
+		video->cur_frame  = video->next_frame;
+		video->next_frame = NULL;
+	}
+}
+
+static inline void video_input_deliver(struct video_input *input,
+		struct pool_frame *frame)
+{
+	struct pool_frame *scaled;
+
+	if (!input->scaler) {
+		if (!frame->unconverted)
+			input->callback(input->param, &frame->data);
+		return;
+	}
+
+	scaled = shared_scaler_scale(input->scaler, frame);
+	if (scaled) {
+		input->callback(input->param, &scaled->data);
+		pool_frame_release(scaled);
 	}
 }
 
-static inline bool scale_video_output(struct video_input *input,
-		struct video_data *data)
+static void *video_input_thread(void *param)
 {
-	bool success = true;
+	struct video_input *input = param;
+	bool stop = false;
+
+	while (!stop) {
+		event_wait(&input->queue_event);
 
-	if (input->scaler) {
-		struct video_frame *frame;
+		for (;;) {
+			struct pool_frame *frame;
 
-		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
-			input->cur_frame = 0;
+			pthread_mutex_lock(&input->queue_mutex);
+			stop  = input->stop;
+			frame = stop ? NULL : video_input_pop(input);
+			pthread_mutex_unlock(&input->queue_mutex);
 
-		frame = &input->frame[input->cur_frame];
+			if (!frame)
+				break;
 
-		success = video_scaler_scale(input->scaler,
-				frame->data, frame->linesize,
-				data->data, data->linesize);
+			video_input_deliver(input, frame);
+			pool_frame_release(frame);
 
-		if (success) {
-			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-				data->data[i]     = frame->data[i];
-				data->linesize[i] = frame->linesize[i];
-			}
+			pthread_mutex_lock(&input->queue_mutex);
+			input->delivered++;
+			pthread_mutex_unlock(&input->queue_mutex);
 		}
 	}
 
-	return success;
+	return NULL;
+}
+
+static void video_input_push(struct video_input *input,
+		struct pool_frame *frame)
+{
+	struct pool_frame *dropped = NULL;
+	size_t queued;
+
+	pthread_mutex_lock(&input->queue_mutex);
+
+	if (video_input_queued(input) >= input->max_frames) {
+		input->dropped++;
+
+		if (input->drop_policy == VIDEO_DROP_OLDEST)
+			dropped = video_input_pop(input);
+		else
+			frame = NULL;
+	}
+
+	if (frame) {
+		pool_frame_addref(frame);
+		circlebuf_push_back(&input->queue, &frame, sizeof(frame));
+	}
+
+	queued = video_input_queued(input);
+	if (queued > input->max_queued)
+		input->max_queued = (uint32_t)queued;
+
+	pthread_mutex_unlock(&input->queue_mutex);
+
+	pool_frame_release(dropped);
+	if (frame)
+		event_signal(&input->queue_event);
 }
 
 static inline void video_output_cur_frame(struct video_output *video)
 {
-	if (!video->cur_frame.data[0])
+	if (!video->cur_frame)
 		return;
 
 	pthread_mutex_lock(&video->input_mutex);
 
-	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array+i;
-		if (scale_video_output(input, &video->cur_frame))
-			input->callback(input->param, &video->cur_frame);
-	}
+	for (size_t i = 0; i < video->inputs.num; i++)
+		video_input_push(video->inputs.array[i], video->cur_frame);
 
 	pthread_mutex_unlock(&video->input_mutex);
 }
 
+/*
+ * Time of a half frame tick.  Ticks are counted from the start of the clock
+ * and converted with the rational frame rate, so unlike adding a rounded
+ * frame time each tick, no error accumulates (29.97 fps stays exact over
+ * weeks).  The fraction is split so nothing overflows 64 bits.
+ */
+static uint64_t video_clock_time(const struct video_output *video,
+		uint64_t tick)
+{
+	uint64_t ticks_per_period = (uint64_t)video->info.fps_num * 2;
+	uint64_t period_ns = (uint64_t)video->info.fps_den * 1000000000ULL;
+	uint64_t periods   = tick / ticks_per_period;
+	uint64_t rem       = tick % ticks_per_period;
+
+	return video->start_time + periods * period_ns +
+		rem * (period_ns / ticks_per_period) +
+		rem * (period_ns % ticks_per_period) / ticks_per_period;
+}
+
+/*
+ * Sleeps to an absolute deadline, spinning for the last spin_ns if set.
+ * Returns how far past the deadline it already was, or 0 if on time, in
+ * which case wakeup receives how long after the deadline it woke up.
+ */
+static uint64_t sleep_until(struct video_output *video, uint64_t target,
+		uint64_t *wakeup)
+{
+	uint64_t spin_ns = video->spin_ns;
+	uint64_t now     = os_gettime_ns();
+
+	if (now > target)
+		return now - target;
+
+	if (spin_ns && spin_ns < target) {
+		os_sleepto_ns(target - spin_ns);
+		while ((now = os_gettime_ns()) < target)
+			;
+	} else {
+		os_sleepto_ns(target);
+		now = os_gettime_ns();
+	}
+
+	*wakeup = now > target ? now - target : 0;
+	return 0;
+}
+
+static inline void update_timing_stats(struct video_output *video,
+		uint64_t lateness, uint64_t wakeup)
+{
+	struct video_output_timing_stats *timing = &video->timing;
+
+	timing->total_frames++;
+	if (!lateness)
+		time_stats_add(&timing->wakeup_jitter, wakeup);
+
+	if (lateness) {
+		timing->late_frames++;
+		if (lateness >= video->frame_time)
+			timing->missed_frames++;
+		if (lateness > timing->max_lateness_ns)
+			timing->max_lateness_ns = lateness;
+	}
+}
+
+static inline void video_output_update(struct video_output *video,
+		uint64_t update_time)
+{
+	video->cur_video_time = update_time;
+	event_signal(&video->update_event);
+}
+
+static inline void video_output_swap(struct video_output *video,
+		uint64_t lateness, uint64_t wakeup)
+{
+	pthread_mutex_lock(&video->data_mutex);
+
+	update_timing_stats(video, lateness, wakeup);
+	video_swapframes(video);
+	video_output_cur_frame(video);
+
+	pthread_mutex_unlock(&video->data_mutex);
+}
+
 static void *video_thread(void *param)
 {
 	struct video_output *video = param;
-	uint64_t cur_time = os_gettime_ns();
+	uint64_t tick = 0;
+
+	video->start_time = os_gettime_ns();
 
 	while (event_try(&video->stop_event) == EAGAIN) {
-		/* wait half a frame, update frame */
-		os_sleepto_ns(cur_time += (video->frame_time/2));
-		video->cur_video_time = cur_time;
-		event_signal(&video->update_event);
+		uint64_t lateness, swap_lateness;
+		uint64_t update_time = video_clock_time(video, ++tick);
+		uint64_t swap_time   = video_clock_time(video, ++tick);
+		uint64_t wakeup      = 0;
 
-		/* wait another half a frame, swap and output frames */
-		os_sleepto_ns(cur_time += (video->frame_time/2));
+		/* wait half a frame, update frame */
+		lateness = sleep_until(video, update_time, &wakeup);
 
-		pthread_mutex_lock(&video->data_mutex);
+		pthread_mutex_lock(&video->linked_mutex);
+		for (size_t i = 0; i < video->linked.num; i++)
+			video_output_update(video->linked.array[i],
+					update_time);
+		pthread_mutex_unlock(&video->linked_mutex);
 
-		video_swapframes(video);
-		video_output_cur_frame(video);
+		video_output_update(video, update_time);
 
-		pthread_mutex_unlock(&video->data_mutex);
+		/* wait another half a frame, swap and output frames */
+		swap_lateness = sleep_until(video, swap_time, &wakeup);
+		if (swap_lateness > lateness)
+			lateness = swap_lateness;
+
+		video_output_swap(video, lateness, wakeup);
+
+		/* linked outputs get the frames made on the same tick */
+		pthread_mutex_lock(&video->linked_mutex);
+		for (size_t i = 0; i < video->linked.num; i++)
+			video_output_swap(video->linked.array[i], lateness,
+					wakeup);
+		pthread_mutex_unlock(&video->linked_mutex);
 	}
 
 	return NULL;
@@ -153,7 +773,8 @@ static inline bool valid_video_params(struct video_output_info *info)
 	       info->fps_num != 0;
 }
 
-int video_output_open(video_t *video, struct video_output_info *info)
+static int video_output_create(video_t *video, struct video_output_info *info,
+		struct video_output *parent)
 {
 	struct video_output *out;
 
@@ -167,16 +788,31 @@ int video_output_open(video_t *video, struct video_output_info *info)
 		(double)info->fps_num);
 	out->initialized = false;
 
+	out->pool = frame_pool_create(info->format, info->width, info->height);
+	if (!out->pool)
+		goto fail;
+
 	if (pthread_mutex_init(&out->data_mutex, NULL) != 0)
 		goto fail;
 	if (pthread_mutex_init(&out->input_mutex, NULL) != 0)
 		goto fail;
+	if (pthread_mutex_init(&out->linked_mutex, NULL) != 0)
+		goto fail;
 	if (event_init(&out->stop_event, EVENT_TYPE_MANUAL) != 0)
 		goto fail;
 	if (event_init(&out->update_event, EVENT_TYPE_AUTO) != 0)
 		goto fail;
-	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
+
+	if (parent) {
+		out->parent = parent;
+		pthread_mutex_lock(&parent->linked_mutex);
+		da_push_back(parent->linked, &out);
+		pthread_mutex_unlock(&parent->linked_mutex);
+
+	} else if (pthread_create(&out->thread, NULL, video_thread,
+				out) != 0) {
 		goto fail;
+	}
 
 	out->initialized = true;
 	*video = out;
@@ -187,6 +823,27 @@ fail:
 	return VIDEO_OUTPUT_FAIL;
 }
 
+int video_output_open(video_t *video, struct video_output_info *info)
+{
+	return video_output_create(video, info, NULL);
+}
+
+int video_output_open_linked(video_t *video, struct video_output_info *info,
+		video_t parent)
+{
+	struct video_output_info linked_info;
+
+	if (!parent || !info)
+		return VIDEO_OUTPUT_INVALIDPARAM;
+
+	/* frames come at the parent's rate, whatever the info says */
+	linked_info         = *info;
+	linked_info.fps_num = parent->info.fps_num;
+	linked_info.fps_den = parent->info.fps_den;
+
+	return video_output_create(video, &linked_info, parent);
+}
+
 void video_output_close(video_t video)
 {
 	if (!video)
@@ -194,14 +851,32 @@ void video_output_close(video_t video)
 
 	video_output_stop(video);
 
+	/* after this the parent's thread no longer touches the output */
+	if (video->parent) {
+		pthread_mutex_lock(&video->parent->linked_mutex);
+		da_erase_item(video->parent->linked, &video);
+		pthread_mutex_unlock(&video->parent->linked_mutex);
+	}
+	da_free(video->linked);
+
 	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
+		video_input_free(video->inputs.array[i]);
 	da_free(video->inputs);
 
+	for (size_t i = 0; i < video->scalers.num; i++)
+		shared_scaler_destroy(video->scalers.array[i]);
+	da_free(video->scalers);
+	slice_pool_destroy(video->scale_pool);
+
+	pool_frame_release(video->cur_frame);
+	pool_frame_release(video->next_frame);
+	frame_pool_release(video->pool);
+
 	event_destroy(&video->update_event);
 	event_destroy(&video->stop_event);
 	pthread_mutex_destroy(&video->data_mutex);
 	pthread_mutex_destroy(&video->input_mutex);
+	pthread_mutex_destroy(&video->linked_mutex);
 	bfree(video);
 }
 
@@ -210,7 +885,7 @@ static size_t video_get_input_idx(video_t video,
 		void *param)
 {
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array+i;
+		struct video_input *input = video->inputs.array[i];
 		if (input->callback == callback && input->param == param)
 			return i;
 	}
@@ -218,40 +893,80 @@ static size_t video_get_input_idx(video_t video,
 	return DARRAY_INVALID;
 }
 
+/* called with input_mutex held */
+static struct shared_scaler *get_shared_scaler(struct video_output *video,
+		const struct video_scale_info *conversion)
+{
+	struct shared_scaler *ss;
+
+	for (size_t i = 0; i < video->scalers.num; i++) {
+		ss = video->scalers.array[i];
+
+		if (scale_info_equal(&ss->conversion, conversion)) {
+			ss->refs++;
+			return ss;
+		}
+	}
+
+	if (!video->scale_pool) {
+		uint32_t threads = (uint32_t)os_get_logical_cores();
+		if (threads > MAX_SCALE_THREADS)
+			threads = MAX_SCALE_THREADS;
+
+		if (slice_pool_create(&video->scale_pool, threads) !=
+				SLICE_POOL_SUCCESS)
+			video->scale_pool = NULL;
+	}
+
+	ss = shared_scaler_create(conversion, &video->info,
+			video->scale_pool);
+	if (ss)
+		da_push_back(video->scalers, &ss);
+	return ss;
+}
+
+/* called with input_mutex held */
+static void release_shared_scaler(struct video_output *video,
+		struct shared_scaler *ss)
+{
+	if (!ss || --ss->refs != 0)
+		return;
+
+	da_erase_item(video->scalers, &ss);
+	shared_scaler_destroy(ss);
+}
+
+/* called with input_mutex held.  undoes everything it did on failure */
 static inline bool video_input_init(struct video_input *input,
 		struct video_output *video)
 {
+	if (pthread_mutex_init(&input->queue_mutex, NULL) != 0)
+		return false;
+	if (event_init(&input->queue_event, EVENT_TYPE_AUTO) != 0)
+		goto fail_event;
+
 	if (input->conversion.width  != video->info.width ||
 	    input->conversion.height != video->info.height ||
 	    input->conversion.format != video->info.format) {
-		struct video_scale_info from = {
-			.format = video->info.format,
-			.width  = video->info.width,
-			.height = video->info.height,
-		};
-
-		int ret = video_scaler_create(&input->scaler,
-				&input->conversion, &from,
-				VIDEO_SCALE_FAST_BILINEAR);
-		if (ret != VIDEO_SCALER_SUCCESS) {
-			if (ret == VIDEO_SCALER_BAD_CONVERSION)
-				blog(LOG_WARNING, "video_input_init: Bad "
-				                  "scale conversion type");
-			else
-				blog(LOG_WARNING, "video_input_init: Failed to "
-						  "create scaler");
-
-			return false;
-		}
-
-		for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-			video_frame_init(&input->frame[i],
-					input->conversion.format,
-					input->conversion.width,
-					input->conversion.height);
+		input->scaler = get_shared_scaler(video, &input->conversion);
+		if (!input->scaler)
+			goto fail_scaler;
 	}
 
+	if (pthread_create(&input->thread, NULL, video_input_thread,
+				input) != 0)
+		goto fail_thread;
+
+	input->thread_active = true;
 	return true;
+
+fail_thread:
+	release_shared_scaler(video, input->scaler);
+fail_scaler:
+	event_destroy(&input->queue_event);
+fail_event:
+	pthread_mutex_destroy(&input->queue_mutex);
+	return false;
 }
 
 bool video_output_connect(video_t video,
@@ -264,28 +979,32 @@ bool video_output_connect(video_t video,
 	pthread_mutex_lock(&video->input_mutex);
 
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
-		struct video_input input;
-		memset(&input, 0, sizeof(input));
+		struct video_input *input;
+		input = bzalloc(sizeof(struct video_input));
 
-		input.callback = callback;
-		input.param    = param;
+		input->callback    = callback;
+		input->param       = param;
+		input->max_frames  = VIDEO_INPUT_DEFAULT_QUEUE;
+		input->drop_policy = VIDEO_DROP_OLDEST;
 
 		if (conversion) {
-			input.conversion = *conversion;
+			input->conversion = *conversion;
 		} else {
-			input.conversion.format    = video->info.format;
-			input.conversion.width     = video->info.width;
-			input.conversion.height    = video->info.height;
+			input->conversion.format    = video->info.format;
+			input->conversion.width     = video->info.width;
+			input->conversion.height    = video->info.height;
 		}
 
-		if (input.conversion.width == 0)
-			input.conversion.width = video->info.width;
-		if (input.conversion.height == 0)
-			input.conversion.height = video->info.height;
+		if (input->conversion.width == 0)
+			input->conversion.width = video->info.width;
+		if (input->conversion.height == 0)
+			input->conversion.height = video->info.height;
 
-		success = video_input_init(&input, video);
+		success = video_input_init(input, video);
 		if (success)
 			da_push_back(video->inputs, &input);
+		else
+			bfree(input);
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
@@ -297,15 +1016,81 @@ void video_output_disconnect(video_t video,
 		void (*callback)(void *param, const struct video_data *frame),
 		void *param)
 {
+	struct video_input *input = NULL;
+
 	pthread_mutex_lock(&video->input_mutex);
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array+idx);
+		input = video->inputs.array[idx];
 		da_erase(video->inputs, idx);
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
+
+	if (input) {
+		struct shared_scaler *scaler = input->scaler;
+
+		/* the input's thread may still be using the scaler until it
+		 * has been joined */
+		video_input_free(input);
+
+		pthread_mutex_lock(&video->input_mutex);
+		release_shared_scaler(video, scaler);
+		pthread_mutex_unlock(&video->input_mutex);
+	}
+}
+
+bool video_output_set_input_queue(video_t video,
+		void (*callback)(void *param, const struct video_data *frame),
+		void *param, uint32_t max_frames,
+		enum video_drop_policy drop_policy)
+{
+	struct video_input *input;
+	size_t idx;
+
+	if (!max_frames)
+		return false;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID) {
+		input = video->inputs.array[idx];
+
+		pthread_mutex_lock(&input->queue_mutex);
+		input->max_frames  = max_frames;
+		input->drop_policy = drop_policy;
+		pthread_mutex_unlock(&input->queue_mutex);
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+	return idx != DARRAY_INVALID;
+}
+
+bool video_output_get_input_stats(video_t video,
+		void (*callback)(void *param, const struct video_data *frame),
+		void *param, struct video_input_stats *stats)
+{
+	struct video_input *input;
+	size_t idx;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID) {
+		input = video->inputs.array[idx];
+
+		pthread_mutex_lock(&input->queue_mutex);
+		stats->queued_frames     = (uint32_t)video_input_queued(input);
+		stats->max_queued_frames = input->max_queued;
+		stats->delivered_frames  = input->delivered;
+		stats->dropped_frames    = input->dropped;
+		pthread_mutex_unlock(&input->queue_mutex);
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+	return idx != DARRAY_INVALID;
 }
 
 const struct video_output_info *video_output_getinfo(video_t video)
@@ -313,14 +1098,193 @@ const struct video_output_info *video_output_getinfo(video_t video)
 	return &video->info;
 }
 
+static inline void video_output_set_next(struct video_output *video,
+		struct pool_frame *frame, uint64_t timestamp)
+{
+	frame->data.timestamp = timestamp;
+
+	pthread_mutex_lock(&video->data_mutex);
+
+	if (video->next_frame != frame)
+		pool_frame_release(video->next_frame);
+	video->next_frame = frame;
+
+	pthread_mutex_unlock(&video->data_mutex);
+}
+
 void video_output_swap_frame(video_t video, struct video_data *frame)
+{
+	struct pool_frame *copy = frame_pool_get(video->pool);
+
+	video_frame_copy(&copy->frame, frame, video->info.format,
+			video->info.height);
+	video_output_set_next(video, copy, frame->timestamp);
+}
+
+void video_output_publish_frame(video_t video, const struct video_data *frame,
+		void (*release)(void *param), void *param)
+{
+	struct pool_frame *ref = bzalloc(sizeof(struct pool_frame));
+
+	ref->data          = *frame;
+	ref->refs          = 1;
+	ref->release       = release;
+	ref->release_param = param;
+
+	video_output_set_next(video, ref, frame->timestamp);
+}
+
+/* copies a frame into a new frame from the given pool, with the frames
+ * derived from it if it was not converted itself.  published frames have
+ * no pool of their own, so they are copied into the output's */
+static struct pool_frame *copy_pool_frame(struct frame_pool *pool,
+		struct pool_frame *frame)
+{
+	struct pool_frame *copy = frame_pool_get(pool);
+
+	copy->unconverted = frame->unconverted;
+	if (!frame->unconverted) {
+		video_frame_copy(&copy->frame, &frame->data, pool->format,
+				pool->height);
+		return copy;
+	}
+
+	for (struct derived_frame *d = frame->derived; d; d = d->next)
+		add_derived_frame(copy, copy_pool_frame(d->frame->pool,
+					d->frame));
+	return copy;
+}
+
+bool video_output_repeat_frame(video_t video, uint64_t timestamp)
+{
+	struct pool_frame *last;
+	struct pool_frame *copy;
+
+	pthread_mutex_lock(&video->data_mutex);
+	last = video->next_frame ? video->next_frame : video->cur_frame;
+	if (last)
+		pool_frame_addref(last);
+	pthread_mutex_unlock(&video->data_mutex);
+
+	if (!last)
+		return false;
+
+	/* inputs may still hold the last frame, so its timestamp can't be
+	 * changed in place */
+	copy = copy_pool_frame(video->pool, last);
+	pool_frame_release(last);
+
+	video_output_set_next(video, copy, timestamp);
+	return true;
+}
+
+struct video_frame *video_output_get_frame(video_t video)
+{
+	struct pool_frame *frame = frame_pool_get(video->pool);
+	return &frame->frame;
+}
+
+void video_output_submit_frame(video_t video, struct video_frame *frame,
+		uint64_t timestamp)
+{
+	video_output_set_next(video, get_pool_frame(frame), timestamp);
+}
+
+void video_output_discard_frame(video_t video, struct video_frame *frame)
+{
+	pool_frame_release(get_pool_frame(frame));
+	UNUSED_PARAMETER(video);
+}
+
+bool video_output_prescale_uyvx(video_t video, struct video_frame *frame,
+		const uint8_t *data, uint32_t linesize, uint64_t timestamp)
+{
+	DARRAY(struct shared_scaler*) scalers;
+	struct pool_frame *source;
+	bool all_scaled;
+
+	if (!video || !frame)
+		return false;
+
+	source = get_pool_frame(frame);
+	da_init(scalers);
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	all_scaled = video->inputs.num != 0;
+	for (size_t i = 0; i < video->inputs.num; i++) {
+		if (!video->inputs.array[i]->scaler)
+			all_scaled = false;
+	}
+
+	/* hold references so inputs can disconnect while scaling */
+	for (size_t i = 0; i < video->scalers.num; i++) {
+		struct shared_scaler *ss = video->scalers.array[i];
+
+		if (!ss->uyvx_failed) {
+			ss->refs++;
+			da_push_back(scalers, &ss);
+		} else {
+			all_scaled = false;
+		}
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	for (size_t i = 0; i < scalers.num; i++) {
+		if (!shared_scaler_prescale(scalers.array[i], &video->info,
+					source, data, linesize, timestamp))
+			all_scaled = false;
+	}
+
+	if (scalers.num) {
+		pthread_mutex_lock(&video->input_mutex);
+		for (size_t i = 0; i < scalers.num; i++)
+			release_shared_scaler(video, scalers.array[i]);
+		pthread_mutex_unlock(&video->input_mutex);
+	}
+
+	da_free(scalers);
+
+	/* inputs that connect later skip this frame rather than scale it */
+	source->unconverted = all_scaled;
+	return all_scaled;
+}
+
+void video_output_get_pool_stats(video_t video,
+		struct video_frame_pool_stats *stats)
+{
+	memset(stats, 0, sizeof(struct video_frame_pool_stats));
+
+	frame_pool_add_stats(video->pool, stats);
+
+	pthread_mutex_lock(&video->input_mutex);
+	for (size_t i = 0; i < video->scalers.num; i++)
+		frame_pool_add_stats(video->scalers.array[i]->pool, stats);
+	pthread_mutex_unlock(&video->input_mutex);
+}
+
+void video_output_get_timing_stats(video_t video,
+		struct video_output_timing_stats *stats)
 {
 	pthread_mutex_lock(&video->data_mutex);
-	video->next_frame = *frame;
-	video->new_frame = true;
+	*stats = video->timing;
 	pthread_mutex_unlock(&video->data_mutex);
 }
 
+void video_output_reset_timing_stats(video_t video)
+{
+	pthread_mutex_lock(&video->data_mutex);
+	memset(&video->timing, 0, sizeof(video->timing));
+	pthread_mutex_unlock(&video->data_mutex);
+}
+
+void video_output_set_spin_time(video_t video, uint64_t spin_ns)
+{
+	if (video)
+		video->spin_ns = spin_ns;
+}
+
 bool video_output_wait(video_t video)
 {
 	event_wait(&video->update_event);
@@ -346,7 +1310,14 @@ void video_output_stop(video_t video)
 
 	if (video->initialized) {
 		event_signal(&video->stop_event);
-		pthread_join(video->thread, &thread_ret);
+		if (!video->parent)
+			pthread_join(video->thread, &thread_ret);
 		event_signal(&video->update_event);
+
+		/* linked outputs get no more frames without this one's clock */
+		pthread_mutex_lock(&video->linked_mutex);
+		for (size_t i = 0; i < video->linked.num; i++)
+			video_output_stop(video->linked.array[i]);
+		pthread_mutex_unlock(&video->linked_mutex);
 	}
 }
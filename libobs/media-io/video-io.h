@@ -18,6 +18,7 @@
 #pragma once
 
 #include "media-io-defs.h"
+#include "../util/time-stats.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -103,11 +104,72 @@ struct video_scale_info {
 	enum video_colorspace colorspace;
 };
 
+/*
+ *   Frames passed to video input callbacks come from a reference-counted
+ * frame pool.  A callback that needs a frame after it returns (for example
+ * to encode it on another thread) calls video_data_retain, then calls
+ * video_data_release when done with it.  Retained frames are not reused
+ * until released.
+ */
+
+struct video_frame;
+
+struct video_frame_pool_stats {
+	uint32_t          frames_allocated; /**< Pool depth (used + free) */
+	uint32_t          frames_free;      /**< Frames waiting to be reused */
+	uint64_t          total_allocations;
+	uint64_t          total_reuses;
+};
+
+/*
+ *   Each connected input receives frames on its own thread through a bounded
+ * queue.  When the queue is full, the drop policy decides whether the
+ * oldest queued frame or the incoming frame is discarded.
+ */
+
+enum video_drop_policy {
+	VIDEO_DROP_OLDEST,
+	VIDEO_DROP_NEWEST,
+};
+
+#define VIDEO_INPUT_DEFAULT_QUEUE 3
+
+struct video_input_stats {
+	uint32_t          queued_frames;
+	uint32_t          max_queued_frames;
+	uint64_t          delivered_frames;
+	uint64_t          dropped_frames;
+};
+
+/** Output thread timing, used to detect when frames are not on schedule */
+struct video_output_timing_stats {
+	uint64_t          total_frames;
+	uint64_t          late_frames;     /**< Frame deadline already passed */
+	uint64_t          missed_frames;   /**< Late by a frame or more */
+	uint64_t          max_lateness_ns;
+
+	/** How long after each frame deadline the output thread woke up */
+	struct time_stats wakeup_jitter;
+};
+
+EXPORT const struct video_data *video_data_retain(
+		const struct video_data *frame);
+EXPORT void video_data_release(const struct video_data *frame);
+
 #define VIDEO_OUTPUT_SUCCESS       0
 #define VIDEO_OUTPUT_INVALIDPARAM -1
 #define VIDEO_OUTPUT_FAIL         -2
 
 EXPORT int video_output_open(video_t *video, struct video_output_info *info);
+
+/**
+ * Opens an output that has no clock of its own.  Its frames are swapped and
+ * passed to its inputs on the parent's frame tick, with the parent's frame
+ * rate, so frames made for both on the same tick stay in step.  Must be
+ * closed before the parent.
+ */
+EXPORT int video_output_open_linked(video_t *video,
+		struct video_output_info *info, video_t parent);
 EXPORT void video_output_close(video_t video);
 
 EXPORT bool video_output_connect(video_t video,
@@ -118,8 +180,69 @@ EXPORT void video_output_disconnect(video_t video,
 		void (*callback)(void *param, const struct video_data *frame),
 		void *param);
 
+EXPORT bool video_output_set_input_queue(video_t video,
+		void (*callback)(void *param, const struct video_data *frame),
+		void *param, uint32_t max_frames,
+		enum video_drop_policy drop_policy);
+EXPORT bool video_output_get_input_stats(video_t video,
+		void (*callback)(void *param, const struct video_data *frame),
+		void *param, struct video_input_stats *stats);
+
 EXPORT const struct video_output_info *video_output_getinfo(video_t video);
+/** Copies a frame into the output's frame pool and queues it for output */
 EXPORT void video_output_swap_frame(video_t video, struct video_data *frame);
+
+/**
+ * Queues a frame for output without copying it.  The planes stay owned by
+ * the caller, and must stay valid until release is called with param once
+ * the output and every input are done with the frame.  release may be
+ * called from any thread.
+ */
+EXPORT void video_output_publish_frame(video_t video,
+		const struct video_data *frame,
+		void (*release)(void *param), void *param);
+
+/**
+ * Queues a copy of the most recent frame again with a new timestamp.
+ * Returns false if no frame has been output yet.
+ */
+EXPORT bool video_output_repeat_frame(video_t video, uint64_t timestamp);
+
+/**
+ * Gets an unused frame from the output's frame pool in the output format.
+ * The caller writes into it and passes it to video_output_submit_frame,
+ * which avoids copying, or gives it back with video_output_discard_frame.
+ */
+EXPORT struct video_frame *video_output_get_frame(video_t video);
+EXPORT void video_output_submit_frame(video_t video, struct video_frame *frame,
+		uint64_t timestamp);
+EXPORT void video_output_discard_frame(video_t video,
+		struct video_frame *frame);
+
+/**
+ * Called with the packed UYVX image a frame from video_output_get_frame is
+ * to be converted from, before that frame is submitted.  Inputs that scale
+ * the output are given frames scaled and converted straight from the image
+ * in one pass, rather than reading the converted frame back.
+ *
+ * Returns true if every input was served that way, in which case the frame
+ * itself does not need to be converted before it is submitted.
+ */
+EXPORT bool video_output_prescale_uyvx(video_t video,
+		struct video_frame *frame, const uint8_t *data,
+		uint32_t linesize, uint64_t timestamp);
+EXPORT void video_output_get_pool_stats(video_t video,
+		struct video_frame_pool_stats *stats);
+EXPORT void video_output_get_timing_stats(video_t video,
+		struct video_output_timing_stats *stats);
+EXPORT void video_output_reset_timing_stats(video_t video);
+
+/**
+ * Sets how long before each frame deadline the output thread stops sleeping
+ * and spins instead (0 by default).  A short spin of a few hundred
+ * microseconds hides scheduler wake-up latency at the cost of some CPU.
+ */
+EXPORT void video_output_set_spin_time(video_t video, uint64_t spin_ns);
 EXPORT bool video_output_wait(video_t video);
 EXPORT uint64_t video_getframetime(video_t video);
 EXPORT uint64_t video_gettime(video_t video);
@@ -17,12 +17,15 @@
 
 #include "../util/bmem.h"
 #include "video-scaler.h"
+#include "video-scaler-native.h"
 
 #include <libswscale/swscale.h>
 
 struct video_scaler {
+	struct native_scaler *native;
 	struct SwsContext *swscale;
 	int src_height;
+	bool uyvx;
 };
 
 static inline enum AVPixelFormat get_ffmpeg_video_format(
@@ -71,6 +74,14 @@ int video_scaler_create(video_scaler_t *scaler_out,
 		const struct video_scale_info *dst,
 		const struct video_scale_info *src,
 		enum video_scale_type type)
+{
+	return video_scaler_create_pooled(scaler_out, dst, src, type, NULL);
+}
+
+int video_scaler_create_pooled(video_scaler_t *scaler_out,
+		const struct video_scale_info *dst,
+		const struct video_scale_info *src,
+		enum video_scale_type type, slice_pool_t pool)
 {
 	enum AVPixelFormat format_src = get_ffmpeg_video_format(src->format);
 	enum AVPixelFormat format_dst = get_ffmpeg_video_format(dst->format);
@@ -90,6 +101,13 @@ int video_scaler_create(video_scaler_t *scaler_out,
 	scaler = bzalloc(sizeof(struct video_scaler));
 	scaler->src_height = src->height;
 
+	/* plain resizes of planar formats don't need swscale */
+	scaler->native = native_scaler_create(dst, src, type, pool);
+	if (scaler->native) {
+		*scaler_out = scaler;
+		return VIDEO_SCALER_SUCCESS;
+	}
+
 	scaler->swscale = sws_getCachedContext(NULL,
 			src->width, src->height, format_src,
 			dst->width, dst->height, format_dst,
@@ -117,9 +135,35 @@ fail:
 	return VIDEO_SCALER_FAILED;
 }
 
+int video_scaler_create_uyvx(video_scaler_t *scaler_out,
+		const struct video_scale_info *dst,
+		const struct video_scale_info *src,
+		enum video_scale_type type, slice_pool_t pool)
+{
+	struct native_scaler *native;
+	struct video_scaler  *scaler;
+
+	if (!scaler_out)
+		return VIDEO_SCALER_FAILED;
+
+	/* swscale has no UYVX input, so this is native only */
+	native = native_scaler_create_uyvx(dst, src, type, pool);
+	if (!native)
+		return VIDEO_SCALER_BAD_CONVERSION;
+
+	scaler = bzalloc(sizeof(struct video_scaler));
+	scaler->native     = native;
+	scaler->src_height = src->height;
+	scaler->uyvx       = true;
+
+	*scaler_out = scaler;
+	return VIDEO_SCALER_SUCCESS;
+}
+
 void video_scaler_destroy(video_scaler_t scaler)
 {
 	if (scaler) {
+		native_scaler_destroy(scaler->native);
 		sws_freeContext(scaler->swscale);
 		bfree(scaler);
 	}
@@ -129,9 +173,15 @@ bool video_scaler_scale(video_scaler_t scaler,
 		uint8_t *output[], const uint32_t out_linesize[],
 		const uint8_t *const input[], const uint32_t in_linesize[])
 {
-	if (!scaler)
+	if (!scaler || scaler->uyvx)
 		return false;
 
+	if (scaler->native) {
+		native_scaler_scale(scaler->native, output, out_linesize,
+				input, in_linesize);
+		return true;
+	}
+
 	int ret = sws_scale(scaler->swscale,
 			input, in_linesize,
 			0, scaler->src_height,
@@ -144,3 +194,15 @@ bool video_scaler_scale(video_scaler_t scaler,
 
 	return true;
 }
+
+bool video_scaler_scale_uyvx(video_scaler_t scaler,
+		uint8_t *output[], const uint32_t out_linesize[],
+		const uint8_t *input, uint32_t in_linesize)
+{
+	if (!scaler || !scaler->uyvx)
+		return false;
+
+	native_scaler_scale(scaler->native, output, out_linesize,
+			&input, &in_linesize);
+	return true;
+}
@@ -0,0 +1,680 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <emmintrin.h>
+
+#include "../util/bmem.h"
+#include "slice-pool.h"
+#include "video-scaler-native.h"
+
+/*
+ *   Native planar scaler for I420/NV12 resizes without format or color
+ * conversion, which covers the output downscales (1080->720, 1080->540,
+ * 2160->1080).  Each plane is scaled in two passes per output row: a
+ * vertical pass that blends or sums source rows into a 16-bit row with
+ * SSE2, then a horizontal pass that filters that row down to the output.
+ *
+ *   Scale factors of 2 or less (including upscales) are bilinear; integer
+ * factors from 3 to 8 use an area (box) filter.  At exactly 2:1 bilinear
+ * sampling is identical to a 2x2 box, and has a vectorised horizontal pass.
+ * Anything else is left to swscale.
+ *
+ *   The same passes also scale the packed UYVX 4:4:4 image that output
+ * frames are converted from on the CPU, producing a 4:2:0 frame of another
+ * size in one pass rather than converting at full size and scaling that.
+ * The scaled UYVX rows only ever live in a per-slice buffer, and are
+ * subsampled straight into the output planes in pairs.
+ */
+
+#define MAX_AREA_FACTOR 8
+
+enum native_filter {
+	NATIVE_FILTER_BILINEAR,
+	NATIVE_FILTER_AREA
+};
+
+/* source position(s) for each output column or row */
+struct axis_map {
+	uint32_t *idx;     /* first source pixel */
+	uint16_t *weight;  /* bilinear weight of idx+1, out of 256 */
+	uint32_t *next;    /* second source pixel (clamped) */
+	uint32_t factor;   /* area: source pixels per output pixel */
+};
+
+struct plane_scale {
+	uint32_t        src_width, src_height;
+	uint32_t        dst_width, dst_height;
+	uint32_t        channels;
+	struct axis_map x, y;
+};
+
+struct native_scaler {
+	enum native_filter filter;
+	size_t             num_planes;
+	bool               half_width;
+	bool               uyvx;
+
+	struct plane_scale luma;
+	struct plane_scale chroma;
+
+	/* the pool may be shared with other scalers.  each of its bands gets
+	 * band_size bytes of scratch: a 16-bit row, then for UYVX two scaled
+	 * rows */
+	slice_pool_t       pool;
+	uint8_t            *scratch;
+	size_t             band_size;
+	size_t             temp_size;
+	uint32_t           dst_height;
+};
+
+struct scale_job {
+	struct native_scaler  *scaler;
+	uint8_t *const        *output;
+	const uint32_t        *out_linesize;
+	const uint8_t *const  *input;
+	const uint32_t        *in_linesize;
+};
+
+/* ------------------------------------------------------------------------- */
+
+static void free_axis_map(struct axis_map *map)
+{
+	bfree(map->idx);
+	bfree(map->weight);
+	bfree(map->next);
+}
+
+static void make_bilinear_map(struct axis_map *map, uint32_t src_size,
+		uint32_t dst_size)
+{
+	double ratio = (double)src_size / (double)dst_size;
+
+	map->idx    = bmalloc(sizeof(uint32_t) * dst_size);
+	map->next   = bmalloc(sizeof(uint32_t) * dst_size);
+	map->weight = bmalloc(sizeof(uint16_t) * dst_size);
+
+	for (uint32_t i = 0; i < dst_size; i++) {
+		double   pos = ((double)i + 0.5) * ratio - 0.5;
+		double   base;
+		uint32_t idx;
+
+		if (pos < 0.0)
+			pos = 0.0;
+
+		base = floor(pos);
+		idx  = (uint32_t)base;
+
+		if (idx >= src_size - 1) {
+			map->idx[i]    = src_size - 1;
+			map->next[i]   = src_size - 1;
+			map->weight[i] = 0;
+		} else {
+			map->idx[i]    = idx;
+			map->next[i]   = idx + 1;
+			map->weight[i] = (uint16_t)floor((pos - base) * 256.0
+					+ 0.5);
+		}
+	}
+}
+
+static void make_area_map(struct axis_map *map, uint32_t factor,
+		uint32_t dst_size)
+{
+	map->factor = factor;
+	map->idx    = bmalloc(sizeof(uint32_t) * dst_size);
+
+	for (uint32_t i = 0; i < dst_size; i++)
+		map->idx[i] = i * factor;
+}
+
+static void init_plane(struct plane_scale *plane, enum native_filter filter,
+		uint32_t src_width, uint32_t src_height,
+		uint32_t dst_width, uint32_t dst_height, uint32_t channels)
+{
+	plane->src_width  = src_width;
+	plane->src_height = src_height;
+	plane->dst_width  = dst_width;
+	plane->dst_height = dst_height;
+	plane->channels   = channels;
+
+	if (filter == NATIVE_FILTER_BILINEAR) {
+		make_bilinear_map(&plane->x, src_width,  dst_width);
+		make_bilinear_map(&plane->y, src_height, dst_height);
+	} else {
+		make_area_map(&plane->x, src_width  / dst_width,  dst_width);
+		make_area_map(&plane->y, src_height / dst_height, dst_height);
+	}
+}
+
+static void free_plane(struct plane_scale *plane)
+{
+	free_axis_map(&plane->x);
+	free_axis_map(&plane->y);
+}
+
+/* ------------------------------------------------------------------------- */
+/* vertical passes: source rows -> 16-bit row */
+
+static void blend_rows(uint16_t *dst, const uint8_t *row0,
+		const uint8_t *row1, uint32_t weight, uint32_t size)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i w0   = _mm_set1_epi16((short)(256 - weight));
+	__m128i w1   = _mm_set1_epi16((short)weight);
+	uint32_t x   = 0;
+
+	for (; x + 16 <= size; x += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(row0 + x));
+		__m128i b = _mm_loadu_si128((const __m128i*)(row1 + x));
+		__m128i lo, hi;
+
+		/* at most 255*256, which fits in an unsigned 16-bit lane */
+		lo = _mm_add_epi16(
+			_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), w0),
+			_mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), w1));
+		hi = _mm_add_epi16(
+			_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), w0),
+			_mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), w1));
+
+		_mm_storeu_si128((__m128i*)(dst + x),     lo);
+		_mm_storeu_si128((__m128i*)(dst + x + 8), hi);
+	}
+
+	for (; x < size; x++)
+		dst[x] = (uint16_t)(row0[x] * (256 - weight) +
+				row1[x] * weight);
+}
+
+static void sum_rows(uint16_t *dst, const uint8_t *src, uint32_t linesize,
+		uint32_t count, uint32_t size)
+{
+	__m128i  zero = _mm_setzero_si128();
+	uint32_t x    = 0;
+
+	for (; x + 16 <= size; x += 16) {
+		__m128i lo = zero, hi = zero;
+
+		for (uint32_t i = 0; i < count; i++) {
+			__m128i a = _mm_loadu_si128(
+				(const __m128i*)(src + i * linesize + x));
+			lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(a, zero));
+			hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(a, zero));
+		}
+
+		_mm_storeu_si128((__m128i*)(dst + x),     lo);
+		_mm_storeu_si128((__m128i*)(dst + x + 8), hi);
+	}
+
+	for (; x < size; x++) {
+		uint32_t sum = 0;
+		for (uint32_t i = 0; i < count; i++)
+			sum += src[i * linesize + x];
+		dst[x] = (uint16_t)sum;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* horizontal passes: 16-bit row -> output row */
+
+/* blended rows are scaled by 256, so the result is scaled by 65536 */
+static void filter_bilinear(uint8_t *dst, const uint16_t *src,
+		const struct axis_map *map, uint32_t width, uint32_t channels)
+{
+	for (uint32_t x = 0; x < width; x++) {
+		const uint16_t *a = src + map->idx[x]  * channels;
+		const uint16_t *b = src + map->next[x] * channels;
+		uint32_t w1 = map->weight[x];
+		uint32_t w0 = 256 - w1;
+
+		for (uint32_t c = 0; c < channels; c++)
+			*(dst++) = (uint8_t)((a[c] * w0 + b[c] * w1 + 32768)
+					>> 16);
+	}
+}
+
+static inline __m128i mul_u16_lo(__m128i v, __m128i w)
+{
+	return _mm_unpacklo_epi16(_mm_mullo_epi16(v, w),
+			_mm_mulhi_epu16(v, w));
+}
+
+static inline __m128i mul_u16_hi(__m128i v, __m128i w)
+{
+	return _mm_unpackhi_epi16(_mm_mullo_epi16(v, w),
+			_mm_mulhi_epu16(v, w));
+}
+
+static inline __m128i load_pixel_pair(const uint16_t *p0, const uint16_t *p1)
+{
+	return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)p0),
+			_mm_loadl_epi64((const __m128i*)p1));
+}
+
+/* same as filter_bilinear for 4 channels, two output pixels at a time with
+ * the full 32-bit products */
+static void filter_bilinear_4ch(uint8_t *dst, const uint16_t *src,
+		const struct axis_map *map, uint32_t width)
+{
+	__m128i  round = _mm_set1_epi32(32768);
+	uint32_t x     = 0;
+
+	for (; x + 2 <= width; x += 2) {
+		short   w1_0 = (short)map->weight[x];
+		short   w1_1 = (short)map->weight[x + 1];
+		short   w0_0 = (short)(256 - w1_0);
+		short   w0_1 = (short)(256 - w1_1);
+		__m128i w0, w1, a, b, lo, hi;
+
+		w0 = _mm_set_epi16(w0_1, w0_1, w0_1, w0_1,
+				w0_0, w0_0, w0_0, w0_0);
+		w1 = _mm_set_epi16(w1_1, w1_1, w1_1, w1_1,
+				w1_0, w1_0, w1_0, w1_0);
+
+		a = load_pixel_pair(src + map->idx[x] * 4,
+				src + map->idx[x + 1] * 4);
+		b = load_pixel_pair(src + map->next[x] * 4,
+				src + map->next[x + 1] * 4);
+
+		lo = _mm_add_epi32(mul_u16_lo(a, w0), mul_u16_lo(b, w1));
+		hi = _mm_add_epi32(mul_u16_hi(a, w0), mul_u16_hi(b, w1));
+		lo = _mm_srli_epi32(_mm_add_epi32(lo, round), 16);
+		hi = _mm_srli_epi32(_mm_add_epi32(hi, round), 16);
+
+		lo = _mm_packs_epi32(lo, hi);
+		_mm_storel_epi64((__m128i*)(dst + x * 4),
+				_mm_packus_epi16(lo, lo));
+	}
+
+	if (x < width) {
+		struct axis_map tail = {
+			.idx    = map->idx + x,
+			.weight = map->weight + x,
+			.next   = map->next + x
+		};
+
+		filter_bilinear(dst + x * 4, src, &tail, width - x, 4);
+	}
+}
+
+/* exactly 2:1 with both weights at 128: (a + b + 256) >> 9 per channel */
+static void filter_half(uint8_t *dst, const uint16_t *src, uint32_t width,
+		uint32_t channels)
+{
+	__m128i  zero  = _mm_setzero_si128();
+	__m128i  mask  = _mm_set1_epi32(0xFFFF);
+	__m128i  round = _mm_set1_epi32(256);
+	uint32_t size  = width * channels;
+	uint32_t x     = 0;
+
+	/* 16 source values -> 8 output bytes */
+	for (; x + 8 <= size; x += 8) {
+		__m128i v0 = _mm_loadu_si128((const __m128i*)(src + x*2));
+		__m128i v1 = _mm_loadu_si128((const __m128i*)(src + x*2 + 8));
+		__m128i s0, s1;
+
+		if (channels == 1) {
+			s0 = _mm_add_epi32(_mm_and_si128(v0, mask),
+					_mm_srli_epi32(v0, 16));
+			s1 = _mm_add_epi32(_mm_and_si128(v1, mask),
+					_mm_srli_epi32(v1, 16));
+		} else if (channels == 4) {
+			/* [p0 p1], add the two pixels channel by channel */
+			s0 = _mm_add_epi32(_mm_unpacklo_epi16(v0, zero),
+					_mm_unpackhi_epi16(v0, zero));
+			s1 = _mm_add_epi32(_mm_unpacklo_epi16(v1, zero),
+					_mm_unpackhi_epi16(v1, zero));
+		} else {
+			/* [p0 p2 p1 p3] pixel pairs, then add p0+p1, p2+p3 */
+			v0 = _mm_shuffle_epi32(v0, _MM_SHUFFLE(3, 1, 2, 0));
+			v1 = _mm_shuffle_epi32(v1, _MM_SHUFFLE(3, 1, 2, 0));
+			s0 = _mm_add_epi32(_mm_unpacklo_epi16(v0, zero),
+					_mm_unpackhi_epi16(v0, zero));
+			s1 = _mm_add_epi32(_mm_unpacklo_epi16(v1, zero),
+					_mm_unpackhi_epi16(v1, zero));
+		}
+
+		s0 = _mm_srli_epi32(_mm_add_epi32(s0, round), 9);
+		s1 = _mm_srli_epi32(_mm_add_epi32(s1, round), 9);
+		s0 = _mm_packs_epi32(s0, s1);
+		_mm_storel_epi64((__m128i*)(dst + x),
+				_mm_packus_epi16(s0, zero));
+	}
+
+	for (; x < size; x++) {
+		uint32_t c   = x % channels;
+		uint32_t pos = (x - c) * 2 + c;
+		dst[x] = (uint8_t)((src[pos] + src[pos + channels] + 256) >> 9);
+	}
+}
+
+static void filter_area(uint8_t *dst, const uint16_t *src,
+		const struct axis_map *map, uint32_t width, uint32_t channels,
+		uint32_t area)
+{
+	/* rounds up, which is exact for sums of up to 64 8-bit values */
+	uint64_t inv    = ((1 << 24) + area - 1) / area;
+	uint32_t half   = area / 2;
+	uint32_t factor = map->factor;
+
+	for (uint32_t x = 0; x < width; x++) {
+		const uint16_t *p = src + map->idx[x] * channels;
+
+		for (uint32_t c = 0; c < channels; c++) {
+			uint32_t sum = half;
+			for (uint32_t i = 0; i < factor; i++)
+				sum += p[i * channels + c];
+
+			*(dst++) = (uint8_t)((sum * inv) >> 24);
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void scale_row(const struct native_scaler *scaler,
+		const struct plane_scale *plane, uint16_t *temp,
+		uint8_t *dst, const uint8_t *input, uint32_t in_linesize,
+		uint32_t y)
+{
+	const uint8_t *row = input + plane->y.idx[y] * in_linesize;
+	uint32_t src_size  = plane->src_width * plane->channels;
+
+	if (scaler->filter == NATIVE_FILTER_AREA) {
+		sum_rows(temp, row, in_linesize, plane->y.factor, src_size);
+		filter_area(dst, temp, &plane->x, plane->dst_width,
+				plane->channels,
+				plane->x.factor * plane->y.factor);
+		return;
+	}
+
+	blend_rows(temp, row, input + plane->y.next[y] * in_linesize,
+			plane->y.weight[y], src_size);
+
+	if (scaler->half_width)
+		filter_half(dst, temp, plane->dst_width, plane->channels);
+	else if (plane->channels == 4)
+		filter_bilinear_4ch(dst, temp, &plane->x, plane->dst_width);
+	else
+		filter_bilinear(dst, temp, &plane->x, plane->dst_width,
+				plane->channels);
+}
+
+static void scale_plane_rows(const struct native_scaler *scaler,
+		const struct plane_scale *plane, uint16_t *temp,
+		uint8_t *output, uint32_t out_linesize,
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y)
+{
+	for (uint32_t y = start_y; y < end_y; y++)
+		scale_row(scaler, plane, temp, output + y * out_linesize,
+				input, in_linesize, y);
+}
+
+/* ------------------------------------------------------------------------- */
+/* UYVX 4:4:4 -> 4:2:0 */
+
+/* 2x2 chroma is rounded, unlike the full size conversion which truncates */
+static void subsample_uyvx_rows(const struct native_scaler *scaler,
+		uint8_t *const output[], const uint32_t out_linesize[],
+		const uint8_t *row0, const uint8_t *row1, uint32_t y,
+		uint32_t width)
+{
+	uint8_t *lum0 = output[0] + y * out_linesize[0];
+	uint8_t *lum1 = lum0 + out_linesize[0];
+	uint8_t *u    = output[1] + y / 2 * out_linesize[1];
+	uint8_t *v    = scaler->num_planes == 3 ?
+		output[2] + y / 2 * out_linesize[2] : u + 1;
+	size_t  step  = scaler->num_planes == 3 ? 1 : 2;
+
+	for (uint32_t x = 0; x < width; x += 2) {
+		const uint8_t *a = row0 + x * 4;
+		const uint8_t *b = row1 + x * 4;
+
+		lum0[x]     = a[1];
+		lum0[x + 1] = a[5];
+		lum1[x]     = b[1];
+		lum1[x + 1] = b[5];
+
+		*u = (uint8_t)((a[0] + a[4] + b[0] + b[4] + 2) >> 2);
+		*v = (uint8_t)((a[2] + a[6] + b[2] + b[6] + 2) >> 2);
+		u += step;
+		v += step;
+	}
+}
+
+static void scale_uyvx_rows(const struct native_scaler *scaler,
+		uint16_t *temp, uint8_t *rows, uint8_t *const output[],
+		const uint32_t out_linesize[], const uint8_t *input,
+		uint32_t in_linesize, uint32_t start_y, uint32_t end_y)
+{
+	const struct plane_scale *plane = &scaler->luma;
+	uint32_t row_size = plane->dst_width * 4;
+
+	for (uint32_t y = start_y; y < end_y; y += 2) {
+		scale_row(scaler, plane, temp, rows, input, in_linesize, y);
+		scale_row(scaler, plane, temp, rows + row_size, input,
+				in_linesize, y + 1);
+
+		subsample_uyvx_rows(scaler, output, out_linesize,
+				rows, rows + row_size, y, plane->dst_width);
+	}
+}
+
+/* start_y/end_y are luma rows, always even so chroma rows are whole */
+static void scale_slice(void *param, uint32_t band, uint32_t start_y,
+		uint32_t end_y)
+{
+	struct scale_job     *job     = param;
+	struct native_scaler *scaler  = job->scaler;
+	uint8_t              *scratch = scaler->scratch +
+		band * scaler->band_size;
+	uint16_t             *temp    = (uint16_t*)scratch;
+
+	if (scaler->uyvx) {
+		scale_uyvx_rows(scaler, temp, scratch + scaler->temp_size,
+				job->output, job->out_linesize,
+				job->input[0], job->in_linesize[0],
+				start_y, end_y);
+		return;
+	}
+
+	scale_plane_rows(scaler, &scaler->luma, temp,
+			job->output[0], job->out_linesize[0],
+			job->input[0],  job->in_linesize[0],
+			start_y, end_y);
+
+	for (size_t i = 1; i < scaler->num_planes; i++)
+		scale_plane_rows(scaler, &scaler->chroma, temp,
+				job->output[i], job->out_linesize[i],
+				job->input[i],  job->in_linesize[i],
+				start_y / 2, end_y / 2);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline bool get_area_factor(uint32_t src, uint32_t dst,
+		uint32_t *factor)
+{
+	if (src % dst != 0)
+		return false;
+
+	*factor = src / dst;
+	return *factor >= 2 && *factor <= MAX_AREA_FACTOR;
+}
+
+static bool get_native_filter(const struct video_scale_info *dst,
+		const struct video_scale_info *src, enum native_filter *filter)
+{
+	uint32_t fx, fy;
+
+	/* within 2:1 in both directions, bilinear is exact enough */
+	if (src->width  <= dst->width  * 2 &&
+	    src->height <= dst->height * 2) {
+		*filter = NATIVE_FILTER_BILINEAR;
+		return true;
+	}
+
+	if (get_area_factor(src->width,  dst->width,  &fx) &&
+	    get_area_factor(src->height, dst->height, &fy)) {
+		*filter = NATIVE_FILTER_AREA;
+		return true;
+	}
+
+	return false;
+}
+
+static inline bool is_420_format(enum video_format format)
+{
+	return format == VIDEO_FORMAT_I420 || format == VIDEO_FORMAT_NV12;
+}
+
+static inline bool native_format_supported(const struct video_scale_info *dst,
+		const struct video_scale_info *src)
+{
+	if (src->format != dst->format || !is_420_format(src->format))
+		return false;
+
+	/* no range or matrix conversion here */
+	if (src->full_range != dst->full_range ||
+	    src->colorspace != dst->colorspace)
+		return false;
+
+	return src->width  >= 2 && src->height >= 2 &&
+	       dst->width  >= 2 && dst->height >= 2 &&
+	       (src->width  & 1) == 0 && (src->height & 1) == 0 &&
+	       (dst->width  & 1) == 0 && (dst->height & 1) == 0;
+}
+
+static bool native_scaler_check(const struct video_scale_info *dst,
+		const struct video_scale_info *src,
+		enum video_scale_type type, enum native_filter *filter)
+{
+	if (type != VIDEO_SCALE_FAST_BILINEAR && type != VIDEO_SCALE_BILINEAR)
+		return false;
+	if (!native_format_supported(dst, src))
+		return false;
+
+	return get_native_filter(dst, src, filter);
+}
+
+static struct native_scaler *native_scaler_alloc(
+		const struct video_scale_info *dst,
+		const struct video_scale_info *src,
+		enum native_filter filter, slice_pool_t pool)
+{
+	struct native_scaler *scaler = bzalloc(sizeof(struct native_scaler));
+
+	scaler->filter     = filter;
+	scaler->num_planes = dst->format == VIDEO_FORMAT_NV12 ? 2 : 3;
+	scaler->dst_height = dst->height;
+	scaler->half_width = filter == NATIVE_FILTER_BILINEAR &&
+	                     src->width == dst->width * 2;
+	scaler->pool       = pool;
+	return scaler;
+}
+
+/* called once the planes are set up, so scaling never allocates */
+static void alloc_scratch(struct native_scaler *scaler)
+{
+	const struct plane_scale *luma = &scaler->luma;
+	size_t rows_size = scaler->uyvx ? luma->dst_width * 4 * 2 : 0;
+
+	/* the chroma planes are never wider than luma, even interleaved */
+	scaler->temp_size = sizeof(uint16_t) * luma->src_width *
+		luma->channels;
+	scaler->band_size = (scaler->temp_size + rows_size + 15) & ~15;
+	scaler->scratch   = bmalloc(scaler->band_size *
+			slice_pool_num_threads(scaler->pool));
+}
+
+struct native_scaler *native_scaler_create(
+		const struct video_scale_info *dst,
+		const struct video_scale_info *src,
+		enum video_scale_type type, slice_pool_t pool)
+{
+	struct native_scaler *scaler;
+	enum native_filter   filter;
+	uint32_t             channels;
+
+	if (!native_scaler_check(dst, src, type, &filter))
+		return NULL;
+
+	channels = src->format == VIDEO_FORMAT_NV12 ? 2 : 1;
+	scaler   = native_scaler_alloc(dst, src, filter, pool);
+
+	init_plane(&scaler->luma, filter,
+			src->width, src->height, dst->width, dst->height, 1);
+	init_plane(&scaler->chroma, filter,
+			src->width / 2, src->height / 2,
+			dst->width / 2, dst->height / 2, channels);
+	alloc_scratch(scaler);
+	return scaler;
+}
+
+/* src describes the 4:2:0 frame normally converted from the UYVX image */
+struct native_scaler *native_scaler_create_uyvx(
+		const struct video_scale_info *dst,
+		const struct video_scale_info *src,
+		enum video_scale_type type, slice_pool_t pool)
+{
+	struct video_scale_info same_format = *src;
+	struct native_scaler    *scaler;
+	enum native_filter      filter;
+
+	if (!is_420_format(src->format) || !is_420_format(dst->format))
+		return NULL;
+
+	/* the output format is only chosen by the subsampling */
+	same_format.format = dst->format;
+	if (!native_scaler_check(dst, &same_format, type, &filter))
+		return NULL;
+
+	scaler = native_scaler_alloc(dst, src, filter, pool);
+	scaler->uyvx = true;
+
+	init_plane(&scaler->luma, filter,
+			src->width, src->height, dst->width, dst->height, 4);
+	alloc_scratch(scaler);
+	return scaler;
+}
+
+void native_scaler_destroy(struct native_scaler *scaler)
+{
+	if (scaler) {
+		bfree(scaler->scratch);
+		free_plane(&scaler->luma);
+		free_plane(&scaler->chroma);
+		bfree(scaler);
+	}
+}
+
+void native_scaler_scale(struct native_scaler *scaler,
+		uint8_t *output[], const uint32_t out_linesize[],
+		const uint8_t *const input[], const uint32_t in_linesize[])
+{
+	struct scale_job job = {
+		.scaler       = scaler,
+		.output       = output,
+		.out_linesize = out_linesize,
+		.input        = input,
+		.in_linesize  = in_linesize
+	};
+
+	slice_pool_run_bands(scaler->pool, scale_slice, &job,
+			scaler->dst_height, 2);
+}
@@ -0,0 +1,44 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "slice-pool.h"
+#include "video-scaler.h"
+
+/*
+ * Native planar scaler, used by video_scaler ahead of swscale.  Private to
+ * media-io: the create functions return NULL for conversions they do not
+ * handle, and the caller falls back to swscale.  Rows are split across the
+ * threads of pool if one is given.
+ */
+
+struct native_scaler;
+
+extern struct native_scaler *native_scaler_create(
+		const struct video_scale_info *dst,
+		const struct video_scale_info *src,
+		enum video_scale_type type, slice_pool_t pool);
+extern struct native_scaler *native_scaler_create_uyvx(
+		const struct video_scale_info *dst,
+		const struct video_scale_info *src,
+		enum video_scale_type type, slice_pool_t pool);
+extern void native_scaler_destroy(struct native_scaler *scaler);
+
+extern void native_scaler_scale(struct native_scaler *scaler,
+		uint8_t *output[], const uint32_t out_linesize[],
+		const uint8_t *const input[], const uint32_t in_linesize[]);
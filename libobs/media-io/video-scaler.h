@@ -19,6 +19,7 @@
 
 #include "../util/c99defs.h"
 #include "video-io.h"
+#include "slice-pool.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -35,12 +36,39 @@ EXPORT int video_scaler_create(video_scaler_t *scaler,
 		const struct video_scale_info *dst,
 		const struct video_scale_info *src,
 		enum video_scale_type type);
+
+/**
+ * Same as video_scaler_create, but plain resizes of planar formats are split
+ * across the threads of pool.  The pool may be shared by several scalers,
+ * and must outlive them.
+ */
+EXPORT int video_scaler_create_pooled(video_scaler_t *scaler,
+		const struct video_scale_info *dst,
+		const struct video_scale_info *src,
+		enum video_scale_type type, slice_pool_t pool);
 EXPORT void video_scaler_destroy(video_scaler_t scaler);
 
 EXPORT bool video_scaler_scale(video_scaler_t scaler,
 		uint8_t *output[], const uint32_t out_linesize[],
 		const uint8_t *const input[], const uint32_t in_linesize[]);
 
+/**
+ * Creates a scaler that reads the packed UYVX 4:4:4 image that 4:2:0 frames
+ * are converted from on the CPU (see compress_uyvx_to_i420), and scales and
+ * converts it to an I420 or NV12 frame in a single pass.  src describes the
+ * frame that would normally be converted from the image.  Returns
+ * VIDEO_SCALER_BAD_CONVERSION if the sizes or formats are not supported.
+ * pool is used as by video_scaler_create_pooled, and may be NULL.
+ */
+EXPORT int video_scaler_create_uyvx(video_scaler_t *scaler,
+		const struct video_scale_info *dst,
+		const struct video_scale_info *src,
+		enum video_scale_type type, slice_pool_t pool);
+
+EXPORT bool video_scaler_scale_uyvx(video_scaler_t scaler,
+		uint8_t *output[], const uint32_t out_linesize[],
+		const uint8_t *input, uint32_t in_linesize);
+
 #ifdef __cplusplus
 }
 #endif
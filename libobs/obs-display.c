@@ -23,6 +23,7 @@ bool obs_display_init(struct obs_display *display,
 		struct gs_init_data *graphics_data)
 {
 	pthread_mutex_init_value(&display->draw_callbacks_mutex);
+	display->enabled = true;
 
 	if (graphics_data) {
 		display->swap = gs_create_swapchain(graphics_data);
@@ -92,6 +93,17 @@ void obs_display_resize(obs_display_t display, uint32_t cx, uint32_t cy)
 	pthread_mutex_unlock(&display->draw_callbacks_mutex);
 }
 
+void obs_display_set_enabled(obs_display_t display, bool enable)
+{
+	if (display)
+		display->enabled = enable;
+}
+
+bool obs_display_enabled(obs_display_t display)
+{
+	return display ? display->enabled : false;
+}
+
 void obs_display_add_draw_callback(obs_display_t display,
 		void (*draw)(void *param, uint32_t cx, uint32_t cy),
 		void *param)
@@ -151,7 +163,7 @@ static inline void render_display_end()
 
 void render_display(struct obs_display *display)
 {
-	if (!display) return;
+	if (!display || !display->enabled) return;
 
 	render_display_begin(display);
 
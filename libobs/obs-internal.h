@@ -21,6 +21,7 @@
 #include "util/darray.h"
 #include "util/dstr.h"
 #include "util/threading.h"
+#include "util/time-stats.h"
 #include "callback/signal.h"
 #include "callback/proc.h"
 
@@ -29,10 +30,12 @@
 #include "media-io/audio-resampler.h"
 #include "media-io/video-io.h"
 #include "media-io/audio-io.h"
+#include "media-io/slice-pool.h"
 
 #include "obs.h"
 
-#define NUM_TEXTURES 2
+#define MIN_PIPELINE_DEPTH 2
+#define MAX_PIPELINE_DEPTH 4
 
 
 struct draw_callback {
@@ -57,10 +60,12 @@ extern void free_module(struct obs_module *mod);
 struct obs_view {
 	pthread_mutex_t                 channels_mutex;
 	obs_source_t                    channels[MAX_CHANNELS];
+	volatile long                   channels_changed;
 };
 
 extern bool obs_view_init(struct obs_view *view);
 extern void obs_view_free(struct obs_view *view);
+extern bool obs_view_video_changed(struct obs_view *view);
 
 
 /* ------------------------------------------------------------------------- */
@@ -68,6 +73,7 @@ extern void obs_view_free(struct obs_view *view);
 
 struct obs_display {
 	bool                            size_changed;
+	bool                            enabled;
 	uint32_t                        cx, cy;
 	swapchain_t                     swap;
 	pthread_mutex_t                 draw_callbacks_mutex;
@@ -79,24 +85,80 @@ extern bool obs_display_init(struct obs_display *display,
 extern void obs_display_free(struct obs_display *display);
 
 
+/* ------------------------------------------------------------------------- */
+/* renditions */
+
+/*
+ * A staging surface published as an output frame.  It stays mapped until
+ * the frame is released, which drops one of the two references; the other
+ * belongs to the rendition, which unmaps the surface once it sees the frame
+ * has gone.
+ */
+struct obs_published_surface {
+	stagesurf_t                     surface;
+	volatile long                   refs;
+};
+
+/*
+ * The main texture scaled to one output size, then converted, downloaded
+ * and published through its own video output.  The main output is one, and
+ * any further renditions are scaled from the same main texture each frame.
+ */
+struct obs_video_rendition {
+	video_t                         video;
+	uint32_t                        width;
+	uint32_t                        height;
+
+	stagesurf_t                     copy_surfaces[MAX_PIPELINE_DEPTH];
+	texture_t                       output_textures[MAX_PIPELINE_DEPTH];
+	texture_t                       convert_textures[MAX_PIPELINE_DEPTH];
+	bool                            textures_output[MAX_PIPELINE_DEPTH];
+	bool                            textures_copied[MAX_PIPELINE_DEPTH];
+	bool                            textures_converted[MAX_PIPELINE_DEPTH];
+	stagesurf_t                     mapped_surface;
+	bool                            has_frame;
+
+	/* copy surfaces handed out as frames are replaced by spare ones
+	 * before being staged into again, and become spares once unmapped */
+	bool                            surfaces_published[MAX_PIPELINE_DEPTH];
+	DARRAY(struct obs_published_surface*) published_surfaces;
+	DARRAY(stagesurf_t)             spare_surfaces;
+
+	/* size of the GPU conversion target, in which each plane row starts
+	 * on a row of its own */
+	uint32_t                        conversion_width;
+	uint32_t                        conversion_height;
+};
+
+
 /* ------------------------------------------------------------------------- */
 /* core */
 
 struct obs_core_video {
 	graphics_t                      graphics;
-	stagesurf_t                     copy_surfaces[NUM_TEXTURES];
-	texture_t                       render_textures[NUM_TEXTURES];
-	texture_t                       output_textures[NUM_TEXTURES];
-	texture_t                       convert_textures[NUM_TEXTURES];
-	bool                            textures_rendered[NUM_TEXTURES];
-	bool                            textures_output[NUM_TEXTURES];
-	bool                            textures_copied[NUM_TEXTURES];
-	bool                            textures_converted[NUM_TEXTURES];
-	struct source_frame             convert_frames[NUM_TEXTURES];
+	texture_t                       render_textures[MAX_PIPELINE_DEPTH];
+	bool                            textures_rendered[MAX_PIPELINE_DEPTH];
+	slice_pool_t                    convert_pool;
+	slice_pool_t                    unpack_pool;
 	effect_t                        default_effect;
 	effect_t                        conversion_effect;
-	stagesurf_t                     mapped_surface;
 	int                             cur_texture;
+	int                             pipeline_depth;
+	volatile long                   frames_downloaded;
+	volatile long                   stalled_downloads;
+
+	pthread_mutex_t                 stats_mutex;
+	struct time_stats               stage_times[OBS_VIDEO_STAGE_COUNT];
+	uint64_t                        lagged_frames;
+	uint64_t                        reused_frames;
+
+	/* consecutive frames in which nothing in the main view changed */
+	int                             clean_frames;
+
+	/* displays are redrawn at most once per preview_interval */
+	uint32_t                        preview_fps;
+	uint64_t                        preview_interval;
+	uint64_t                        next_preview_time;
 
 	video_t                         video;
 	pthread_t                       video_thread;
@@ -104,13 +166,13 @@ struct obs_core_video {
 
 	bool                            gpu_conversion;
 	const char                      *conversion_tech;
-	uint32_t                        conversion_height;
-	uint32_t                        plane_offsets[3];
-	uint32_t                        plane_sizes[3];
-	uint32_t                        plane_linewidth[3];
 
-	uint32_t                        output_width;
-	uint32_t                        output_height;
+	/* main_rendition.video is the main video output above.  renditions
+	 * are only changed and drawn with renditions_mutex held */
+	struct obs_video_rendition      main_rendition;
+	pthread_mutex_t                 renditions_mutex;
+	DARRAY(struct obs_video_rendition*) renditions;
+
 	uint32_t                        base_width;
 	uint32_t                        base_height;
 
@@ -170,6 +232,25 @@ extern void *obs_video_thread(void *param);
 /* ------------------------------------------------------------------------- */
 /* sources  */
 
+/*
+ * Fixed size ring of async frames.  Frames are pushed by one thread and
+ * taken by another without locking.  Taking compares and swaps the head, so
+ * the pushing thread can also take the oldest frame to drop it.
+ *
+ *   The head and tail count frames and wrap at ASYNC_RING_POS_MASK, which
+ * stays inside a 32-bit long.  The ring size is a power of two that
+ * divides the wrap, so a position masked to the ring size is still in
+ * order across it.
+ */
+#define ASYNC_RING_SIZE     64
+#define ASYNC_RING_POS_MASK 0x3FFFFFFFL
+
+struct async_ring {
+	struct source_frame             *frames[ASYNC_RING_SIZE];
+	volatile long                   head;
+	volatile long                   tail;
+};
+
 struct obs_source {
 	volatile int                    refs;
 	struct obs_source_info          info;
@@ -206,11 +287,34 @@ struct obs_source {
 	size_t                          audio_storage_size;
 	float                           volume;
 
-	/* async video data */
+	/* async video data.  frames go from the source's thread to the render
+	 * thread through async_frames, and come back through async_free to be
+	 * reused.  video_mutex only serializes the threads taking frames */
 	texture_t                       output_texture;
-	DARRAY(struct source_frame*)    video_frames;
+	struct async_ring               async_frames;
+	struct async_ring               async_free;
+	struct source_frame             *async_next;
+	struct source_frame             *async_spare;
+	volatile long                   async_depth;
+	volatile long                   async_drop;
+	volatile long                   async_dropped;
 	pthread_mutex_t                 video_mutex;
 
+	/* YUV frames are uploaded as their native planes and unpacked to
+	 * async_texrender by the GPU instead of output_texture */
+	texture_t                       async_planes[MAX_AV_PLANES];
+	texrender_t                     async_texrender;
+
+	/* how the async texture was last drawn, to redraw it between frames */
+	bool                            texture_valid;
+	bool                            texture_unpacked;
+	bool                            texture_flip;
+	bool                            texture_yuv;
+	float                           texture_color_matrix[16];
+
+	/* set when settings, filters, or scene items change */
+	volatile long                   video_changed;
+
 	/* filters */
 	struct obs_source               *filter_parent;
 	struct obs_source               *filter_target;
@@ -227,6 +331,12 @@ extern bool obs_source_init(struct obs_source *source,
 extern void obs_source_activate(obs_source_t source);
 extern void obs_source_deactivate(obs_source_t source);
 extern void obs_source_video_tick(obs_source_t source, float seconds);
+extern void obs_source_set_video_changed(obs_source_t source);
+
+/* returns whether the source, its filters, and for scenes its items have
+ * changed what they render since the last call, and clears the change.
+ * only the video thread may call this, or it will miss changes */
+extern bool obs_source_video_changed(obs_source_t source);
 
 
 /* ------------------------------------------------------------------------- */
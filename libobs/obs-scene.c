@@ -111,6 +111,35 @@ static inline void attach_sceneitem(struct obs_scene_item *item,
 	}
 }
 
+static inline void scene_changed(struct obs_scene *scene)
+{
+	if (scene)
+		obs_source_set_video_changed(scene->source);
+}
+
+static bool scene_video_changed(void *data)
+{
+	struct obs_scene *scene = data;
+	struct obs_scene_item *item;
+	bool changed = false;
+
+	pthread_mutex_lock(&scene->mutex);
+
+	item = scene->first_item;
+
+	while (item) {
+		if (obs_source_removed(item->source) ||
+		    obs_source_video_changed(item->source))
+			changed = true;
+
+		item = item->next;
+	}
+
+	pthread_mutex_unlock(&scene->mutex);
+
+	return changed;
+}
+
 static void scene_video_render(void *data, effect_t effect)
 {
 	struct obs_scene *scene = data;
@@ -161,15 +190,16 @@ static uint32_t scene_getheight(void *data)
 
 static const struct obs_source_info scene_info =
 {
-	.id           = "scene",
-	.type         = OBS_SOURCE_TYPE_SCENE,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW,
-	.getname      = scene_getname,
-	.create       = scene_create,
-	.destroy      = scene_destroy,
-	.video_render = scene_video_render,
-	.getwidth     = scene_getwidth,
-	.getheight    = scene_getheight,
+	.id            = "scene",
+	.type          = OBS_SOURCE_TYPE_SCENE,
+	.output_flags  = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW,
+	.getname       = scene_getname,
+	.create        = scene_create,
+	.destroy       = scene_destroy,
+	.video_render  = scene_video_render,
+	.video_changed = scene_video_changed,
+	.getwidth      = scene_getwidth,
+	.getheight     = scene_getheight,
 };
 
 obs_scene_t obs_scene_create(const char *name)
@@ -301,6 +331,8 @@ obs_sceneitem_t obs_scene_add(obs_scene_t scene, obs_source_t source)
 
 	pthread_mutex_unlock(&scene->mutex);
 
+	scene_changed(scene);
+
 	calldata_setptr(&params, "scene", scene);
 	calldata_setptr(&params, "item", item);
 	signal_handler_signal(scene->source->signals, "add", &params);
@@ -359,6 +391,7 @@ void obs_sceneitem_remove(obs_sceneitem_t item)
 	if (scene)
 		pthread_mutex_unlock(&scene->mutex);
 
+	scene_changed(scene);
 	obs_sceneitem_release(item);
 }
 
@@ -375,21 +408,25 @@ obs_source_t obs_sceneitem_getsource(obs_sceneitem_t item)
 void obs_sceneitem_setpos(obs_sceneitem_t item, const struct vec2 *pos)
 {
 	vec2_copy(&item->pos, pos);
+	scene_changed(item->parent);
 }
 
 void obs_sceneitem_setrot(obs_sceneitem_t item, float rot)
 {
 	item->rot = rot;
+	scene_changed(item->parent);
 }
 
 void obs_sceneitem_setorigin(obs_sceneitem_t item, const struct vec2 *origin)
 {
 	vec2_copy(&item->origin, origin);
+	scene_changed(item->parent);
 }
 
 void obs_sceneitem_setscale(obs_sceneitem_t item, const struct vec2 *scale)
 {
 	vec2_copy(&item->scale, scale);
+	scene_changed(item->parent);
 }
 
 void obs_sceneitem_setorder(obs_sceneitem_t item, enum order_movement movement)
@@ -422,6 +459,8 @@ void obs_sceneitem_setorder(obs_sceneitem_t item, enum order_movement movement)
 		attach_sceneitem(item, NULL);
 	}
 
+	scene_changed(scene);
+
 	obs_scene_release(scene);
 	pthread_mutex_unlock(&scene->mutex);
 }
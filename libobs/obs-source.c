@@ -28,6 +28,8 @@
 #include "obs-internal.h"
 
 static void obs_source_destroy(obs_source_t source);
+static size_t async_ring_count(struct async_ring *ring);
+static void async_ring_free(struct async_ring *ring);
 
 static inline const struct obs_source_info *find_source(struct darray *list,
 		const char *id)
@@ -194,11 +196,16 @@ static void obs_source_destroy(obs_source_t source)
 	for (i = 0; i < source->filters.num; i++)
 		obs_source_release(source->filters.array[i]);
 
-	for (i = 0; i < source->video_frames.num; i++)
-		source_frame_destroy(source->video_frames.array[i]);
+	async_ring_free(&source->async_frames);
+	async_ring_free(&source->async_free);
+	source_frame_destroy(source->async_next);
+	source_frame_destroy(source->async_spare);
 
 	gs_entercontext(obs->video.graphics);
 	texture_destroy(source->output_texture);
+	for (i = 0; i < MAX_AV_PLANES; i++)
+		texture_destroy(source->async_planes[i]);
+	texrender_destroy(source->async_texrender);
 	gs_leavecontext();
 
 	if (source->data)
@@ -214,7 +221,6 @@ static void obs_source_destroy(obs_source_t source)
 	signal_handler_destroy(source->signals);
 
 	texrender_destroy(source->filter_texrender);
-	da_free(source->video_frames);
 	da_free(source->filters);
 	pthread_mutex_destroy(&source->filter_mutex);
 	pthread_mutex_destroy(&source->audio_mutex);
@@ -290,6 +296,8 @@ void obs_source_update(obs_source_t source, obs_data_t settings)
 
 	if (source->info.update)
 		source->info.update(source->data, source->settings);
+
+	obs_source_set_video_changed(source);
 }
 
 void obs_source_activate(obs_source_t source)
@@ -414,8 +422,7 @@ enum convert_type {
 	CONVERT_NONE,
 	CONVERT_NV12,
 	CONVERT_420,
-	CONVERT_422_U,
-	CONVERT_422_Y,
+	CONVERT_422,
 };
 
 static inline enum convert_type get_convert_type(enum video_format format)
@@ -428,9 +435,8 @@ static inline enum convert_type get_convert_type(enum video_format format)
 
 	case VIDEO_FORMAT_YVYU:
 	case VIDEO_FORMAT_YUY2:
-		return CONVERT_422_Y;
 	case VIDEO_FORMAT_UYVY:
-		return CONVERT_422_U;
+		return CONVERT_422;
 
 	case VIDEO_FORMAT_NONE:
 	case VIDEO_FORMAT_RGBA:
@@ -442,8 +448,74 @@ static inline enum convert_type get_convert_type(enum video_format format)
 	return CONVERT_NONE;
 }
 
+static inline enum packed_422_order get_422_order(enum video_format format)
+{
+	switch (format) {
+	case VIDEO_FORMAT_YVYU: return PACKED_422_YVYU;
+	case VIDEO_FORMAT_UYVY: return PACKED_422_UYVY;
+
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_NONE:
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_NV12:
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+		return PACKED_422_YUYV;
+	}
+
+	return PACKED_422_YUYV;
+}
+
+struct unpack_slice {
+	const struct source_frame *frame;
+	enum convert_type         type;
+	uint8_t                   *output;
+	uint32_t                  linesize;
+};
+
+static void unpack_frame_slice(void *param, uint32_t start_y, uint32_t end_y)
+{
+	struct unpack_slice *slice = param;
+	const struct source_frame *frame = slice->frame;
+
+	if (slice->type == CONVERT_420)
+		decompress_420((const uint8_t* const*)frame->data,
+				frame->linesize,
+				start_y, end_y, slice->output, slice->linesize);
+
+	else if (slice->type == CONVERT_NV12)
+		decompress_nv12((const uint8_t* const*)frame->data,
+				frame->linesize,
+				start_y, end_y, slice->output, slice->linesize);
+
+	else if (slice->type == CONVERT_422)
+		decompress_422(frame->data[0], frame->linesize[0],
+				start_y, end_y, slice->output, slice->linesize,
+				get_422_order(frame->format));
+}
+
+/* only the graphics thread unpacks frames, so the pool is created there the
+ * first time a frame can not be unpacked by the GPU */
+static slice_pool_t get_unpack_pool(void)
+{
+	struct obs_core_video *video = &obs->video;
+
+	if (!video->unpack_pool) {
+		if (slice_pool_create(&video->unpack_pool, 0) !=
+				SLICE_POOL_SUCCESS)
+			return NULL;
+
+		blog(LOG_INFO, "CPU async frame unpacking using %u thread(s)",
+				slice_pool_num_threads(video->unpack_pool));
+	}
+
+	return video->unpack_pool;
+}
+
 static bool upload_frame(texture_t tex, const struct source_frame *frame)
 {
+	struct unpack_slice slice;
 	void *ptr;
 	uint32_t linesize;
 	enum convert_type type = get_convert_type(frame->format);
@@ -457,68 +529,291 @@ static bool upload_frame(texture_t tex, const struct source_frame *frame)
 	if (!texture_map(tex, &ptr, &linesize))
 		return false;
 
-	if (type == CONVERT_420)
-		decompress_420((const uint8_t* const*)frame->data,
-				frame->linesize,
-				0, frame->height, ptr, linesize);
+	slice.frame    = frame;
+	slice.type     = type;
+	slice.output   = ptr;
+	slice.linesize = linesize;
 
-	else if (type == CONVERT_NV12)
-		decompress_nv12((const uint8_t* const*)frame->data,
-				frame->linesize,
-				0, frame->height, ptr, linesize);
-
-	else if (type == CONVERT_422_Y)
-		decompress_422(frame->data[0], frame->linesize[0],
-				0, frame->height, ptr, linesize, true);
-
-	else if (type == CONVERT_422_U)
-		decompress_422(frame->data[0], frame->linesize[0],
-				0, frame->height, ptr, linesize, false);
+	slice_pool_run(get_unpack_pool(), unpack_frame_slice, &slice,
+			frame->height, 2);
 
 	texture_unmap(tex);
 	return true;
 }
 
-static void obs_source_draw_texture(texture_t tex, struct source_frame *frame)
+/* ------------------------------------------------------------------------- */
+/* GPU unpacking of YUV frames */
+
+static inline const char *get_unpack_technique(enum video_format format)
+{
+	switch (format) {
+	case VIDEO_FORMAT_I420: return "I420_Unpack";
+	case VIDEO_FORMAT_NV12: return "NV12_Unpack";
+	case VIDEO_FORMAT_YVYU: return "YVYU_Unpack";
+	case VIDEO_FORMAT_YUY2: return "YUY2_Unpack";
+	case VIDEO_FORMAT_UYVY: return "UYVY_Unpack";
+
+	case VIDEO_FORMAT_NONE:
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+		return NULL;
+	}
+
+	return NULL;
+}
+
+struct plane_texture {
+	uint32_t             cx, cy;
+	enum gs_color_format format;
+};
+
+/*
+ * Luma and chroma planes are single channel textures (the interleaved NV12
+ * chroma plane included), and packed 4:2:2 frames are RGBA textures holding
+ * one pixel pair per texel.  Returns the number of planes.
+ */
+static size_t get_plane_textures(const struct source_frame *frame,
+		struct plane_texture *planes)
+{
+	uint32_t cx_d2 = (frame->width  + 1) / 2;
+	uint32_t cy_d2 = (frame->height + 1) / 2;
+
+	planes[0].cx     = frame->width;
+	planes[0].cy     = frame->height;
+	planes[0].format = GS_R8;
+
+	switch (frame->format) {
+	case VIDEO_FORMAT_I420:
+		planes[1].cx     = planes[2].cx     = cx_d2;
+		planes[1].cy     = planes[2].cy     = cy_d2;
+		planes[1].format = planes[2].format = GS_R8;
+		return 3;
+
+	case VIDEO_FORMAT_NV12:
+		planes[1].cx     = cx_d2 * 2;
+		planes[1].cy     = cy_d2;
+		planes[1].format = GS_R8;
+		return 2;
+
+	case VIDEO_FORMAT_YVYU:
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_UYVY:
+		planes[0].cx     = cx_d2;
+		planes[0].format = GS_RGBA;
+		return 1;
+
+	case VIDEO_FORMAT_NONE:
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+		return 0;
+	}
+
+	return 0;
+}
+
+static inline bool plane_texture_matches(texture_t tex,
+		const struct plane_texture *plane)
 {
+	return texture_getwidth(tex)       == plane->cx &&
+	       texture_getheight(tex)      == plane->cy &&
+	       texture_getcolorformat(tex) == plane->format;
+}
+
+static bool set_plane_textures(obs_source_t source,
+		const struct source_frame *frame)
+{
+	struct plane_texture planes[MAX_AV_PLANES];
+	size_t num_planes = get_plane_textures(frame, planes);
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		texture_t tex = source->async_planes[i];
+
+		if (tex && i < num_planes &&
+		    plane_texture_matches(tex, planes+i))
+			continue;
+
+		texture_destroy(tex);
+		source->async_planes[i] = NULL;
+
+		if (i >= num_planes)
+			continue;
+
+		source->async_planes[i] = gs_create_texture(planes[i].cx,
+				planes[i].cy, planes[i].format, 1, NULL,
+				GS_DYNAMIC);
+		if (!source->async_planes[i])
+			return false;
+	}
+
+	return num_planes != 0;
+}
+
+static inline void set_unpack_param(effect_t effect, const char *name,
+		float val)
+{
+	eparam_t param = effect_getparambyname(effect, name);
+	effect_setfloat(effect, param, val);
+}
+
+static inline void set_unpack_texture(effect_t effect, const char *name,
+		texture_t tex)
+{
+	eparam_t param = effect_getparambyname(effect, name);
+	if (param && tex)
+		effect_settexture(effect, param, tex);
+}
+
+static void render_unpack(obs_source_t source,
+		const struct source_frame *frame, technique_t tech)
+{
+	effect_t effect     = obs->video.conversion_effect;
+	float    fwidth     = (float)frame->width;
+	float    fheight    = (float)frame->height;
+	float    fwidth_d2  = (float)((frame->width  + 1) / 2);
+	float    fheight_d2 = (float)((frame->height + 1) / 2);
+	size_t   passes, i;
+
+	set_unpack_param(effect, "width",       fwidth);
+	set_unpack_param(effect, "height",      fheight);
+	set_unpack_param(effect, "width_d2_i",  1.0f / fwidth_d2);
+	set_unpack_param(effect, "height_d2_i", 1.0f / fheight_d2);
+	set_unpack_texture(effect, "image",  source->async_planes[0]);
+	set_unpack_texture(effect, "image1", source->async_planes[1]);
+	set_unpack_texture(effect, "image2", source->async_planes[2]);
+
+	gs_ortho(0.0f, fwidth, 0.0f, fheight, -100.0f, 100.0f);
+
+	/* the unpacked alpha is always 1, so the current blend state does not
+	 * affect the result */
+	passes = technique_begin(tech);
+	for (i = 0; i < passes; i++) {
+		technique_beginpass(tech, i);
+		gs_draw_sprite(source->async_planes[0], 0, frame->width,
+				frame->height);
+		technique_endpass(tech);
+	}
+	technique_end(tech);
+}
+
+/*
+ * Uploads the planes of a YUV frame as they are and has the GPU interleave
+ * them into a YUV texture, which is then drawn with the color matrix like
+ * any other YUV texture.  This avoids repacking the frame on the CPU and
+ * uploads half as much data for 4:2:0 and 4:2:2 formats.
+ */
+static bool unpack_frame(obs_source_t source,
+		const struct source_frame *frame, const char *tech_name)
+{
+	effect_t    effect = obs->video.conversion_effect;
+	technique_t tech   = effect_gettechnique(effect, tech_name);
+	bool        success;
+
+	if (!tech || !set_plane_textures(source, frame))
+		return false;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		if (source->async_planes[i])
+			texture_setimage(source->async_planes[i],
+					frame->data[i], frame->linesize[i],
+					false);
+	}
+
+	if (!source->async_texrender)
+		source->async_texrender = texrender_create(GS_RGBA,
+				GS_ZS_NONE);
+
+	texrender_reset(source->async_texrender);
+	success = texrender_begin(source->async_texrender,
+			frame->width, frame->height);
+	if (success) {
+		render_unpack(source, frame, tech);
+		texrender_end(source->async_texrender);
+	}
+
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline texture_t get_async_texture(obs_source_t source)
+{
+	return source->texture_unpacked ?
+		texrender_gettexture(source->async_texrender) :
+		source->output_texture;
+}
+
+static void obs_source_draw_texture(obs_source_t source)
+{
+	texture_t   tex    = get_async_texture(source);
 	effect_t    effect = obs->video.default_effect;
-	bool        yuv    = format_is_yuv(frame->format);
-	const char  *type  = yuv ? "DrawMatrix" : "Draw";
+	const char  *type  = source->texture_yuv ? "DrawMatrix" : "Draw";
 	technique_t tech;
 	eparam_t    param;
 
-	if (!upload_frame(tex, frame))
-		return;
-
 	tech = effect_gettechnique(effect, type);
 	technique_begin(tech);
 	technique_beginpass(tech, 0);
 
-	if (yuv) {
+	if (source->texture_yuv) {
 		param = effect_getparambyname(effect, "color_matrix");
-		effect_setval(effect, param, frame->color_matrix,
+		effect_setval(effect, param, source->texture_color_matrix,
 				sizeof(float) * 16);
 	}
 
 	param = effect_getparambyname(effect, "image");
 	effect_settexture(effect, param, tex);
 
-	gs_draw_sprite(tex, frame->flip ? GS_FLIP_V : 0, 0, 0);
+	gs_draw_sprite(tex, source->texture_flip ? GS_FLIP_V : 0, 0, 0);
 
 	technique_endpass(tech);
 	technique_end(tech);
 }
 
-static void obs_source_render_async_video(obs_source_t source)
+static void obs_source_upload_async_frame(obs_source_t source,
+		struct source_frame *frame)
 {
-	struct source_frame *frame = obs_source_getframe(source);
-	if (!frame)
+	const char *unpack_tech = get_unpack_technique(frame->format);
+
+	source->texture_unpacked = unpack_tech &&
+	                           unpack_frame(source, frame, unpack_tech);
+
+	/* the CPU unpacks frames if the GPU can not */
+	if (source->texture_unpacked)
+		source->texture_valid = true;
+	else
+		source->texture_valid = set_texture_size(source, frame) &&
+		                        upload_frame(source->output_texture,
+		                                     frame);
+
+	/* a display may have consumed the frame before the main view */
+	obs_source_set_video_changed(source);
+
+	if (!source->texture_valid)
 		return;
 
-	if (set_texture_size(source, frame))
-		obs_source_draw_texture(source->output_texture, frame);
+	source->texture_flip = frame->flip;
+	source->texture_yuv  = format_is_yuv(frame->format);
+	memcpy(source->texture_color_matrix, frame->color_matrix,
+			sizeof(source->texture_color_matrix));
+}
+
+/*
+ * Async sources only hand out a frame when a new one is due, so the last
+ * uploaded texture is drawn again in between to keep the source from
+ * dropping out of frames where nothing new arrived.
+ */
+static void obs_source_render_async_video(obs_source_t source)
+{
+	struct source_frame *frame = obs_source_getframe(source);
+	if (frame) {
+		obs_source_upload_async_frame(source, frame);
+		obs_source_releaseframe(source, frame);
+	}
 
-	obs_source_releaseframe(source, frame);
+	if (source->texture_valid)
+		obs_source_draw_texture(source);
 }
 
 static inline void obs_source_render_filters(obs_source_t source)
@@ -575,6 +870,56 @@ void obs_source_video_render(obs_source_t source)
 	}
 }
 
+void obs_source_set_video_changed(obs_source_t source)
+{
+	os_atomic_set_long(&source->video_changed, 1);
+}
+
+static inline bool async_frames_pending(obs_source_t source)
+{
+	bool pending;
+
+	pthread_mutex_lock(&source->video_mutex);
+	pending = source->async_next ||
+	          async_ring_count(&source->async_frames) != 0;
+	pthread_mutex_unlock(&source->video_mutex);
+
+	return pending;
+}
+
+/*
+ * Every part is queried even once a change has been found, since each
+ * query also consumes the pending change flag of that part.
+ */
+bool obs_source_video_changed(obs_source_t source)
+{
+	uint32_t flags = source->info.output_flags;
+	bool changed;
+	size_t i;
+
+	changed = os_atomic_exchange_long(&source->video_changed, 0) != 0;
+
+	if (source->info.video_changed) {
+		if (source->info.video_changed(source->data))
+			changed = true;
+	} else if (source->info.video_render) {
+		changed = true;
+	}
+
+	if ((flags & OBS_SOURCE_ASYNC_VIDEO) == OBS_SOURCE_ASYNC_VIDEO &&
+	    async_frames_pending(source))
+		changed = true;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	for (i = 0; i < source->filters.num; i++) {
+		if (obs_source_video_changed(source->filters.array[i]))
+			changed = true;
+	}
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return changed;
+}
+
 uint32_t obs_source_getwidth(obs_source_t source)
 {
 	if (source->info.getwidth)
@@ -620,6 +965,8 @@ void obs_source_filter_add(obs_source_t source, obs_source_t filter)
 
 	filter->filter_parent = source;
 	filter->filter_target = source;
+
+	obs_source_set_video_changed(source);
 }
 
 void obs_source_filter_remove(obs_source_t source, obs_source_t filter)
@@ -643,6 +990,8 @@ void obs_source_filter_remove(obs_source_t source, obs_source_t filter)
 
 	filter->filter_parent = NULL;
 	filter->filter_target = NULL;
+
+	obs_source_set_video_changed(source);
 }
 
 void obs_source_filter_setorder(obs_source_t source, obs_source_t filter,
@@ -680,6 +1029,8 @@ void obs_source_filter_setorder(obs_source_t source, obs_source_t filter,
 			source : source->filters.array[idx+1];
 		source->filters.array[i]->filter_target = next_filter;
 	}
+
+	obs_source_set_video_changed(source);
 }
 
 obs_data_t obs_source_getsettings(obs_source_t source)
@@ -756,30 +1107,243 @@ static void copy_frame_data(struct source_frame *dst,
 	}
 }
 
-static inline struct source_frame *cache_video(const struct source_frame *frame)
+/* ------------------------------------------------------------------------- */
+/* async frame queue */
+
+/*
+ *   Frames are queued from the source's thread to the render thread through
+ * a fixed size ring, and released frames come back through a second ring to
+ * be reused rather than allocated and freed for every frame.  Neither side
+ * takes a lock to pass a frame.  The render thread keeps the frame it is
+ * waiting to display (async_next) outside of the ring, so a frame dropped by
+ * the source's thread is never one the render thread is looking at.
+ *
+ *   Only frames of the format and size currently being output are reused;
+ * others are freed when they come back.
+ */
+
+#define DEFAULT_ASYNC_DEPTH 32
+#define ASYNC_FREE_FRAMES   8
+
+static size_t async_ring_count(struct async_ring *ring)
 {
-	/* TODO: use an actual cache */
-	struct source_frame *new_frame = source_frame_create(frame->format,
-			frame->width, frame->height);
+	/* the head never passes the tail, so load it first */
+	long head = os_atomic_load_long(&ring->head);
+	long tail = os_atomic_load_long(&ring->tail);
 
-	copy_frame_data(new_frame, frame);
-	return new_frame;
+	return (size_t)((tail - head) & ASYNC_RING_POS_MASK);
 }
 
-void obs_source_output_video(obs_source_t source,
+static inline long async_ring_next(long pos)
+{
+	return (pos + 1) & ASYNC_RING_POS_MASK;
+}
+
+static inline size_t async_ring_index(long pos)
+{
+	return (size_t)pos & (ASYNC_RING_SIZE - 1);
+}
+
+/* only one thread may push to a ring */
+static bool async_ring_push(struct async_ring *ring,
+		struct source_frame *frame, size_t capacity)
+{
+	long tail = ring->tail;
+
+	if (async_ring_count(ring) >= capacity)
+		return false;
+
+	ring->frames[async_ring_index(tail)] = frame;
+	os_atomic_set_long(&ring->tail, async_ring_next(tail));
+	return true;
+}
+
+static struct source_frame *async_ring_pop(struct async_ring *ring)
+{
+	for (;;) {
+		long head = os_atomic_load_long(&ring->head);
+		long tail = os_atomic_load_long(&ring->tail);
+		struct source_frame *frame;
+
+		if (head == tail)
+			return NULL;
+
+		frame = ring->frames[async_ring_index(head)];
+		if (os_atomic_compare_swap_long(&ring->head, head,
+					async_ring_next(head)))
+			return frame;
+	}
+}
+
+static void async_ring_free(struct async_ring *ring)
+{
+	struct source_frame *frame;
+
+	while ((frame = async_ring_pop(ring)) != NULL)
+		source_frame_destroy(frame);
+}
+
+static inline bool frame_matches(const struct source_frame *frame,
+		enum video_format format, uint32_t width, uint32_t height)
+{
+	return frame->format == format &&
+	       frame->width  == width  &&
+	       frame->height == height;
+}
+
+/* called from the source's thread */
+static struct source_frame *get_free_frame(obs_source_t source,
+		enum video_format format, uint32_t width, uint32_t height)
+{
+	struct source_frame *frame = source->async_spare;
+	source->async_spare = NULL;
+
+	if (frame && frame_matches(frame, format, width, height))
+		return frame;
+
+	source_frame_destroy(frame);
+
+	while ((frame = async_ring_pop(&source->async_free)) != NULL) {
+		if (frame_matches(frame, format, width, height))
+			return frame;
+
+		source_frame_destroy(frame);
+	}
+
+	return source_frame_create(format, width, height);
+}
+
+/* called from the source's thread with frames it drops */
+static inline void keep_spare_frame(obs_source_t source,
+		struct source_frame *frame)
+{
+	source_frame_destroy(source->async_spare);
+	source->async_spare = frame;
+	os_atomic_inc_long(&source->async_dropped);
+}
+
+/* called from the render thread with video_mutex held */
+static void obs_source_recycle_frame(obs_source_t source,
+		struct source_frame *frame)
+{
+	if (frame && !async_ring_push(&source->async_free, frame,
+				ASYNC_FREE_FRAMES))
+		source_frame_destroy(frame);
+}
+
+static inline size_t get_async_depth(obs_source_t source)
+{
+	long depth = os_atomic_load_long(&source->async_depth);
+	return depth ? (size_t)depth : DEFAULT_ASYNC_DEPTH;
+}
+
+static inline bool drop_newest(obs_source_t source)
+{
+	return os_atomic_load_long(&source->async_drop) ==
+		OBS_ASYNC_DROP_NEWEST;
+}
+
+static void push_async_frame(obs_source_t source, struct source_frame *frame)
+{
+	size_t depth = get_async_depth(source);
+
+	while (!async_ring_push(&source->async_frames, frame, depth)) {
+		struct source_frame *oldest;
+
+		if (drop_newest(source)) {
+			keep_spare_frame(source, frame);
+			return;
+		}
+
+		oldest = async_ring_pop(&source->async_frames);
+		if (oldest)
+			keep_spare_frame(source, oldest);
+	}
+}
+
+static inline struct source_frame *cache_video(obs_source_t source,
 		const struct source_frame *frame)
 {
-	struct source_frame *output = cache_video(frame);
+	struct source_frame *new_frame = get_free_frame(source,
+			frame->format, frame->width, frame->height);
+
+	copy_frame_data(new_frame, frame);
+	return new_frame;
+}
 
+static void obs_source_queue_frame(obs_source_t source,
+		struct source_frame *output)
+{
 	pthread_mutex_lock(&source->filter_mutex);
 	output = filter_async_video(source, output);
 	pthread_mutex_unlock(&source->filter_mutex);
 
-	if (output) {
-		pthread_mutex_lock(&source->video_mutex);
-		da_push_back(source->video_frames, &output);
-		pthread_mutex_unlock(&source->video_mutex);
+	if (output)
+		push_async_frame(source, output);
+}
+
+static inline bool has_filters(obs_source_t source)
+{
+	bool filtered;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	filtered = source->filters.num != 0;
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return filtered;
+}
+
+void obs_source_output_video(obs_source_t source,
+		const struct source_frame *frame)
+{
+	if (!source || !frame)
+		return;
+
+	/* a frame that would be dropped is not worth copying */
+	if (drop_newest(source) && !has_filters(source) &&
+	    async_ring_count(&source->async_frames) >=
+	    get_async_depth(source)) {
+		os_atomic_inc_long(&source->async_dropped);
+		return;
 	}
+
+	obs_source_queue_frame(source, cache_video(source, frame));
+}
+
+struct source_frame *obs_source_get_output_frame(obs_source_t source,
+		enum video_format format, uint32_t width, uint32_t height)
+{
+	if (!source || format == VIDEO_FORMAT_NONE || !width || !height)
+		return NULL;
+
+	return get_free_frame(source, format, width, height);
+}
+
+void obs_source_submit_output_frame(obs_source_t source,
+		struct source_frame *frame)
+{
+	if (source && frame)
+		obs_source_queue_frame(source, frame);
+}
+
+void obs_source_set_async_queue(obs_source_t source, uint32_t max_frames,
+		enum obs_async_drop drop)
+{
+	if (!source)
+		return;
+
+	if (max_frames > ASYNC_RING_SIZE)
+		max_frames = ASYNC_RING_SIZE;
+
+	os_atomic_set_long(&source->async_depth, (long)max_frames);
+	os_atomic_set_long(&source->async_drop, (long)drop);
+}
+
+uint64_t obs_source_get_dropped_frames(obs_source_t source)
+{
+	return source ?
+		(uint64_t)(unsigned long)os_atomic_load_long(
+				&source->async_dropped) : 0;
 }
 
 static inline struct filtered_audio *filter_async_audio(obs_source_t source,
@@ -925,10 +1489,25 @@ static inline bool frame_out_of_bounds(obs_source_t source, uint64_t ts)
 	return ((ts - source->last_frame_ts) > MAX_TIMESTAMP_JUMP);
 }
 
+/* the render thread takes frames from the queue with video_mutex held */
+static inline struct source_frame *peek_async_frame(obs_source_t source)
+{
+	if (!source->async_next)
+		source->async_next = async_ring_pop(&source->async_frames);
+	return source->async_next;
+}
+
+static inline struct source_frame *take_async_frame(obs_source_t source)
+{
+	struct source_frame *frame = peek_async_frame(source);
+	source->async_next = NULL;
+	return frame;
+}
+
 static inline struct source_frame *get_closest_frame(obs_source_t source,
 		uint64_t sys_time, int *audio_time_refs)
 {
-	struct source_frame *next_frame = source->video_frames.array[0];
+	struct source_frame *next_frame = peek_async_frame(source);
 	struct source_frame *frame      = NULL;
 	uint64_t sys_offset = sys_time - source->last_sys_timestamp;
 	uint64_t frame_time = next_frame->timestamp;
@@ -944,16 +1523,14 @@ static inline struct source_frame *get_closest_frame(obs_source_t source,
 	}
 
 	while (frame_offset <= sys_offset) {
-		source_frame_destroy(frame);
+		obs_source_recycle_frame(source, frame);
 
-		frame = next_frame;
-		da_erase(source->video_frames, 0);
+		frame = take_async_frame(source);
 
-		if (!source->video_frames.num)
+		next_frame = peek_async_frame(source);
+		if (!next_frame)
 			break;
 
-		next_frame = source->video_frames.array[0];
-
 		/* more timestamp checking and compensating */
 		if ((next_frame->timestamp - frame_time) > MAX_TIMESTAMP_JUMP) {
 			source->last_frame_ts =
@@ -982,14 +1559,13 @@ struct source_frame *obs_source_getframe(obs_source_t source)
 
 	pthread_mutex_lock(&source->video_mutex);
 
-	if (!source->video_frames.num)
+	if (!peek_async_frame(source))
 		goto unlock;
 
 	sys_time = os_gettime_ns();
 
 	if (!source->last_frame_ts) {
-		frame = source->video_frames.array[0];
-		da_erase(source->video_frames, 0);
+		frame = take_async_frame(source);
 
 		source->last_frame_ts = frame->timestamp;
 	} else {
@@ -1017,7 +1593,10 @@ unlock:
 void obs_source_releaseframe(obs_source_t source, struct source_frame *frame)
 {
 	if (frame) {
-		source_frame_destroy(frame);
+		pthread_mutex_lock(&source->video_mutex);
+		obs_source_recycle_frame(source, frame);
+		pthread_mutex_unlock(&source->video_mutex);
+
 		obs_source_release(source);
 	}
 }
@@ -194,6 +194,22 @@ struct obs_source_info {
 	 */
 	void (*video_render)(void *data, effect_t effect);
 
+	/**
+	 * Called each frame to find out whether the source would render
+	 * anything different than it did last frame.  Lets the core reuse the
+	 * previous frame when nothing in the scene has changed.
+	 *
+	 * If not implemented, a synchronous source is assumed to change every
+	 * frame, and an async video source is considered changed whenever it
+	 * has a new frame waiting.  Frames are only reused while every source
+	 * in the main view is a scene, an async source, or implements this,
+	 * so static sources should implement it.
+	 *
+	 * @param  data  Source data
+	 * @return       true if the output has changed since the last frame
+	 */
+	bool (*video_changed)(void *data);
+
 	/** @return The width of the source */
 	uint32_t (*getwidth)(void *data);
 
@@ -209,6 +225,10 @@ struct obs_source_info {
 	 * @param  frame  Video frame to filter
 	 * @return        New video frame data.  This can defer video data to
 	 *                be drawn later if time is needed for processing
+	 *
+	 * @note          Frames passed to this function may be recycled by the
+	 *                source, so they must be returned (now or later) rather
+	 *                than destroyed.
 	 */
 	struct source_frame *(*filter_video)(void *data,
 			const struct source_frame *frame);
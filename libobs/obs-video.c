@@ -17,8 +17,10 @@
 
 #include "obs.h"
 #include "obs-internal.h"
+#include "util/platform.h"
 #include "graphics/vec4.h"
 #include "media-io/format-conversion.h"
+#include "media-io/video-frame.h"
 
 static void tick_sources(uint64_t cur_time, uint64_t *last_time)
 {
@@ -40,9 +42,45 @@ static void tick_sources(uint64_t cur_time, uint64_t *last_time)
 /* in obs-display.c */
 extern void render_display(struct obs_display *display);
 
+static bool displays_enabled(void)
+{
+	bool enabled = obs->video.main_display.enabled;
+
+	pthread_mutex_lock(&obs->data.displays_mutex);
+
+	for (size_t i = 0; !enabled && i < obs->data.displays.num; i++)
+		enabled = obs->data.displays.array[i]->enabled;
+
+	pthread_mutex_unlock(&obs->data.displays_mutex);
+	return enabled;
+}
+
+/*
+ * Displays are redrawn on their own schedule when a preview rate is set.
+ * Frame times only approximate the interval, so a display is due when it is
+ * within half an output frame of its time.
+ */
+static bool displays_due(struct obs_core_video *video, uint64_t cur_time)
+{
+	uint64_t half_frame = video_getframetime(video->video) / 2;
+
+	if (!video->preview_interval)
+		return true;
+	if (cur_time + half_frame < video->next_preview_time)
+		return false;
+
+	video->next_preview_time += video->preview_interval;
+
+	/* first frame, or fell behind */
+	if (video->next_preview_time + half_frame <= cur_time)
+		video->next_preview_time = cur_time + video->preview_interval;
+
+	return true;
+}
+
 static inline void render_displays(void)
 {
-	if (!obs->data.valid)
+	if (!obs->data.valid || !displays_enabled())
 		return;
 
 	gs_entercontext(obs_graphics());
@@ -71,14 +109,100 @@ static inline void set_render_size(uint32_t width, uint32_t height)
 	gs_setviewport(0, 0, width, height);
 }
 
-static inline void unmap_last_surface(struct obs_core_video *video)
+static inline void unmap_last_surface(struct obs_video_rendition *rendition)
 {
-	if (video->mapped_surface) {
-		stagesurface_unmap(video->mapped_surface);
-		video->mapped_surface = NULL;
+	if (rendition->mapped_surface) {
+		stagesurface_unmap(rendition->mapped_surface);
+		rendition->mapped_surface = NULL;
 	}
 }
 
+/*
+ *   Frames that need no conversion on the CPU are output straight from the
+ * mapped staging surface.  Outputs may hold such a frame on other threads,
+ * so releasing it only drops a reference, and the surface is unmapped here
+ * the next time a frame is staged.  A copy surface still held when its slot
+ * comes round again is swapped for a spare, so slow outputs never stall the
+ * pipeline.
+ */
+
+static void release_published_surface(void *param)
+{
+	struct obs_published_surface *published = param;
+
+	if (os_atomic_dec_long(&published->refs) == 0)
+		bfree(published);
+}
+
+static void publish_mapped_frame(struct obs_video_rendition *rendition,
+		int download_texture, const struct video_data *frame)
+{
+	struct obs_published_surface *published;
+
+	published = bmalloc(sizeof(struct obs_published_surface));
+	published->surface = rendition->mapped_surface;
+	published->refs    = 2;
+
+	da_push_back(rendition->published_surfaces, &published);
+	rendition->mapped_surface = NULL;
+
+	/* the surface now belongs to the frame until it is released */
+	rendition->surfaces_published[download_texture] = true;
+	rendition->textures_copied[download_texture]    = false;
+
+	video_output_publish_frame(rendition->video, frame,
+			release_published_surface, published);
+}
+
+/* called within the graphics context */
+static void reclaim_published_surfaces(struct obs_video_rendition *rendition)
+{
+	size_t i = 0;
+
+	while (i < rendition->published_surfaces.num) {
+		struct obs_published_surface *published =
+			rendition->published_surfaces.array[i];
+
+		/* only the rendition's own reference left */
+		if (os_atomic_load_long(&published->refs) > 1) {
+			i++;
+			continue;
+		}
+
+		stagesurface_unmap(published->surface);
+		da_push_back(rendition->spare_surfaces, &published->surface);
+		da_erase(rendition->published_surfaces, i);
+		release_published_surface(published);
+	}
+}
+
+/* called within the graphics context.  returns NULL if the slot's surface
+ * is still published and no replacement could be made */
+static stagesurf_t get_copy_surface(struct obs_video_rendition *rendition,
+		int cur_texture)
+{
+	stagesurf_t surface = rendition->copy_surfaces[cur_texture];
+	size_t      spares  = rendition->spare_surfaces.num;
+
+	if (!rendition->surfaces_published[cur_texture])
+		return surface;
+
+	if (spares) {
+		surface = rendition->spare_surfaces.array[spares - 1];
+		da_pop_back(rendition->spare_surfaces);
+	} else {
+		surface = gs_create_stagesurface(
+				stagesurface_getwidth(surface),
+				stagesurface_getheight(surface), GS_RGBA);
+		if (!surface)
+			return NULL;
+	}
+
+	rendition->copy_surfaces[cur_texture]      = surface;
+	rendition->surfaces_published[cur_texture] = false;
+	return surface;
+}
+
 static inline void render_main_texture(struct obs_core_video *video,
 		int cur_texture)
 {
@@ -95,10 +219,11 @@ static inline void render_main_texture(struct obs_core_video *video,
 }
 
 static inline void render_output_texture(struct obs_core_video *video,
+		struct obs_video_rendition *rendition,
 		int cur_texture, int prev_texture)
 {
 	texture_t   texture = video->render_textures[prev_texture];
-	texture_t   target  = video->output_textures[cur_texture];
+	texture_t   target  = rendition->output_textures[cur_texture];
 	uint32_t    width   = texture_getwidth(target);
 	uint32_t    height  = texture_getheight(target);
 
@@ -135,7 +260,7 @@ static inline void render_output_texture(struct obs_core_video *video,
 	}
 	technique_end(tech);
 
-	video->textures_output[cur_texture] = true;
+	rendition->textures_output[cur_texture] = true;
 }
 
 static inline void set_eparam(effect_t effect, const char *name, float val)
@@ -145,12 +270,13 @@ static inline void set_eparam(effect_t effect, const char *name, float val)
 }
 
 static void render_convert_texture(struct obs_core_video *video,
+		struct obs_video_rendition *rendition,
 		int cur_texture, int prev_texture)
 {
-	texture_t   texture = video->output_textures[prev_texture];
-	texture_t   target  = video->convert_textures[cur_texture];
-	float       fwidth  = (float)video->output_width;
-	float       fheight = (float)video->output_height;
+	texture_t   texture = rendition->output_textures[prev_texture];
+	texture_t   target  = rendition->convert_textures[cur_texture];
+	float       fwidth  = (float)rendition->width;
+	float       fheight = (float)rendition->height;
 	size_t      passes, i;
 
 	effect_t    effect  = video->conversion_effect;
@@ -158,11 +284,9 @@ static void render_convert_texture(struct obs_core_video *video,
 	technique_t tech    = effect_gettechnique(effect,
 			video->conversion_tech);
 
-	if (!video->textures_output[prev_texture])
+	if (!rendition->textures_output[prev_texture])
 		return;
 
-	set_eparam(effect, "u_plane_offset", (float)video->plane_offsets[1]);
-	set_eparam(effect, "v_plane_offset", (float)video->plane_offsets[2]);
 	set_eparam(effect, "width",  fwidth);
 	set_eparam(effect, "height", fheight);
 	set_eparam(effect, "width_i",  1.0f / fwidth);
@@ -171,48 +295,73 @@ static void render_convert_texture(struct obs_core_video *video,
 	set_eparam(effect, "height_d2", fheight * 0.5f);
 	set_eparam(effect, "width_d2_i",  1.0f / (fwidth  * 0.5f));
 	set_eparam(effect, "height_d2_i", 1.0f / (fheight * 0.5f));
-	set_eparam(effect, "input_height", (float)video->conversion_height);
+	set_eparam(effect, "width_d4",
+			(float)rendition->conversion_width);
+	set_eparam(effect, "input_height",
+			(float)rendition->conversion_height);
 
 	effect_settexture(effect, image, texture);
 
 	gs_setrendertarget(target, NULL);
-	set_render_size(video->output_width, video->conversion_height);
+	set_render_size(rendition->conversion_width,
+			rendition->conversion_height);
 
 	passes = technique_begin(tech);
 	for (i = 0; i < passes; i++) {
 		technique_beginpass(tech, i);
-		gs_draw_sprite(texture, 0, video->output_width,
-				video->conversion_height);
+		gs_draw_sprite(texture, 0, rendition->conversion_width,
+				rendition->conversion_height);
 		technique_endpass(tech);
 	}
 	technique_end(tech);
 
-	video->textures_converted[cur_texture] = true;
+	rendition->textures_converted[cur_texture] = true;
 }
 
 static inline void stage_output_texture(struct obs_core_video *video,
+		struct obs_video_rendition *rendition,
 		int cur_texture, int prev_texture)
 {
 	texture_t   texture;
 	bool        texture_ready;
-	stagesurf_t copy = video->copy_surfaces[cur_texture];
+	stagesurf_t copy;
 
 	if (video->gpu_conversion) {
-		texture = video->convert_textures[prev_texture];
-		texture_ready = video->textures_converted[prev_texture];
+		texture = rendition->convert_textures[prev_texture];
+		texture_ready = rendition->textures_converted[prev_texture];
 	} else {
-		texture = video->output_textures[prev_texture];
-		texture_ready = video->output_textures[prev_texture];
+		texture = rendition->output_textures[prev_texture];
+		texture_ready = rendition->textures_output[prev_texture];
 	}
 
-	unmap_last_surface(video);
+	unmap_last_surface(rendition);
+	reclaim_published_surfaces(rendition);
 
 	if (!texture_ready)
 		return;
 
+	copy = get_copy_surface(rendition, cur_texture);
+	if (!copy) {
+		rendition->textures_copied[cur_texture] = false;
+		return;
+	}
+
 	gs_stage_texture(copy, texture);
 
-	video->textures_copied[cur_texture] = true;
+	rendition->textures_copied[cur_texture] = true;
+}
+
+/* scales, converts and stages one rendition of the main texture */
+static inline void render_rendition(struct obs_core_video *video,
+		struct obs_video_rendition *rendition,
+		int cur_texture, int prev_texture)
+{
+	render_output_texture(video, rendition, cur_texture, prev_texture);
+	if (video->gpu_conversion)
+		render_convert_texture(video, rendition, cur_texture,
+				prev_texture);
+
+	stage_output_texture(video, rendition, cur_texture, prev_texture);
 }
 
 static inline void render_video(struct obs_core_video *video, int cur_texture,
@@ -224,11 +373,12 @@ static inline void render_video(struct obs_core_video *video, int cur_texture,
 	gs_setcullmode(GS_NEITHER);
 
 	render_main_texture(video, cur_texture);
-	render_output_texture(video, cur_texture, prev_texture);
-	if (video->gpu_conversion)
-		render_convert_texture(video, cur_texture, prev_texture);
+	render_rendition(video, &video->main_rendition, cur_texture,
+			prev_texture);
 
-	stage_output_texture(video, cur_texture, prev_texture);
+	for (size_t i = 0; i < video->renditions.num; i++)
+		render_rendition(video, video->renditions.array[i],
+				cur_texture, prev_texture);
 
 	gs_setrendertarget(NULL, NULL);
 	gs_enable_blending(true);
@@ -238,160 +388,214 @@ static inline void render_video(struct obs_core_video *video, int cur_texture,
 
 /* TODO: replace with more optimal conversion */
 static inline bool download_frame(struct obs_core_video *video,
-		int prev_texture, struct video_data *frame)
+		struct obs_video_rendition *rendition,
+		int download_texture, struct video_data *frame)
 {
-	stagesurf_t surface = video->copy_surfaces[prev_texture];
+	stagesurf_t surface = rendition->copy_surfaces[download_texture];
 
-	if (!video->textures_copied[prev_texture])
+	if (!rendition->textures_copied[download_texture])
 		return false;
 
+	/* with a deeper pipeline the copy has had more frames to finish, so
+	 * this should rarely trigger unless the GPU is falling behind */
+	if (!stagesurface_isready(surface))
+		os_atomic_inc_long(&video->stalled_downloads);
+
 	if (!stagesurface_map(surface, &frame->data[0], &frame->linesize[0]))
 		return false;
 
-	video->mapped_surface = surface;
+	os_atomic_inc_long(&video->frames_downloaded);
+
+	rendition->mapped_surface = surface;
 	return true;
 }
 
-static inline uint32_t calc_linesize(uint32_t pos, uint32_t linesize)
+/* the planes are row-aligned in the converted texture, so they are used
+ * where they are in the mapped surface, with the surface pitch as their
+ * linesizes */
+static void output_gpu_converted_data(
+		struct obs_video_rendition *rendition,
+		int download_texture, struct video_data *frame)
 {
-	uint32_t size = pos % linesize;
-	return size ? size : linesize;
-}
+	uint32_t linesize = frame->linesize[0];
 
-static void copy_dealign(
-		uint8_t *dst, uint32_t dst_pos, uint32_t dst_linesize,
-		const uint8_t *src, uint32_t src_pos, uint32_t src_linesize,
-		uint32_t remaining)
-{
-	while (remaining) {
-		uint32_t src_remainder = src_pos % src_linesize;
-		uint32_t dst_offset = dst_linesize - src_remainder;
-		uint32_t src_offset = src_linesize - src_remainder;
-
-		if (remaining < dst_offset) {
-			memcpy(dst + dst_pos, src + src_pos, remaining);
-			src_pos += remaining;
-			dst_pos += remaining;
-			remaining = 0;
-		} else {
-			memcpy(dst + dst_pos, src + src_pos, dst_offset);
-			src_pos += src_offset;
-			dst_pos += dst_offset;
-			remaining -= dst_offset;
-		}
-	}
+	frame->data[1] = frame->data[0] + rendition->height * linesize;
+	frame->data[2] = frame->data[1] + rendition->width / 2;
+	frame->linesize[1] = linesize;
+	frame->linesize[2] = linesize;
+
+	publish_mapped_frame(rendition, download_texture, frame);
 }
 
-static inline uint32_t make_aligned_linesize_offset(uint32_t offset,
-		uint32_t dst_linesize, uint32_t src_linesize)
+struct convert_slice {
+	const struct video_output_info *info;
+	const struct video_data        *frame;
+	struct video_frame             *new_frame;
+};
+
+static void convert_frame_slice(void *param, uint32_t start_y, uint32_t end_y)
 {
-	uint32_t remainder = offset % dst_linesize;
-	return (offset / dst_linesize) * src_linesize + remainder;
+	struct convert_slice *slice = param;
+
+	if (slice->info->format == VIDEO_FORMAT_I420)
+		compress_uyvx_to_i420(
+				slice->frame->data[0], slice->frame->linesize[0],
+				start_y, end_y,
+				slice->new_frame->data,
+				slice->new_frame->linesize);
+	else
+		compress_uyvx_to_nv12(
+				slice->frame->data[0], slice->frame->linesize[0],
+				start_y, end_y,
+				slice->new_frame->data,
+				slice->new_frame->linesize);
 }
 
-static void fix_gpu_converted_alignment(struct obs_core_video *video,
-		struct video_data *frame, int cur_texture)
+static void output_converted_frame(struct obs_core_video *video,
+		struct obs_video_rendition *rendition,
+		const struct video_data *frame,
+		const struct video_output_info *info)
 {
-	struct source_frame *new_frame = &video->convert_frames[cur_texture];
-	uint32_t src_linesize = frame->linesize[0];
-	uint32_t dst_linesize = video->output_width * 4;
-	uint32_t src_pos      = 0;
+	struct convert_slice slice;
 
-	for (size_t i = 0; i < 3; i++) {
-		if (video->plane_linewidth[i] == 0)
-			break;
+	if (info->format != VIDEO_FORMAT_I420 &&
+	    info->format != VIDEO_FORMAT_NV12) {
+		blog(LOG_WARNING, "convert_frame: unsupported texture format");
+		return;
+	}
 
-		src_pos = make_aligned_linesize_offset(video->plane_offsets[i],
-				dst_linesize, src_linesize);
+	slice.info      = info;
+	slice.frame     = frame;
+	slice.new_frame = video_output_get_frame(rendition->video);
 
-		copy_dealign(new_frame->data[i], 0, dst_linesize,
-				frame->data[0], src_pos, src_linesize,
-				video->plane_sizes[i]);
-	}
+	/* scaled outputs are made from the UYVX image while it is mapped,
+	 * so the frame is only converted at full size if something uses it.
+	 * rows are split in pairs so each band owns whole chroma lines */
+	if (!video_output_prescale_uyvx(rendition->video, slice.new_frame,
+				frame->data[0], frame->linesize[0],
+				frame->timestamp))
+		slice_pool_run(video->convert_pool, convert_frame_slice,
+				&slice, info->height, 2);
 
-	/* replace with cached frames */
-	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-		frame->data[i]     = new_frame->data[i];
-		frame->linesize[i] = new_frame->linesize[i];
-	}
+	video_output_submit_frame(rendition->video, slice.new_frame,
+			frame->timestamp);
 }
 
-static bool set_gpu_converted_data(struct obs_core_video *video,
-		struct video_data *frame, int cur_texture)
+static inline void output_video_data(struct obs_core_video *video,
+		struct obs_video_rendition *rendition, int download_texture,
+		struct video_data *frame)
 {
-	if (frame->linesize[0] == video->output_width*4) {
-		for (size_t i = 0; i < 3; i++) {
-			if (video->plane_linewidth[i] == 0)
-				break;
-
-			frame->linesize[i] = video->plane_linewidth[i];
-			frame->data[i] =
-				frame->data[0] + video->plane_offsets[i];
-		}
-
-	} else {
-		fix_gpu_converted_alignment(video, frame, cur_texture);
-	}
+	const struct video_output_info *info;
+	info = video_output_getinfo(rendition->video);
 
-	return true;
+	if (video->gpu_conversion)
+		output_gpu_converted_data(rendition, download_texture, frame);
+	else if (format_is_yuv(info->format))
+		output_converted_frame(video, rendition, frame, info);
+	else
+		publish_mapped_frame(rendition, download_texture, frame);
 }
 
-static bool convert_frame(struct obs_core_video *video,
-		struct video_data *frame,
-		const struct video_output_info *info, int cur_texture)
+/* records the time spent in a stage and returns the start of the next one */
+static inline uint64_t end_stage(uint64_t *stage_times,
+		enum obs_video_stage stage, uint64_t start)
 {
-	struct source_frame *new_frame = &video->convert_frames[cur_texture];
+	uint64_t end = os_gettime_ns();
+	stage_times[stage] = end - start;
+	return end;
+}
 
-	if (info->format == VIDEO_FORMAT_I420) {
-		compress_uyvx_to_i420(
-				frame->data[0], frame->linesize[0],
-				0, info->height,
-				new_frame->data, new_frame->linesize);
+/*
+ *   Once nothing in the main view has changed for long enough that every
+ * texture in the pipeline holds the same image, the last output frame is
+ * queued again instead of rendering and downloading an identical one.
+ */
+/* renditions added while frames are being reused have nothing to repeat */
+static inline bool renditions_have_frames(struct obs_core_video *video)
+{
+	for (size_t i = 0; i < video->renditions.num; i++) {
+		if (!video->renditions.array[i]->has_frame)
+			return false;
+	}
 
-	} else if (info->format == VIDEO_FORMAT_NV12) {
-		compress_uyvx_to_nv12(
-				frame->data[0], frame->linesize[0],
-				0, info->height,
-				new_frame->data, new_frame->linesize);
+	return true;
+}
 
-	} else {
-		blog(LOG_WARNING, "convert_frame: unsupported texture format");
+/* called with renditions_mutex held */
+static inline bool reuse_frame(struct obs_core_video *video,
+		uint64_t timestamp)
+{
+	if (obs_view_video_changed(&obs->data.main_view)) {
+		video->clean_frames = 0;
 		return false;
 	}
 
-	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-		frame->data[i]     = new_frame->data[i];
-		frame->linesize[i] = new_frame->linesize[i];
+	if (video->clean_frames <= video->pipeline_depth + 2) {
+		video->clean_frames++;
+		return false;
 	}
 
+	if (!renditions_have_frames(video))
+		return false;
+	if (!video_output_repeat_frame(video->video, timestamp))
+		return false;
+
+	for (size_t i = 0; i < video->renditions.num; i++)
+		video_output_repeat_frame(video->renditions.array[i]->video,
+				timestamp);
+
+	pthread_mutex_lock(&video->stats_mutex);
+	video->reused_frames++;
+	pthread_mutex_unlock(&video->stats_mutex);
 	return true;
 }
 
-static inline void output_video_data(struct obs_core_video *video,
-		struct video_data *frame, int cur_texture)
+/* downloads and outputs the oldest staged frame of a rendition */
+static void output_rendition(struct obs_core_video *video,
+		struct obs_video_rendition *rendition, int download_texture,
+		uint64_t timestamp)
 {
-	const struct video_output_info *info;
-	info = video_output_getinfo(video->video);
+	struct video_data frame;
+	bool frame_ready;
 
-	if (video->gpu_conversion) {
-		if (!set_gpu_converted_data(video, frame, cur_texture))
-			return;
+	memset(&frame, 0, sizeof(struct video_data));
+	frame.timestamp = timestamp;
 
-	} else if (format_is_yuv(info->format)) {
-		if (!convert_frame(video, frame, info, cur_texture))
-			return;
-	}
+	gs_entercontext(obs_graphics());
+	frame_ready = download_frame(video, rendition, download_texture,
+			&frame);
+	gs_leavecontext();
 
-	video_output_swap_frame(video->video, frame);
+	if (frame_ready) {
+		output_video_data(video, rendition, download_texture,
+				&frame);
+		rendition->has_frame = true;
+	}
 }
 
-static inline void output_frame(uint64_t timestamp)
+static inline void output_frame(uint64_t timestamp, uint64_t *stage_times)
 {
 	struct obs_core_video *video = &obs->video;
+	int depth        = video->pipeline_depth;
 	int cur_texture  = video->cur_texture;
-	int prev_texture = cur_texture == 0 ? NUM_TEXTURES-1 : cur_texture-1;
+	int prev_texture = (cur_texture + depth - 1) % depth;
+
+	/* the oldest slot, staged depth-1 frames ago */
+	int download_texture = (cur_texture + 1) % depth;
 	struct video_data frame;
 	bool frame_ready;
+	uint64_t start = os_gettime_ns();
+
+	pthread_mutex_lock(&video->renditions_mutex);
+
+	if (reuse_frame(video, timestamp)) {
+		pthread_mutex_unlock(&video->renditions_mutex);
+
+		stage_times[OBS_VIDEO_STAGE_RENDER_VIDEO] = 0;
+		stage_times[OBS_VIDEO_STAGE_DOWNLOAD]     = 0;
+		end_stage(stage_times, OBS_VIDEO_STAGE_OUTPUT, start);
+		return;
+	}
 
 	memset(&frame, 0, sizeof(struct video_data));
 	frame.timestamp = timestamp;
@@ -399,30 +603,67 @@ static inline void output_frame(uint64_t timestamp)
 	gs_entercontext(obs_graphics());
 
 	render_video(video, cur_texture, prev_texture);
-	frame_ready = download_frame(video, prev_texture, &frame);
+	start = end_stage(stage_times, OBS_VIDEO_STAGE_RENDER_VIDEO, start);
+
+	frame_ready = download_frame(video, &video->main_rendition,
+			download_texture, &frame);
+	start = end_stage(stage_times, OBS_VIDEO_STAGE_DOWNLOAD, start);
 
 	gs_leavecontext();
 
 	if (frame_ready)
-		output_video_data(video, &frame, cur_texture);
+		output_video_data(video, &video->main_rendition,
+				download_texture, &frame);
+
+	for (size_t i = 0; i < video->renditions.num; i++)
+		output_rendition(video, video->renditions.array[i],
+				download_texture, timestamp);
 
-	if (++video->cur_texture == NUM_TEXTURES)
+	pthread_mutex_unlock(&video->renditions_mutex);
+	end_stage(stage_times, OBS_VIDEO_STAGE_OUTPUT, start);
+
+	if (++video->cur_texture == depth)
 		video->cur_texture = 0;
 }
 
+static void record_stage_times(struct obs_core_video *video,
+		const uint64_t *stage_times)
+{
+	pthread_mutex_lock(&video->stats_mutex);
+
+	for (size_t i = 0; i < OBS_VIDEO_STAGE_COUNT; i++)
+		time_stats_add(&video->stage_times[i], stage_times[i]);
+
+	if (stage_times[OBS_VIDEO_STAGE_FRAME] >
+			video_getframetime(video->video))
+		video->lagged_frames++;
+
+	pthread_mutex_unlock(&video->stats_mutex);
+}
+
 void *obs_video_thread(void *param)
 {
 	uint64_t last_time = 0;
 
 	while (video_output_wait(obs->video.video)) {
-		uint64_t cur_time = video_gettime(obs->video.video);
+		uint64_t stage_times[OBS_VIDEO_STAGE_COUNT];
+		uint64_t cur_time    = video_gettime(obs->video.video);
+		uint64_t frame_start = os_gettime_ns();
+		uint64_t start       = frame_start;
 
 		tick_sources(cur_time, &last_time);
+		end_stage(stage_times, OBS_VIDEO_STAGE_TICK, start);
 
-		render_displays();
+		output_frame(cur_time, stage_times);
 
-		output_frame(cur_time);
+		/* after the output frame, so previews cannot delay it */
+		start = os_gettime_ns();
+		if (displays_due(&obs->video, cur_time))
+			render_displays();
+		end_stage(stage_times, OBS_VIDEO_STAGE_RENDER_DISPLAYS, start);
 
+		end_stage(stage_times, OBS_VIDEO_STAGE_FRAME, frame_start);
+		record_stage_times(&obs->video, stage_times);
 	}
 
 	UNUSED_PARAMETER(param);
@@ -99,6 +99,29 @@ void obs_view_setsource(obs_view_t view, uint32_t channel,
 		obs_source_release(prev_source);
 
 	pthread_mutex_unlock(&view->channels_mutex);
+
+	os_atomic_set_long(&view->channels_changed, 1);
+}
+
+bool obs_view_video_changed(struct obs_view *view)
+{
+	bool changed;
+
+	changed = os_atomic_exchange_long(&view->channels_changed, 0) != 0;
+
+	pthread_mutex_lock(&view->channels_mutex);
+
+	for (size_t i = 0; i < MAX_CHANNELS; i++) {
+		struct obs_source *source = view->channels[i];
+
+		if (source && (source->removed ||
+		               obs_source_video_changed(source)))
+			changed = true;
+	}
+
+	pthread_mutex_unlock(&view->channels_mutex);
+
+	return changed;
 }
 
 void obs_view_render(obs_view_t view)
@@ -47,53 +47,24 @@ static inline void make_video_info(struct video_output_info *vi,
 	vi->height  = ovi->output_height;
 }
 
-#define PIXEL_SIZE 4
-
-#define GET_ALIGN(val, align) \
-	(((val) + (align-1)) & ~(align-1))
-
-static inline void set_420p_sizes(const struct obs_video_info *ovi)
+static inline void set_420p_sizes(struct obs_video_rendition *rendition)
 {
-	struct obs_core_video *video = &obs->video;
-	uint32_t chroma_pixels;
-	uint32_t total_bytes;
-
-	chroma_pixels = (ovi->output_width * ovi->output_height / 4);
-	chroma_pixels = GET_ALIGN(chroma_pixels, PIXEL_SIZE);
-
-	video->plane_offsets[0] = 0;
-	video->plane_offsets[1] = ovi->output_width * ovi->output_height;
-	video->plane_offsets[2] = video->plane_offsets[1] + chroma_pixels;
-
-	video->plane_linewidth[0] = ovi->output_width;
-	video->plane_linewidth[1] = ovi->output_width/2;
-	video->plane_linewidth[2] = ovi->output_width/2;
-
-	video->plane_sizes[0] = video->plane_offsets[1];
-	video->plane_sizes[1] = video->plane_sizes[0]/4;
-	video->plane_sizes[2] = video->plane_sizes[1];
-
-	total_bytes = video->plane_offsets[2] + chroma_pixels;
-
-	video->conversion_height =
-		(total_bytes/PIXEL_SIZE + ovi->output_width-1) /
-		ovi->output_width;
-
-	video->conversion_height = GET_ALIGN(video->conversion_height, 2);
-	video->conversion_tech = "Planar420";
+	/* four bytes of a plane row per texel, the U and V rows of a chroma
+	 * row side by side under the luma rows */
+	rendition->conversion_width  = (rendition->width + 3) / 4;
+	rendition->conversion_height = rendition->height +
+		(rendition->height + 1) / 2;
 }
 
-static inline void calc_gpu_conversion_sizes(const struct obs_video_info *ovi)
+static inline void calc_gpu_conversion_sizes(
+		struct obs_video_rendition *rendition, enum video_format format)
 {
-	obs->video.conversion_height = 0;
-	memset(obs->video.plane_offsets, 0, sizeof(obs->video.plane_offsets));
-	memset(obs->video.plane_sizes, 0, sizeof(obs->video.plane_sizes));
-	memset(obs->video.plane_linewidth, 0,
-		sizeof(obs->video.plane_linewidth));
+	rendition->conversion_width  = 0;
+	rendition->conversion_height = 0;
 
-	switch ((uint32_t)ovi->output_format) {
+	switch ((uint32_t)format) {
 	case VIDEO_FORMAT_I420:
-		set_420p_sizes(ovi);
+		set_420p_sizes(rendition);
 	}
 }
 
@@ -101,65 +72,145 @@ static bool obs_init_gpu_conversion(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
 
-	calc_gpu_conversion_sizes(ovi);
+	calc_gpu_conversion_sizes(&video->main_rendition, ovi->output_format);
 
-	if (!video->conversion_height) {
+	if (!video->main_rendition.conversion_height) {
 		blog(LOG_INFO, "GPU conversion not available for format: %u",
 				(unsigned int)ovi->output_format);
 		video->gpu_conversion = false;
 		return true;
 	}
 
-	for (size_t i = 0; i < NUM_TEXTURES; i++) {
-		video->convert_textures[i] = gs_create_texture(
-				ovi->output_width, video->conversion_height,
-				GS_RGBA, 1, NULL, GS_RENDERTARGET);
+	video->conversion_tech = "Planar420";
+	return true;
+}
 
-		if (!video->convert_textures[i])
-			return false;
-	}
+static bool obs_init_convert_pool(void)
+{
+	struct obs_core_video *video = &obs->video;
 
+	if (slice_pool_create(&video->convert_pool, 0) != SLICE_POOL_SUCCESS)
+		return false;
+
+	blog(LOG_INFO, "CPU video conversion using %u thread(s)",
+			slice_pool_num_threads(video->convert_pool));
 	return true;
 }
 
-static bool obs_init_textures(struct obs_video_info *ovi)
+/* called within the graphics context */
+static bool init_rendition_textures(struct obs_video_rendition *rendition)
 {
 	struct obs_core_video *video = &obs->video;
-	bool yuv = format_is_yuv(ovi->output_format);
+	uint32_t output_width  = video->gpu_conversion ?
+		rendition->conversion_width : rendition->width;
 	uint32_t output_height = video->gpu_conversion ?
-		video->conversion_height : ovi->output_height;
-	size_t i;
+		rendition->conversion_height : rendition->height;
 
-	for (i = 0; i < NUM_TEXTURES; i++) {
-		video->copy_surfaces[i] = gs_create_stagesurface(
-				ovi->output_width, output_height, GS_RGBA);
+	for (int i = 0; i < video->pipeline_depth; i++) {
+		rendition->copy_surfaces[i] = gs_create_stagesurface(
+				output_width, output_height, GS_RGBA);
 
-		if (!video->copy_surfaces[i])
+		if (!rendition->copy_surfaces[i])
 			return false;
 
-		video->render_textures[i] = gs_create_texture(
-				ovi->base_width, ovi->base_height,
+		rendition->output_textures[i] = gs_create_texture(
+				rendition->width, rendition->height,
 				GS_RGBA, 1, NULL, GS_RENDERTARGET);
 
-		if (!video->render_textures[i])
+		if (!rendition->output_textures[i])
 			return false;
 
-		video->output_textures[i] = gs_create_texture(
-				ovi->output_width, ovi->output_height,
+		if (!video->gpu_conversion)
+			continue;
+
+		rendition->convert_textures[i] = gs_create_texture(
+				rendition->conversion_width,
+				rendition->conversion_height,
 				GS_RGBA, 1, NULL, GS_RENDERTARGET);
 
-		if (!video->output_textures[i])
+		if (!rendition->convert_textures[i])
 			return false;
+	}
+
+	return true;
+}
 
-		if (yuv)
-			source_frame_init(&video->convert_frames[i],
-					ovi->output_format,
-					ovi->output_width, ovi->output_height);
+/* called within the graphics context, after the rendition's video output
+ * has been closed */
+static void free_rendition_textures(struct obs_video_rendition *rendition)
+{
+	if (rendition->mapped_surface)
+		stagesurface_unmap(rendition->mapped_surface);
+	rendition->mapped_surface = NULL;
+
+	for (size_t i = 0; i < rendition->published_surfaces.num; i++) {
+		struct obs_published_surface *published =
+			rendition->published_surfaces.array[i];
+
+		stagesurface_unmap(published->surface);
+		stagesurface_destroy(published->surface);
+		if (os_atomic_dec_long(&published->refs) == 0)
+			bfree(published);
+	}
+	da_free(rendition->published_surfaces);
+
+	for (size_t i = 0; i < rendition->spare_surfaces.num; i++)
+		stagesurface_destroy(rendition->spare_surfaces.array[i]);
+	da_free(rendition->spare_surfaces);
+
+	for (int i = 0; i < obs->video.pipeline_depth; i++) {
+		/* published surfaces were destroyed above */
+		if (!rendition->surfaces_published[i])
+			stagesurface_destroy(rendition->copy_surfaces[i]);
+		rendition->surfaces_published[i] = false;
+		texture_destroy(rendition->convert_textures[i]);
+		texture_destroy(rendition->output_textures[i]);
+
+		rendition->copy_surfaces[i]    = NULL;
+		rendition->convert_textures[i] = NULL;
+		rendition->output_textures[i]  = NULL;
+
+		rendition->textures_output[i]    = false;
+		rendition->textures_copied[i]    = false;
+		rendition->textures_converted[i] = false;
 	}
+}
+
+static bool obs_init_textures(struct obs_video_info *ovi)
+{
+	struct obs_core_video *video = &obs->video;
+	bool yuv = format_is_yuv(ovi->output_format);
+	int i;
+
+	for (i = 0; i < video->pipeline_depth; i++) {
+		video->render_textures[i] = gs_create_texture(
+				ovi->base_width, ovi->base_height,
+				GS_RGBA, 1, NULL, GS_RENDERTARGET);
+
+		if (!video->render_textures[i])
+			return false;
+	}
+
+	if (!init_rendition_textures(&video->main_rendition))
+		return false;
+
+	if (yuv && !video->gpu_conversion)
+		return obs_init_convert_pool();
 
 	return true;
 }
 
+static inline int get_pipeline_depth(const struct obs_video_info *ovi)
+{
+	if (!ovi->gpu_pipeline_depth)
+		return MIN_PIPELINE_DEPTH;
+	if (ovi->gpu_pipeline_depth < MIN_PIPELINE_DEPTH)
+		return MIN_PIPELINE_DEPTH;
+	if (ovi->gpu_pipeline_depth > MAX_PIPELINE_DEPTH)
+		return MAX_PIPELINE_DEPTH;
+	return (int)ovi->gpu_pipeline_depth;
+}
+
 static bool obs_init_graphics(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
@@ -170,10 +221,12 @@ static bool obs_init_graphics(struct obs_video_info *ovi)
 	make_gs_init_data(&graphics_data, ovi);
 	video->base_width    = ovi->base_width;
 	video->base_height   = ovi->base_height;
-	video->output_width  = ovi->output_width;
-	video->output_height = ovi->output_height;
+
+	video->main_rendition.width  = ovi->output_width;
+	video->main_rendition.height = ovi->output_height;
 
 	video->gpu_conversion = ovi->gpu_conversion;
+	video->pipeline_depth = get_pipeline_depth(ovi);
 
 	errorcode = gs_create(&video->graphics, ovi->graphics_module,
 			&graphics_data);
@@ -193,6 +246,9 @@ static bool obs_init_graphics(struct obs_video_info *ovi)
 
 	if (success) {
 		char *filename = find_libobs_data_file("default.effect");
+
+		blog(LOG_INFO, "GPU pipeline depth: %d frames",
+				video->pipeline_depth);
 		video->default_effect = gs_create_effect_from_file(filename,
 				NULL);
 		bfree(filename);
@@ -212,12 +268,26 @@ static bool obs_init_graphics(struct obs_video_info *ovi)
 	return success;
 }
 
+/* limiting displays to the output rate or above would be pointless */
+static inline uint64_t get_preview_interval(const struct obs_video_info *ovi)
+{
+	if (!ovi->preview_fps ||
+	    (uint64_t)ovi->preview_fps * ovi->fps_den >= ovi->fps_num)
+		return 0;
+
+	return 1000000000ULL / ovi->preview_fps;
+}
+
 static bool obs_init_video(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
 	struct video_output_info vi;
 	int errorcode;
 
+	video->preview_fps       = ovi->preview_fps;
+	video->preview_interval  = get_preview_interval(ovi);
+	video->next_preview_time = 0;
+
 	make_video_info(&vi, ovi);
 	errorcode = video_output_open(&video->video, &vi);
 
@@ -230,6 +300,8 @@ static bool obs_init_video(struct obs_video_info *ovi)
 		return false;
 	}
 
+	video->main_rendition.video = video->video;
+
 	if (!obs_display_init(&video->main_display, NULL))
 		return false;
 
@@ -260,39 +332,50 @@ static void stop_video(void)
 
 }
 
+static void free_rendition(struct obs_video_rendition *rendition)
+{
+	/* the output's last frames may still be mapped from its surfaces */
+	video_output_close(rendition->video);
+
+	gs_entercontext(obs->video.graphics);
+	free_rendition_textures(rendition);
+	gs_leavecontext();
+
+	bfree(rendition);
+}
+
 static void obs_free_video(void)
 {
 	struct obs_core_video *video = &obs->video;
 
+	pthread_mutex_lock(&video->renditions_mutex);
+	for (size_t i = 0; i < video->renditions.num; i++)
+		free_rendition(video->renditions.array[i]);
+	da_free(video->renditions);
+	pthread_mutex_unlock(&video->renditions_mutex);
+
 	if (video->video) {
 		obs_display_free(&video->main_display);
 		video_output_close(video->video);
 		video->video = NULL;
+		video->main_rendition.video = NULL;
 	}
 }
 
 static void obs_free_graphics(void)
 {
 	struct obs_core_video *video = &obs->video;
-	size_t i;
+	int i;
 
 	if (video->graphics) {
 		gs_entercontext(video->graphics);
 
-		if (video->mapped_surface)
-			stagesurface_unmap(video->mapped_surface);
+		free_rendition_textures(&video->main_rendition);
 
-		for (i = 0; i < NUM_TEXTURES; i++) {
-			stagesurface_destroy(video->copy_surfaces[i]);
+		for (i = 0; i < video->pipeline_depth; i++) {
 			texture_destroy(video->render_textures[i]);
-			texture_destroy(video->convert_textures[i]);
-			texture_destroy(video->output_textures[i]);
-			source_frame_free(&video->convert_frames[i]);
-
-			video->copy_surfaces[i]    = NULL;
-			video->render_textures[i]  = NULL;
-			video->convert_textures[i] = NULL;
-			video->output_textures[i]  = NULL;
+			video->render_textures[i]   = NULL;
+			video->textures_rendered[i] = false;
 		}
 
 		effect_destroy(video->default_effect);
@@ -301,9 +384,17 @@ static void obs_free_graphics(void)
 
 		gs_leavecontext();
 
+		slice_pool_destroy(video->convert_pool);
+		slice_pool_destroy(video->unpack_pool);
+		video->convert_pool = NULL;
+		video->unpack_pool  = NULL;
+
 		gs_destroy(video->graphics);
 		video->graphics = NULL;
 		video->cur_texture = 0;
+		video->frames_downloaded = 0;
+		video->stalled_downloads = 0;
+		video->clean_frames = 0;
 	}
 }
 
@@ -405,6 +496,13 @@ static bool obs_init(void)
 {
 	obs = bzalloc(sizeof(struct obs_core));
 
+	pthread_mutex_init_value(&obs->video.stats_mutex);
+	pthread_mutex_init_value(&obs->video.renditions_mutex);
+	if (pthread_mutex_init(&obs->video.stats_mutex, NULL) != 0)
+		return false;
+	if (pthread_mutex_init(&obs->video.renditions_mutex, NULL) != 0)
+		return false;
+
 	obs_init_data();
 	return obs_init_handlers();
 }
@@ -443,9 +541,11 @@ void obs_shutdown(void)
 	stop_video();
 
 	obs_free_data();
+	pthread_mutex_destroy(&obs->video.stats_mutex);
 	obs_free_video();
 	obs_free_graphics();
 	obs_free_audio();
+	pthread_mutex_destroy(&obs->video.renditions_mutex);
 	proc_handler_destroy(obs->procs);
 	signal_handler_destroy(obs->signals);
 
@@ -510,9 +610,82 @@ bool obs_get_video_info(struct obs_video_info *ovi)
 	ovi->fps_num       = info->fps_num;
 	ovi->fps_den       = info->fps_den;
 
+	ovi->gpu_conversion     = video->gpu_conversion;
+	ovi->gpu_pipeline_depth = (uint32_t)video->pipeline_depth;
+	ovi->preview_fps        = video->preview_fps;
+
 	return true;
 }
 
+bool obs_get_video_readback_stats(struct obs_video_readback_stats *stats)
+{
+	struct obs_core_video *video = &obs->video;
+
+	if (!obs || !video->graphics || !stats)
+		return false;
+
+	stats->pipeline_depth    = (uint32_t)video->pipeline_depth;
+	stats->frames_downloaded =
+		(uint64_t)os_atomic_load_long(&video->frames_downloaded);
+	stats->stalled_downloads =
+		(uint64_t)os_atomic_load_long(&video->stalled_downloads);
+	return true;
+}
+
+static inline void get_stage_stats(struct obs_video_stage_stats *dst,
+		const struct time_stats *src)
+{
+	dst->count  = src->count;
+	dst->min_ns = src->min_ns;
+	dst->avg_ns = time_stats_avg(src);
+	dst->p99_ns = time_stats_percentile(src, 99.0);
+	dst->max_ns = src->max_ns;
+}
+
+bool obs_get_video_stats(struct obs_video_stats *stats)
+{
+	struct obs_core_video *video = &obs->video;
+	struct video_output_timing_stats timing;
+
+	if (!obs || !video->video || !stats)
+		return false;
+
+	memset(stats, 0, sizeof(struct obs_video_stats));
+
+	pthread_mutex_lock(&video->stats_mutex);
+	for (size_t i = 0; i < OBS_VIDEO_STAGE_COUNT; i++)
+		get_stage_stats(&stats->stages[i], &video->stage_times[i]);
+	stats->lagged_frames = video->lagged_frames;
+	stats->reused_frames = video->reused_frames;
+	pthread_mutex_unlock(&video->stats_mutex);
+
+	video_output_get_timing_stats(video->video, &timing);
+	stats->late_frames     = timing.late_frames;
+	stats->missed_frames   = timing.missed_frames;
+	stats->max_lateness_ns = timing.max_lateness_ns;
+	stats->total_frames    = timing.total_frames;
+	get_stage_stats(&stats->wakeup_jitter, &timing.wakeup_jitter);
+	return true;
+}
+
+void obs_reset_video_stats(void)
+{
+	struct obs_core_video *video = &obs->video;
+
+	if (!obs)
+		return;
+
+	pthread_mutex_lock(&video->stats_mutex);
+	for (size_t i = 0; i < OBS_VIDEO_STAGE_COUNT; i++)
+		time_stats_clear(&video->stage_times[i]);
+	video->lagged_frames = 0;
+	video->reused_frames = 0;
+	pthread_mutex_unlock(&video->stats_mutex);
+
+	if (video->video)
+		video_output_reset_timing_stats(video->video);
+}
+
 bool obs_get_audio_info(struct audio_output_info *aoi)
 {
 	struct obs_core_audio *audio = &obs->audio;
@@ -574,6 +747,88 @@ video_t obs_video(void)
 	return (obs != NULL) ? obs->video.video : NULL;
 }
 
+video_t obs_add_video_rendition(uint32_t width, uint32_t height)
+{
+	struct obs_core_video      *video;
+	struct obs_video_rendition *rendition;
+	struct video_output_info   vi;
+	bool                       success;
+
+	if (!obs || !obs->video.video || !obs->video.graphics)
+		return NULL;
+
+	video   = &obs->video;
+	width  &= 0xFFFFFFFC;
+	height &= 0xFFFFFFFE;
+
+	if (!width || !height)
+		return NULL;
+
+	rendition = bzalloc(sizeof(struct obs_video_rendition));
+	rendition->width  = width;
+	rendition->height = height;
+
+	if (video->gpu_conversion)
+		calc_gpu_conversion_sizes(rendition,
+				video_output_getinfo(video->video)->format);
+
+	vi        = *video_output_getinfo(video->video);
+	vi.name   = "rendition";
+	vi.width  = width;
+	vi.height = height;
+
+	/* swapped on the main output's tick, so frames stay in step */
+	if (video_output_open_linked(&rendition->video, &vi,
+				video->video) != VIDEO_OUTPUT_SUCCESS) {
+		bfree(rendition);
+		return NULL;
+	}
+
+	gs_entercontext(video->graphics);
+	success = init_rendition_textures(rendition);
+	gs_leavecontext();
+
+	if (!success) {
+		blog(LOG_WARNING, "Could not create %ux%u video rendition",
+				width, height);
+		free_rendition(rendition);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&video->renditions_mutex);
+	da_push_back(video->renditions, &rendition);
+	pthread_mutex_unlock(&video->renditions_mutex);
+
+	blog(LOG_INFO, "Added %ux%u video rendition", width, height);
+	return rendition->video;
+}
+
+void obs_remove_video_rendition(video_t rendition_video)
+{
+	struct obs_core_video      *video;
+	struct obs_video_rendition *rendition = NULL;
+
+	if (!obs || !rendition_video)
+		return;
+
+	video = &obs->video;
+
+	pthread_mutex_lock(&video->renditions_mutex);
+
+	for (size_t i = 0; i < video->renditions.num; i++) {
+		if (video->renditions.array[i]->video == rendition_video) {
+			rendition = video->renditions.array[i];
+			da_erase(video->renditions, i);
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&video->renditions_mutex);
+
+	if (rendition)
+		free_rendition(rendition);
+}
+
 /* TODO: optimize this later so it's not just O(N) string lookups */
 static inline struct obs_modal_ui *get_modal_ui_callback(const char *id,
 		const char *task, const char *target)
@@ -785,6 +1040,17 @@ void obs_resize(uint32_t cx, uint32_t cy)
 	obs_display_resize(&obs->video.main_display, cx, cy);
 }
 
+void obs_preview_set_enabled(bool enable)
+{
+	if (obs)
+		obs_display_set_enabled(&obs->video.main_display, enable);
+}
+
+bool obs_preview_enabled(void)
+{
+	return obs ? obs_display_enabled(&obs->video.main_display) : false;
+}
+
 void obs_render_main_view(void)
 {
 	if (!obs) return;
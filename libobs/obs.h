@@ -97,7 +97,8 @@ enum allow_direct_render {
 struct obs_video_info {
 	/**
 	 * Graphics module to use (usually "libobs-opengl" or
-	 * "libobs-d3d11")
+	 * "libobs-d3d11", or "libobs-null"/"libobs-software" to run without
+	 * a GPU)
 	 */
 	const char          *graphics_module;
 
@@ -121,6 +122,68 @@ struct obs_video_info {
 
 	/** Use shaders to convert to different color formats */
 	bool                gpu_conversion;
+
+	/**
+	 * Number of frames in flight between rendering and readback (2-4, 0
+	 * for the default of 2).  Deeper pipelines add latency but give the
+	 * GPU more time to finish copies before they are mapped.
+	 */
+	uint32_t            gpu_pipeline_depth;
+
+	/**
+	 * Maximum rate at which displays/previews are redrawn, in frames per
+	 * second (0 to redraw them with every output frame).  Displays are
+	 * drawn after the output frame so they never delay it.
+	 */
+	uint32_t            preview_fps;
+};
+
+/** Statistics for reading rendered frames back from the GPU */
+struct obs_video_readback_stats {
+	uint32_t            pipeline_depth;
+	uint64_t            frames_downloaded;
+
+	/** Downloads where the staging surface was not yet ready to map */
+	uint64_t            stalled_downloads;
+};
+
+/** Timed stages of the video thread */
+enum obs_video_stage {
+	OBS_VIDEO_STAGE_TICK,            /**< Ticking sources */
+	OBS_VIDEO_STAGE_RENDER_DISPLAYS, /**< Rendering displays/previews */
+	OBS_VIDEO_STAGE_RENDER_VIDEO,    /**< Rendering the output textures */
+	OBS_VIDEO_STAGE_DOWNLOAD,        /**< Mapping the staged frame */
+	OBS_VIDEO_STAGE_OUTPUT,          /**< Converting/outputting the frame */
+	OBS_VIDEO_STAGE_FRAME,           /**< The whole frame */
+	OBS_VIDEO_STAGE_COUNT
+};
+
+struct obs_video_stage_stats {
+	uint64_t            count;
+	uint64_t            min_ns;
+	uint64_t            avg_ns;
+	uint64_t            p99_ns;  /**< Approximate, within 25% */
+	uint64_t            max_ns;
+};
+
+struct obs_video_stats {
+	struct obs_video_stage_stats stages[OBS_VIDEO_STAGE_COUNT];
+
+	/** Frames that took longer than the frame interval to render */
+	uint64_t            lagged_frames;
+
+	/** Output frames whose deadline had already passed */
+	uint64_t            late_frames;
+	/** Output frames late by a full frame interval or more */
+	uint64_t            missed_frames;
+	uint64_t            max_lateness_ns;
+	uint64_t            total_frames;
+
+	/** How long after each on-time frame deadline the output woke up */
+	struct obs_video_stage_stats wakeup_jitter;
+
+	/** Frames that reused the previous output because nothing changed */
+	uint64_t            reused_frames;
 };
 
 /**
@@ -198,6 +261,16 @@ EXPORT bool obs_reset_audio(struct audio_output_info *ai);
 /** Gets the current video settings, returns false if no video */
 EXPORT bool obs_get_video_info(struct obs_video_info *ovi);
 
+/** Gets GPU readback statistics, returns false if no video */
+EXPORT bool obs_get_video_readback_stats(
+		struct obs_video_readback_stats *stats);
+
+/** Gets video thread timing statistics, returns false if no video */
+EXPORT bool obs_get_video_stats(struct obs_video_stats *stats);
+
+/** Clears the video thread timing statistics */
+EXPORT void obs_reset_video_stats(void);
+
 /** Gets the current audio settings, returns false if no audio */
 EXPORT bool obs_get_audio_info(struct audio_output_info *ai);
 
@@ -251,6 +324,24 @@ EXPORT audio_t obs_audio(void);
 /** Gets the main video output handler for this OBS context */
 EXPORT video_t obs_video(void);
 
+/**
+ * Adds a rendition of the main output at another size, for example one
+ * rung of an adaptive streaming ladder.  Each frame it is scaled on the GPU
+ * from the same rendered frame as the main output, then converted to the
+ * output format and downloaded like it, and published through the returned
+ * video output so encoders can connect to it instead of scaling frames
+ * themselves.  Its frames are output on the main output's frame tick with
+ * the same timestamps.  Scaling is bilinear, so sizes below half of the
+ * main texture will alias.
+ *
+ *   Returns NULL if the size is invalid or video is not initialized.
+ * Renditions are removed when video is reset.
+ */
+EXPORT video_t obs_add_video_rendition(uint32_t width, uint32_t height);
+
+/** Removes a rendition added with obs_add_video_rendition */
+EXPORT void obs_remove_video_rendition(video_t rendition);
+
 /**
  * Adds a source to the user source list and increments the reference counter
  * for that source.
@@ -325,6 +416,15 @@ EXPORT void obs_remove_draw_callback(
 /** Changes the size of the main view */
 EXPORT void obs_resize(uint32_t cx, uint32_t cy);
 
+/**
+ * Enables or disables drawing the main view, for example while its window
+ * is minimized.  Enabled by default.
+ */
+EXPORT void obs_preview_set_enabled(bool enable);
+
+/** Returns whether the main view is being drawn */
+EXPORT bool obs_preview_enabled(void);
+
 /** Renders the main view */
 EXPORT void obs_render_main_view(void);
 
@@ -373,6 +473,15 @@ EXPORT void obs_display_destroy(obs_display_t display);
 /** Changes the size of this display */
 EXPORT void obs_display_resize(obs_display_t display, uint32_t cx, uint32_t cy);
 
+/**
+ * Enables or disables drawing this display, for example while it is hidden.
+ * When no display is enabled, no display rendering is done at all.
+ */
+EXPORT void obs_display_set_enabled(obs_display_t display, bool enable);
+
+/** Returns whether this display is being drawn */
+EXPORT bool obs_display_enabled(obs_display_t display);
+
 /**
  * Adds a draw callback for this display context
  *
@@ -489,10 +598,47 @@ EXPORT float obs_source_getvolume(obs_source_t source);
 /* ------------------------------------------------------------------------- */
 /* Functions used by sources */
 
-/** Outputs asynchronous video data */
+/**
+ * Outputs asynchronous video data, which is copied.  Async video must be
+ * output from one thread at a time.
+ */
 EXPORT void obs_source_output_video(obs_source_t source,
 		const struct source_frame *frame);
 
+/**
+ * Gets a recycled frame that an async source can write its video to
+ * directly, avoiding the copy made by obs_source_output_video.  Set the
+ * frame data, timestamp, color matrix and flip, then output it with
+ * obs_source_submit_output_frame.  Every frame gotten must be submitted.
+ * Must be called from the thread that outputs the source's async video.
+ */
+EXPORT struct source_frame *obs_source_get_output_frame(obs_source_t source,
+		enum video_format format, uint32_t width, uint32_t height);
+
+/**
+ * Outputs a frame from obs_source_get_output_frame without copying it.
+ * Async video must be output from one thread at a time.
+ */
+EXPORT void obs_source_submit_output_frame(obs_source_t source,
+		struct source_frame *frame);
+
+/** Which frame is dropped when the async video queue of a source is full */
+enum obs_async_drop {
+	OBS_ASYNC_DROP_OLDEST,   /**< Drop the oldest queued frame (default) */
+	OBS_ASYNC_DROP_NEWEST    /**< Drop the frame being output */
+};
+
+/**
+ * Sets how many async video frames can be queued for rendering (up to 64, 0
+ * for the default of 32), and which frame to drop when the queue is full.
+ * Async video must be output from one thread at a time.
+ */
+EXPORT void obs_source_set_async_queue(obs_source_t source,
+		uint32_t max_frames, enum obs_async_drop drop);
+
+/** @return The number of async video frames dropped from a full queue */
+EXPORT uint64_t obs_source_get_dropped_frames(obs_source_t source);
+
 /** Outputs audio data (always asynchronous) */
 EXPORT void obs_source_output_audio(obs_source_t source,
 		const struct source_audio *audio);
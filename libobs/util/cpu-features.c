@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "cpu-features.h"
+#include "threading.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+static pthread_once_t features_once = PTHREAD_ONCE_INIT;
+static uint32_t       features      = 0;
+
+static inline void get_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t *regs)
+{
+#ifdef _MSC_VER
+	__cpuidex((int*)regs, (int)leaf, (int)subleaf);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static inline uint64_t get_xcr0(void)
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+#define CPUID1_ECX_SSSE3   (1<<9)
+#define CPUID1_ECX_SSE41   (1<<19)
+#define CPUID1_ECX_OSXSAVE (1<<27)
+#define CPUID1_ECX_AVX     (1<<28)
+#define CPUID1_EDX_SSE2    (1<<26)
+#define CPUID7_EBX_AVX2    (1<<5)
+
+#define XCR0_YMM_STATE     0x6
+
+static void detect_features(void)
+{
+	uint32_t regs[4];
+	uint32_t max_leaf;
+	bool     ymm_enabled = false;
+
+	get_cpuid(0, 0, regs);
+	max_leaf = regs[0];
+	if (max_leaf < 1)
+		return;
+
+	get_cpuid(1, 0, regs);
+
+	if (regs[3] & CPUID1_EDX_SSE2)
+		features |= CPU_FEATURE_SSE2;
+	if (regs[2] & CPUID1_ECX_SSSE3)
+		features |= CPU_FEATURE_SSSE3;
+	if (regs[2] & CPUID1_ECX_SSE41)
+		features |= CPU_FEATURE_SSE41;
+
+	if (regs[2] & CPUID1_ECX_OSXSAVE)
+		ymm_enabled = (get_xcr0() & XCR0_YMM_STATE) == XCR0_YMM_STATE;
+
+	if (!ymm_enabled || !(regs[2] & CPUID1_ECX_AVX))
+		return;
+
+	features |= CPU_FEATURE_AVX;
+
+	if (max_leaf >= 7) {
+		get_cpuid(7, 0, regs);
+		if (regs[1] & CPUID7_EBX_AVX2)
+			features |= CPU_FEATURE_AVX2;
+	}
+}
+
+uint32_t cpu_get_features(void)
+{
+	pthread_once(&features_once, detect_features);
+	return features;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+
+/*
+ * Runtime CPU feature detection, used to select SIMD code paths.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CPU_FEATURE_SSE2  (1<<0)
+#define CPU_FEATURE_SSSE3 (1<<1)
+#define CPU_FEATURE_SSE41 (1<<2)
+#define CPU_FEATURE_AVX   (1<<3)
+#define CPU_FEATURE_AVX2  (1<<4)
+
+/**
+ * Returns the CPU_FEATURE_* flags supported by both the processor and the
+ * operating system (AVX/AVX2 require the OS to save YMM state).
+ */
+EXPORT uint32_t cpu_get_features(void);
+
+static inline bool cpu_has_feature(uint32_t feature)
+{
+	return (cpu_get_features() & feature) == feature;
+}
+
+#ifdef __cplusplus
+}
+#endif
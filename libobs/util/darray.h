@@ -309,7 +309,7 @@ static inline void darray_erase(const size_t element_size, struct darray *dst,
 		return;
 	}
 
-	memcpy(darray_item(element_size, dst, idx),
+	memmove(darray_item(element_size, dst, idx),
 			darray_item(element_size, dst, idx+1),
 			element_size*(dst->num-idx));
 }
@@ -412,7 +412,7 @@ static inline void darray_move_item(const size_t element_size,
 		memmove(darray_item(element_size, dst, to+1), p_to,
 				element_size*(from-to));
 	else
-		memcpy(p_from, darray_item(element_size, dst, from+1),
+		memmove(p_from, darray_item(element_size, dst, from+1),
 				element_size*(to-from));
 
 	memcpy(p_to, temp, element_size);
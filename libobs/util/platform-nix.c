@@ -51,24 +51,20 @@ void os_dlclose(void *module)
 	dlclose(module);
 }
 
+/* os_gettime_ns uses the same clock, so the target can be slept to directly
+ * without converting it to a (rounded, preemptible) relative duration */
 bool os_sleepto_ns(uint64_t time_target)
 {
 	uint64_t current = os_gettime_ns();
 	if (time_target < current)
 		return false;
 
-	time_target -= current;
+	struct timespec req;
+	req.tv_sec = (time_t)(time_target/1000000000);
+	req.tv_nsec = (long)(time_target%1000000000);
 
-	struct timespec req, remain;
-	memset(&req, 0, sizeof(req));
-	memset(&remain, 0, sizeof(remain));
-	req.tv_sec = time_target/1000000000;
-	req.tv_nsec = time_target%1000000000;
-
-	while (nanosleep(&req, &remain)) {
-		req = remain;
-		memset(&remain, 0, sizeof(remain));
-	}
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &req, NULL)
+			== EINTR);
 
 	return true;
 }
@@ -85,6 +81,12 @@ uint64_t os_gettime_ns(void)
 	return ((uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec);
 }
 
+int os_get_logical_cores(void)
+{
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return cores > 0 ? (int)cores : 1;
+}
+
 /* should return $HOME/.[name] */
 char *os_get_config_path(const char *name)
 {
@@ -129,6 +129,13 @@ uint64_t os_gettime_ns(void)
 	return (uint64_t)time_val;
 }
 
+int os_get_logical_cores(void)
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors ? (int)info.dwNumberOfProcessors : 1;
+}
+
 /* returns %appdata%\[name] on windows */
 char *os_get_config_path(const char *name)
 {
@@ -29,6 +29,7 @@
 #ifdef _MSC_VER
 #include "../../deps/w32-pthreads/pthread.h"
 #include "../../deps/w32-pthreads/semaphore.h"
+#include <intrin.h>
 #else
 #include <errno.h>
 #include <pthread.h>
@@ -131,6 +132,78 @@ static inline void event_reset(event_t *event)
 	pthread_mutex_unlock(&event->mutex);
 }
 
+/* ------------------------------------------------------------------------- */
+/* atomics */
+
+#ifdef _MSC_VER
+
+static inline long os_atomic_inc_long(volatile long *val)
+{
+	return _InterlockedIncrement(val);
+}
+
+static inline long os_atomic_dec_long(volatile long *val)
+{
+	return _InterlockedDecrement(val);
+}
+
+static inline long os_atomic_load_long(const volatile long *val)
+{
+	return _InterlockedOr((volatile long*)val, 0);
+}
+
+static inline void os_atomic_set_long(volatile long *ptr, long val)
+{
+	_InterlockedExchange(ptr, val);
+}
+
+static inline long os_atomic_exchange_long(volatile long *ptr, long val)
+{
+	return _InterlockedExchange(ptr, val);
+}
+
+static inline bool os_atomic_compare_swap_long(volatile long *val,
+		long old_val, long new_val)
+{
+	return _InterlockedCompareExchange(val, new_val, old_val) == old_val;
+}
+
+#else
+
+static inline long os_atomic_inc_long(volatile long *val)
+{
+	return __atomic_add_fetch(val, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline long os_atomic_dec_long(volatile long *val)
+{
+	return __atomic_sub_fetch(val, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline long os_atomic_load_long(const volatile long *val)
+{
+	return __atomic_load_n(val, __ATOMIC_SEQ_CST);
+}
+
+static inline void os_atomic_set_long(volatile long *ptr, long val)
+{
+	__atomic_store_n(ptr, val, __ATOMIC_SEQ_CST);
+}
+
+static inline long os_atomic_exchange_long(volatile long *ptr, long val)
+{
+	return __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST);
+}
+
+static inline bool os_atomic_compare_swap_long(volatile long *val,
+		long old_val, long new_val)
+{
+	return __atomic_compare_exchange_n(val, &old_val, new_val, false,
+			__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "time-stats.h"
+
+/* buckets 0-3 hold 0-3us, then each power of two is split in four */
+static inline size_t get_bucket(uint64_t ns)
+{
+	uint64_t us  = ns / 1000;
+	uint32_t msb = 0;
+	size_t   idx;
+
+	if (us < 4)
+		return (size_t)us;
+
+	while ((us >> msb) > 1)
+		msb++;
+
+	idx = (msb - 1) * 4 + (size_t)((us >> (msb - 2)) & 3);
+	return idx < TIME_STATS_BUCKETS ? idx : TIME_STATS_BUCKETS - 1;
+}
+
+static inline uint64_t get_bucket_limit(size_t idx)
+{
+	uint32_t msb;
+
+	if (idx < 4)
+		return (idx + 1) * 1000;
+
+	msb = (uint32_t)(idx / 4) + 1;
+	return ((uint64_t)(5 + idx % 4) << (msb - 2)) * 1000;
+}
+
+void time_stats_add(struct time_stats *stats, uint64_t ns)
+{
+	if (!stats->count || ns < stats->min_ns)
+		stats->min_ns = ns;
+	if (ns > stats->max_ns)
+		stats->max_ns = ns;
+
+	stats->count++;
+	stats->total_ns += ns;
+	stats->buckets[get_bucket(ns)]++;
+}
+
+uint64_t time_stats_percentile(const struct time_stats *stats,
+		double percentile)
+{
+	uint64_t target;
+	uint64_t total = 0;
+
+	if (!stats->count)
+		return 0;
+
+	target = (uint64_t)((double)stats->count * percentile / 100.0 + 0.5);
+	if (target < 1)
+		target = 1;
+
+	for (size_t i = 0; i < TIME_STATS_BUCKETS; i++) {
+		total += stats->buckets[i];
+
+		if (total >= target) {
+			uint64_t limit = get_bucket_limit(i);
+			return limit < stats->max_ns ? limit : stats->max_ns;
+		}
+	}
+
+	return stats->max_ns;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2014 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include <string.h>
+#include "c99defs.h"
+
+/*
+ * Timing histogram for nanosecond durations.  Samples are counted in
+ * logarithmic buckets (four per power of two microseconds), so percentiles
+ * are accurate to within 25% while using a fixed amount of memory.
+ *
+ * Not thread safe; callers provide their own locking.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TIME_STATS_BUCKETS 104
+
+struct time_stats {
+	uint64_t count;
+	uint64_t total_ns;
+	uint64_t min_ns;
+	uint64_t max_ns;
+	uint32_t buckets[TIME_STATS_BUCKETS];
+};
+
+EXPORT void time_stats_add(struct time_stats *stats, uint64_t ns);
+
+/** Returns the upper bound of the bucket containing the percentile (0-100) */
+EXPORT uint64_t time_stats_percentile(const struct time_stats *stats,
+		double percentile);
+
+static inline void time_stats_clear(struct time_stats *stats)
+{
+	memset(stats, 0, sizeof(struct time_stats));
+}
+
+static inline uint64_t time_stats_avg(const struct time_stats *stats)
+{
+	return stats->count ? stats->total_ns / stats->count : 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -95,6 +95,8 @@ bool OBSApp::InitGlobalConfigDefaults()
 	config_set_default_uint(globalConfig, "Video", "FPSNum", 30);
 	config_set_default_uint(globalConfig, "Video", "FPSDen", 1);
 	config_set_default_uint(globalConfig, "Video", "FPSNS", 33333333);
+	config_set_default_uint(globalConfig, "Video", "PipelineDepth", 2);
+	config_set_default_uint(globalConfig, "Video", "PreviewFPS", 0);
 
 	return true;
 }
@@ -293,6 +293,10 @@ bool OBSBasic::InitGraphics()
 	ovi.output_format  = VIDEO_FORMAT_I420;
 	ovi.adapter        = 0;
 	ovi.gpu_conversion = true;
+	ovi.gpu_pipeline_depth = (uint32_t)config_get_uint(GetGlobalConfig(),
+			"Video", "PipelineDepth");
+	ovi.preview_fps    = (uint32_t)config_get_uint(GetGlobalConfig(),
+			"Video", "PreviewFPS");
 
 	QTToGSWindow(ui->preview, ovi.window);
 
@@ -315,6 +319,7 @@ bool OBSBasic::InitAudio()
 	ai.format = AUDIO_FORMAT_FLOAT_PLANAR;
 	ai.speakers = SPEAKERS_STEREO;
 	ai.buffer_ms = 700;
+	ai.period_frames = AUDIO_OUTPUT_DEFAULT_PERIOD;
 
 	return obs_reset_audio(&ai);
 }
@@ -355,8 +360,9 @@ void OBSBasic::closeEvent(QCloseEvent *event)
 
 void OBSBasic::changeEvent(QEvent *event)
 {
-	/* TODO */
-	UNUSED_PARAMETER(event);
+	/* no need to draw the preview while it can't be seen */
+	if (event->type() == QEvent::WindowStateChange)
+		obs_preview_set_enabled(!isMinimized());
 }
 
 void OBSBasic::resizeEvent(QResizeEvent *event)
@@ -68,6 +68,13 @@ static void random_video_render(void *data, effect_t effect)
 	gs_draw_sprite(rt->texture, 0, 0, 0);
 }
 
+static bool random_video_changed(void *data)
+{
+	/* the texture is generated once on creation */
+	UNUSED_PARAMETER(data);
+	return false;
+}
+
 static uint32_t random_getwidth(void *data)
 {
 	struct random_tex *rt = data;
@@ -81,13 +88,14 @@ static uint32_t random_getheight(void *data)
 }
 
 struct obs_source_info test_random = {
-	.id           = "random",
-	.type         = OBS_SOURCE_TYPE_INPUT,
-	.output_flags = OBS_SOURCE_VIDEO,
-	.getname      = random_getname,
-	.create       = random_create,
-	.destroy      = random_destroy,
-	.video_render = random_video_render,
-	.getwidth     = random_getwidth,
-	.getheight    = random_getheight
+	.id            = "random",
+	.type          = OBS_SOURCE_TYPE_INPUT,
+	.output_flags  = OBS_SOURCE_VIDEO,
+	.getname       = random_getname,
+	.create        = random_create,
+	.destroy       = random_destroy,
+	.video_render  = random_video_render,
+	.video_changed = random_video_changed,
+	.getwidth      = random_getwidth,
+	.getheight     = random_getheight
 };
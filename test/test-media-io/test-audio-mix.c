@@ -0,0 +1,186 @@
+/*
+ * Checks the SSE2 and AVX2 audio mixing kernels against plain scalar
+ * references, bit for bit, at counts that are not a multiple of the vector
+ * widths and from unaligned pointers.  The clamp input includes NaN,
+ * infinities and denormals.  The SSE2 kernels are static, so the file they
+ * are in is built as part of this one.
+ */
+
+#include "test-media-io.h"
+
+#include <math.h>
+#include <float.h>
+
+#include <media-io/audio-mix.c>
+
+typedef void (*mix_proc_t)(float *mix, const float *src, size_t count,
+		float gain, float gain_step);
+typedef void (*clamp_proc_t)(float *mix, size_t count);
+
+struct mix_kernel {
+	const char   *name;
+	mix_proc_t   mix_float;
+	clamp_proc_t clamp_float;
+};
+
+struct gain_ramp {
+	float gain;
+	float gain_step;
+};
+
+static const size_t counts[] = {
+	0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 480, 1023, 1024
+};
+
+static const size_t offsets[] = {0, 1, 3};
+
+static const struct gain_ramp ramps[] = {
+	{1.0f,   0.0f},
+	{0.5f,   0.0f},
+	{0.0f,   1.0f / 1024.0f},
+	{1.0f,  -1.0f / 1024.0f},
+	{0.25f,  3.0f / 480.0f},
+};
+
+#define array_size(a) (sizeof(a) / sizeof(a[0]))
+
+/* ------------------------------------------------------------------------- */
+/* references */
+
+static void mix_float_ref(float *mix, const float *src, size_t count,
+		float gain, float gain_step)
+{
+	for (size_t i = 0; i < count; i++) {
+		float sample_gain = gain + (float)(int)i * gain_step;
+		mix[i] += src[i] * sample_gain;
+	}
+}
+
+static void clamp_float_ref(float *mix, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (isnan(mix[i]) || mix[i] < -1.0f)
+			mix[i] = -1.0f;
+		else if (mix[i] > 1.0f)
+			mix[i] = 1.0f;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+static float rand_sample(uint32_t *state)
+{
+	return (float)((int)(test_rand(state) & 0xFFFF) - 0x8000) / 16384.0f;
+}
+
+static const float special_samples[] = {
+	NAN, INFINITY, -INFINITY, FLT_MIN / 4.0f, -FLT_MIN / 4.0f, 0.0f, -0.0f,
+	1.0f, -1.0f, 1.0000001f, -1.0000001f, FLT_MAX, -FLT_MAX
+};
+
+static float *alloc_samples(size_t count, bool special, uint32_t *state)
+{
+	float *samples = (float*)test_alloc((count + 4) * sizeof(float),
+			state);
+
+	for (size_t i = 0; i < count + 4; i++) {
+		uint32_t pick = test_rand(state);
+
+		if (special && pick % 3 == 0)
+			samples[i] = special_samples[
+				(pick / 3) % array_size(special_samples)];
+		else
+			samples[i] = rand_sample(state);
+	}
+
+	return samples;
+}
+
+static void test_mix_count(const struct mix_kernel *kernel, size_t count,
+		size_t offset, const struct gain_ramp *ramp)
+{
+	uint32_t state = (uint32_t)(count * 31 + offset);
+	size_t   size  = (count + 4) * sizeof(float) + 64;
+	float    *src  = alloc_samples(count, false, &state);
+	float    *ref  = alloc_samples(count, false, &state);
+	float    *out  = bmalloc(size);
+
+	memcpy(out, ref, size);
+
+	mix_float_ref(ref + offset, src + offset, count,
+			ramp->gain, ramp->gain_step);
+	kernel->mix_float(out + offset, src + offset, count,
+			ramp->gain, ramp->gain_step);
+
+	long diff = test_compare((uint8_t*)ref, (uint8_t*)out, size);
+	test_check(diff < 0, "%s mix, count %zu + %zu, gain %g step %g: "
+			"differs at byte %ld", kernel->name, count, offset,
+			ramp->gain, ramp->gain_step, diff);
+
+	bfree(src);
+	bfree(ref);
+	bfree(out);
+}
+
+static void test_clamp_count(const struct mix_kernel *kernel, size_t count,
+		size_t offset)
+{
+	uint32_t state = (uint32_t)(count * 17 + offset);
+	size_t   size  = (count + 4) * sizeof(float) + 64;
+	float    *ref  = alloc_samples(count, true, &state);
+	float    *out  = bmalloc(size);
+
+	memcpy(out, ref, size);
+
+	clamp_float_ref(ref + offset, count);
+	kernel->clamp_float(out + offset, count);
+
+	long diff = test_compare((uint8_t*)ref, (uint8_t*)out, size);
+	test_check(diff < 0, "%s clamp, count %zu + %zu: differs at byte %ld",
+			kernel->name, count, offset, diff);
+
+	bfree(ref);
+	bfree(out);
+}
+
+static void test_kernel(const struct mix_kernel *kernel)
+{
+	for (size_t c = 0; c < array_size(counts); c++) {
+		for (size_t o = 0; o < array_size(offsets); o++) {
+			for (size_t r = 0; r < array_size(ramps); r++)
+				test_mix_count(kernel, counts[c], offsets[o],
+						&ramps[r]);
+
+			test_clamp_count(kernel, counts[c], offsets[o]);
+		}
+	}
+}
+
+int main(void)
+{
+	struct mix_kernel sse2 = {
+		"sse2",
+		mix_float_sse2,
+		clamp_float_sse2
+	};
+	struct mix_kernel avx2 = {
+		"avx2",
+		audio_mix_float_avx2,
+		audio_clamp_float_avx2
+	};
+	struct mix_kernel selected = {
+		"selected",
+		audio_mix_float,
+		audio_clamp_float
+	};
+
+	test_kernel(&sse2);
+	test_kernel(&selected);
+
+	if (cpu_has_feature(CPU_FEATURE_AVX2))
+		test_kernel(&avx2);
+	else
+		printf("AVX2 not supported, only checking SSE2\n");
+
+	return test_result("test-audio-mix");
+}
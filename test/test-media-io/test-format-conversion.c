@@ -0,0 +1,444 @@
+/*
+ * Checks the SSE2 and AVX2 format conversion kernels against plain scalar
+ * references, at widths that are not a multiple of the vector widths and
+ * with padded strides.  The kernels are static, so the file they are in is
+ * built as part of this one.
+ *
+ * Run with "bench" to time each kernel on 1080p frames instead.
+ */
+
+#include "test-media-io.h"
+
+#include <util/platform.h>
+
+#include <media-io/format-conversion.c>
+
+struct compress_kernel {
+	const char      *name;
+	compress_proc_t i420;
+	compress_proc_t nv12;
+};
+
+struct decompress_kernel {
+	const char               *name;
+	decompress_planar_proc_t decompress_420;
+	decompress_planar_proc_t decompress_nv12;
+	decompress_packed_proc_t decompress_422;
+};
+
+static const uint32_t compress_widths[]  = {4, 12, 20, 36, 100, 644, 1284};
+static const uint32_t compress_heights[] = {2, 6, 18, 34};
+
+/* decompression works on pixel pairs, and 4:2:2 on single rows */
+static const uint32_t decompress_widths[]  = {2, 6, 14, 30, 34, 130, 1282};
+static const uint32_t decompress_heights[] = {2, 6, 18};
+static const uint32_t packed_heights[]     = {1, 5, 17};
+
+#define array_size(a) (sizeof(a) / sizeof(a[0]))
+
+/* ------------------------------------------------------------------------- */
+/* packed 444 -> planar 420 */
+
+static void compress_ref(const uint8_t *input, uint32_t in_linesize,
+		uint32_t width, uint32_t height,
+		uint8_t *output[], const uint32_t out_linesize[], bool nv12)
+{
+	for (uint32_t y = 0; y < height; y += 2) {
+		uint8_t *lum0 = output[0] + y * out_linesize[0];
+		uint8_t *lum1 = lum0 + out_linesize[0];
+		uint8_t *ch0  = output[1] + (y/2) * out_linesize[1];
+		uint8_t *ch1  = nv12 ? ch0 + 1 :
+			output[2] + (y/2) * out_linesize[2];
+
+		for (uint32_t x = 0; x < width; x += 2) {
+			const uint8_t *p0 = input + y * in_linesize + x*4;
+			const uint8_t *p1 = p0 + in_linesize;
+			uint32_t ch_x = nv12 ? x : x/2;
+
+			lum0[x]   = p0[1];
+			lum0[x+1] = p0[5];
+			lum1[x]   = p1[1];
+			lum1[x+1] = p1[5];
+
+			ch0[ch_x] = (uint8_t)
+				((p0[0] + p0[4] + p1[0] + p1[4]) >> 2);
+			ch1[ch_x] = (uint8_t)
+				((p0[2] + p0[6] + p1[2] + p1[6]) >> 2);
+		}
+	}
+}
+
+static void test_compress_size(const struct compress_kernel *kernel,
+		uint32_t width, uint32_t height, bool nv12)
+{
+	uint32_t state        = width * 7919 + height;
+	uint32_t in_linesize  = width*4 + 48;
+	uint32_t out_linesize[3];
+	size_t   plane_size[3];
+	uint8_t  *input;
+	uint8_t  *ref[3], *out[3];
+	uint32_t split = (height / 4) * 2;
+
+	/* the kernels take the V plane to have the same stride as U */
+	out_linesize[0] = width;
+	out_linesize[1] = nv12 ? width + 6 : width/2 + 3;
+	out_linesize[2] = out_linesize[1];
+
+	plane_size[0] = (size_t)out_linesize[0] * height;
+	plane_size[1] = (size_t)out_linesize[1] * (height/2);
+	plane_size[2] = nv12 ? 0 : (size_t)out_linesize[2] * (height/2);
+
+	input = test_alloc((size_t)in_linesize * height, &state);
+
+	for (size_t i = 0; i < 3; i++) {
+		ref[i] = test_alloc(plane_size[i], &state);
+		out[i] = bmalloc(plane_size[i] + 64);
+		memcpy(out[i], ref[i], plane_size[i] + 64);
+	}
+
+	compress_ref(input, in_linesize, width, height, ref, out_linesize,
+			nv12);
+
+	/* in two slices, so a start row other than 0 is covered too */
+	compress_proc_t proc = nv12 ? kernel->nv12 : kernel->i420;
+	proc(input, in_linesize, 0, split, out, out_linesize);
+	proc(input, in_linesize, split, height, out, out_linesize);
+
+	for (size_t i = 0; i < 3; i++) {
+		long diff = test_compare(ref[i], out[i], plane_size[i] + 64);
+		test_check(diff < 0, "%s %s %ux%u: plane %d differs at %ld",
+				kernel->name, nv12 ? "nv12" : "i420",
+				width, height, (int)i, diff);
+
+		bfree(ref[i]);
+		bfree(out[i]);
+	}
+
+	bfree(input);
+}
+
+static void test_compress(const struct compress_kernel *kernel)
+{
+	for (size_t w = 0; w < array_size(compress_widths); w++) {
+		for (size_t h = 0; h < array_size(compress_heights); h++) {
+			uint32_t width  = compress_widths[w];
+			uint32_t height = compress_heights[h];
+
+			test_compress_size(kernel, width, height, false);
+			test_compress_size(kernel, width, height, true);
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* planar 420 and packed 422 -> packed 444 */
+
+static void decompress_planar_ref(const uint8_t *const input[],
+		const uint32_t in_linesize[], uint32_t width, uint32_t height,
+		uint8_t *output, uint32_t out_linesize, bool nv12)
+{
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *lum = input[0] + y * in_linesize[0];
+		const uint8_t *ch0 = input[1] + (y/2) * in_linesize[1];
+		const uint8_t *ch1 = input[2] + (y/2) * in_linesize[2];
+		uint32_t *out = (uint32_t*)(output + y * out_linesize);
+
+		for (uint32_t x = 0; x < width; x++) {
+			uint32_t u = nv12 ? ch0[x & ~1] : ch0[x/2];
+			uint32_t v = nv12 ? ch0[(x & ~1) + 1] : ch1[x/2];
+
+			out[x] = lum[x] | (u << 8) | (v << 16);
+		}
+	}
+}
+
+static void decompress_packed_ref(const uint8_t *input, uint32_t in_linesize,
+		uint32_t width, uint32_t height,
+		uint8_t *output, uint32_t out_linesize,
+		enum packed_422_order order)
+{
+	for (uint32_t y = 0; y < height; y++) {
+		uint32_t *out = (uint32_t*)(output + y * out_linesize);
+
+		for (uint32_t x = 0; x < width; x++) {
+			const uint8_t *pair = input + y * in_linesize + (x/2)*4;
+			uint32_t lum, u, v;
+
+			if (order == PACKED_422_YUYV) {
+				lum = pair[(x & 1) ? 2 : 0];
+				u   = pair[1];
+				v   = pair[3];
+			} else if (order == PACKED_422_YVYU) {
+				lum = pair[(x & 1) ? 2 : 0];
+				u   = pair[3];
+				v   = pair[1];
+			} else {
+				lum = pair[(x & 1) ? 3 : 1];
+				u   = pair[0];
+				v   = pair[2];
+			}
+
+			out[x] = lum | (u << 8) | (v << 16);
+		}
+	}
+}
+
+static void test_decompress_planar(const struct decompress_kernel *kernel,
+		uint32_t width, uint32_t height, bool nv12)
+{
+	uint32_t state        = width * 7919 + height + 1;
+	uint32_t out_linesize = width*4;
+	size_t   out_size     = (size_t)out_linesize * height;
+	uint32_t in_linesize[3];
+	uint8_t  *input[3];
+	uint8_t  *ref, *out;
+	uint32_t split = (height / 4) * 2;
+
+	/* padded, with an even stride for the 16-bit NV12 chroma pairs */
+	in_linesize[0] = width + 9;
+	in_linesize[1] = nv12 ? width + 6 : width/2 + 5;
+	in_linesize[2] = width/2 + 7;
+
+	input[0] = test_alloc((size_t)in_linesize[0] * height, &state);
+	input[1] = test_alloc((size_t)in_linesize[1] * (height/2), &state);
+	input[2] = test_alloc((size_t)in_linesize[2] * (height/2), &state);
+
+	ref = test_alloc(out_size, &state);
+	out = bmalloc(out_size + 64);
+	memcpy(out, ref, out_size + 64);
+
+	decompress_planar_ref((const uint8_t *const*)input, in_linesize,
+			width, height, ref, out_linesize, nv12);
+
+	decompress_planar_proc_t proc = nv12 ?
+		kernel->decompress_nv12 : kernel->decompress_420;
+	proc((const uint8_t *const*)input, in_linesize, 0, split,
+			out, out_linesize);
+	proc((const uint8_t *const*)input, in_linesize, split, height,
+			out, out_linesize);
+
+	long diff = test_compare(ref, out, out_size + 64);
+	test_check(diff < 0, "%s %s %ux%u: differs at %ld", kernel->name,
+			nv12 ? "nv12" : "420", width, height, diff);
+
+	for (size_t i = 0; i < 3; i++)
+		bfree(input[i]);
+	bfree(ref);
+	bfree(out);
+}
+
+static void test_decompress_packed(const struct decompress_kernel *kernel,
+		uint32_t width, uint32_t height, enum packed_422_order order)
+{
+	static const char *order_names[] = {"yuyv", "yvyu", "uyvy"};
+
+	uint32_t state        = width * 7919 + height + 2;
+	uint32_t in_linesize  = width*2 + 12;
+	uint32_t out_linesize = width*4;
+	size_t   out_size     = (size_t)out_linesize * height;
+	uint8_t  *input;
+	uint8_t  *ref, *out;
+	uint32_t split = height / 2;
+
+	input = test_alloc((size_t)in_linesize * height, &state);
+	ref   = test_alloc(out_size, &state);
+	out   = bmalloc(out_size + 64);
+	memcpy(out, ref, out_size + 64);
+
+	decompress_packed_ref(input, in_linesize, width, height,
+			ref, out_linesize, order);
+
+	kernel->decompress_422(input, in_linesize, 0, split,
+			out, out_linesize, order);
+	kernel->decompress_422(input, in_linesize, split, height,
+			out, out_linesize, order);
+
+	long diff = test_compare(ref, out, out_size + 64);
+	test_check(diff < 0, "%s %s %ux%u: differs at %ld", kernel->name,
+			order_names[order], width, height, diff);
+
+	bfree(input);
+	bfree(ref);
+	bfree(out);
+}
+
+static void test_decompress(const struct decompress_kernel *kernel)
+{
+	for (size_t w = 0; w < array_size(decompress_widths); w++) {
+		uint32_t width = decompress_widths[w];
+
+		for (size_t h = 0; h < array_size(decompress_heights); h++) {
+			uint32_t height = decompress_heights[h];
+
+			test_decompress_planar(kernel, width, height, false);
+			test_decompress_planar(kernel, width, height, true);
+		}
+
+		for (size_t h = 0; h < array_size(packed_heights); h++) {
+			uint32_t height = packed_heights[h];
+
+			test_decompress_packed(kernel, width, height,
+					PACKED_422_YUYV);
+			test_decompress_packed(kernel, width, height,
+					PACKED_422_YVYU);
+			test_decompress_packed(kernel, width, height,
+					PACKED_422_UYVY);
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* benchmark */
+
+#define BENCH_WIDTH  1920
+#define BENCH_HEIGHT 1080
+#define BENCH_FRAMES 200
+
+static void bench_print(const char *kernel, const char *name, uint64_t start)
+{
+	uint64_t ns = (os_gettime_ns() - start) / BENCH_FRAMES;
+	printf("%-6s %-6s %8.3f ms/frame\n", kernel, name,
+			(double)ns / 1000000.0);
+}
+
+static void bench_refs(void)
+{
+	const uint32_t width  = BENCH_WIDTH;
+	const uint32_t height = BENCH_HEIGHT;
+	uint32_t state = 1;
+	uint32_t packed_linesize = width*4;
+	uint32_t planar_linesize[3] = {width, width/2, width/2};
+	uint8_t  *packed = test_alloc((size_t)width*4 * height, &state);
+	uint8_t  *planar = test_alloc((size_t)width * height * 2, &state);
+	uint8_t  *planes[3];
+	uint64_t start;
+
+	planes[0] = planar;
+	planes[1] = planar + width * height;
+	planes[2] = planes[1] + width * height / 2;
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_FRAMES; i++)
+		compress_ref(packed, packed_linesize, width, height,
+				planes, planar_linesize, false);
+	bench_print("scalar", "i420", start);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_FRAMES; i++)
+		decompress_planar_ref((const uint8_t *const*)planes,
+				planar_linesize, width, height,
+				packed, packed_linesize, false);
+	bench_print("scalar", "420", start);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_FRAMES; i++)
+		decompress_packed_ref(planar, width*2, width, height,
+				packed, packed_linesize, PACKED_422_YUYV);
+	bench_print("scalar", "422", start);
+
+	bfree(packed);
+	bfree(planar);
+}
+
+static void bench_kernels(const struct compress_kernel *compress,
+		const struct decompress_kernel *decompress)
+{
+	const uint32_t width  = BENCH_WIDTH;
+	const uint32_t height = BENCH_HEIGHT;
+	uint32_t state = 1;
+	uint32_t packed_linesize = width*4;
+	uint32_t planar_linesize[3] = {width, width/2, width/2};
+	uint32_t nv12_linesize[3]   = {width, width, 0};
+	uint8_t  *packed = test_alloc((size_t)width*4 * height, &state);
+	uint8_t  *planar = test_alloc((size_t)width * height * 2, &state);
+	uint8_t  *planes[3];
+	uint64_t start;
+
+	planes[0] = planar;
+	planes[1] = planar + width * height;
+	planes[2] = planes[1] + width * height / 2;
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_FRAMES; i++)
+		compress->i420(packed, packed_linesize, 0, height,
+				planes, planar_linesize);
+	bench_print(compress->name, "i420", start);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_FRAMES; i++)
+		compress->nv12(packed, packed_linesize, 0, height,
+				planes, nv12_linesize);
+	bench_print(compress->name, "nv12", start);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_FRAMES; i++)
+		decompress->decompress_420((const uint8_t *const*)planes,
+				planar_linesize, 0, height,
+				packed, packed_linesize);
+	bench_print(decompress->name, "420", start);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_FRAMES; i++)
+		decompress->decompress_nv12((const uint8_t *const*)planes,
+				nv12_linesize, 0, height,
+				packed, packed_linesize);
+	bench_print(decompress->name, "nv12", start);
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_FRAMES; i++)
+		decompress->decompress_422(planar, width*2, 0, height,
+				packed, packed_linesize, PACKED_422_YUYV);
+	bench_print(decompress->name, "422", start);
+
+	bfree(packed);
+	bfree(planar);
+}
+
+/* ------------------------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+	struct compress_kernel sse2 = {
+		"sse2",
+		compress_uyvx_to_i420_sse2,
+		compress_uyvx_to_nv12_sse2
+	};
+	struct compress_kernel avx2 = {
+		"avx2",
+		compress_uyvx_to_i420_avx2,
+		compress_uyvx_to_nv12_avx2
+	};
+	struct decompress_kernel sse2_d = {
+		"sse2",
+		decompress_420_sse2,
+		decompress_nv12_sse2,
+		decompress_422_sse2
+	};
+	struct decompress_kernel avx2_d = {
+		"avx2",
+		decompress_420_avx2,
+		decompress_nv12_avx2,
+		decompress_422_avx2
+	};
+	bool has_avx2 = cpu_has_feature(CPU_FEATURE_AVX2);
+
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		bench_refs();
+		bench_kernels(&sse2, &sse2_d);
+		if (has_avx2)
+			bench_kernels(&avx2, &avx2_d);
+		return 0;
+	}
+
+	test_compress(&sse2);
+	test_decompress(&sse2_d);
+
+	if (has_avx2) {
+		test_compress(&avx2);
+		test_decompress(&avx2_d);
+	} else {
+		printf("AVX2 not supported, only checking SSE2\n");
+	}
+
+	return test_result("test-format-conversion");
+}
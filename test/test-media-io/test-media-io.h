@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/bmem.h>
+
+/*
+ * Shared helpers for the media-io test programs.  Each program returns
+ * nonzero if any check failed, so they can be run with ctest.
+ */
+
+static int test_failures = 0;
+
+#define test_check(cond, ...) \
+do { \
+	if (!(cond)) { \
+		printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+		printf(__VA_ARGS__); \
+		printf("\n"); \
+		test_failures++; \
+	} \
+} while (false)
+
+static inline int test_result(const char *name)
+{
+	if (bnum_allocs() != 0) {
+		printf("FAIL %s: %ld allocations leaked\n", name,
+				bnum_allocs());
+		test_failures++;
+	}
+
+	printf("%s: %s\n", name, test_failures ? "FAILED" : "passed");
+	return test_failures ? 1 : 0;
+}
+
+/* deterministic, so a failure can be reproduced */
+static inline uint32_t test_rand(uint32_t *state)
+{
+	*state = *state * 1664525 + 1013904223;
+	return *state >> 8;
+}
+
+static inline void test_fill(uint8_t *data, size_t size, uint32_t *state)
+{
+	for (size_t i = 0; i < size; i++)
+		data[i] = (uint8_t)test_rand(state);
+}
+
+/* 32-byte aligned, with a guard of random bytes after size */
+static inline uint8_t *test_alloc(size_t size, uint32_t *state)
+{
+	uint8_t *data = bmalloc(size + 64);
+	test_fill(data, size + 64, state);
+	return data;
+}
+
+/* returns the index of the first differing byte, or -1 */
+static inline long test_compare(const uint8_t *a, const uint8_t *b,
+		size_t size)
+{
+	for (size_t i = 0; i < size; i++) {
+		if (a[i] != b[i])
+			return (long)i;
+	}
+
+	return -1;
+}
@@ -0,0 +1,227 @@
+/*
+ * Checks that converting a frame in bands across a slice pool gives the
+ * same bytes as converting it in one call on one thread, and that a run
+ * covers every row exactly once.
+ */
+
+#include "test-media-io.h"
+
+#include <media-io/format-conversion.h>
+#include <media-io/slice-pool.h>
+#include <util/threading.h>
+
+struct test_size {
+	uint32_t width;
+	uint32_t height;
+};
+
+static const struct test_size sizes[] = {
+	{1920, 1080},
+	{1280,  720},
+	{ 644,  362},
+	{  64,   18},
+};
+
+static const uint32_t thread_counts[] = {1, 2, 3, 4, 8};
+
+#define array_size(a) (sizeof(a) / sizeof(a[0]))
+
+struct convert_job {
+	const uint8_t *packed;
+	uint32_t      packed_linesize;
+	uint8_t       *planes[3];
+	uint32_t      linesize[3];
+	bool          nv12;
+};
+
+static void compress_slice(void *param, uint32_t start_y, uint32_t end_y)
+{
+	struct convert_job *job = param;
+
+	if (job->nv12)
+		compress_uyvx_to_nv12(job->packed, job->packed_linesize,
+				start_y, end_y, job->planes, job->linesize);
+	else
+		compress_uyvx_to_i420(job->packed, job->packed_linesize,
+				start_y, end_y, job->planes, job->linesize);
+}
+
+struct unpack_job {
+	const uint8_t *planes[3];
+	uint32_t      linesize[3];
+	uint8_t       *packed;
+	uint32_t      packed_linesize;
+	bool          nv12;
+};
+
+static void decompress_slice(void *param, uint32_t start_y, uint32_t end_y)
+{
+	struct unpack_job *job = param;
+
+	if (job->nv12)
+		decompress_nv12(job->planes, job->linesize, start_y, end_y,
+				job->packed, job->packed_linesize);
+	else
+		decompress_420(job->planes, job->linesize, start_y, end_y,
+				job->packed, job->packed_linesize);
+}
+
+static void test_compress(slice_pool_t pool, uint32_t width, uint32_t height,
+		bool nv12)
+{
+	uint32_t state    = width + height;
+	size_t   out_size = (size_t)width * height * 3 / 2;
+	uint8_t  *single  = test_alloc(out_size, &state);
+	uint8_t  *pooled  = bmalloc(out_size + 64);
+	struct convert_job job;
+
+	memcpy(pooled, single, out_size + 64);
+
+	job.packed_linesize = width*4;
+	job.packed = test_alloc((size_t)job.packed_linesize * height, &state);
+	job.nv12   = nv12;
+	job.linesize[0] = width;
+	job.linesize[1] = nv12 ? width : width/2;
+	job.linesize[2] = width/2;
+
+	job.planes[0] = single;
+	job.planes[1] = single + width * height;
+	job.planes[2] = job.planes[1] + width * height / 4;
+	slice_pool_run(NULL, compress_slice, &job, height, 2);
+
+	job.planes[0] = pooled;
+	job.planes[1] = pooled + width * height;
+	job.planes[2] = job.planes[1] + width * height / 4;
+	slice_pool_run(pool, compress_slice, &job, height, 2);
+
+	long diff = test_compare(single, pooled, out_size + 64);
+	test_check(diff < 0, "%u threads, %s %ux%u: differs at %ld",
+			slice_pool_num_threads(pool), nv12 ? "nv12" : "i420",
+			width, height, diff);
+
+	bfree((void*)job.packed);
+	bfree(single);
+	bfree(pooled);
+}
+
+static void test_decompress(slice_pool_t pool, uint32_t width,
+		uint32_t height, bool nv12)
+{
+	uint32_t state    = width + height + 1;
+	size_t   out_size = (size_t)width*4 * height;
+	uint8_t  *single  = test_alloc(out_size, &state);
+	uint8_t  *pooled  = bmalloc(out_size + 64);
+	uint8_t  *planar  = test_alloc((size_t)width * height * 3 / 2, &state);
+	struct unpack_job job;
+
+	memcpy(pooled, single, out_size + 64);
+
+	job.planes[0] = planar;
+	job.planes[1] = planar + width * height;
+	job.planes[2] = job.planes[1] + width * height / 4;
+	job.linesize[0] = width;
+	job.linesize[1] = nv12 ? width : width/2;
+	job.linesize[2] = width/2;
+	job.packed_linesize = width*4;
+	job.nv12 = nv12;
+
+	job.packed = single;
+	slice_pool_run(NULL, decompress_slice, &job, height, 2);
+	job.packed = pooled;
+	slice_pool_run(pool, decompress_slice, &job, height, 2);
+
+	long diff = test_compare(single, pooled, out_size + 64);
+	test_check(diff < 0, "%u threads, unpack %s %ux%u: differs at %ld",
+			slice_pool_num_threads(pool), nv12 ? "nv12" : "420",
+			width, height, diff);
+
+	bfree(planar);
+	bfree(single);
+	bfree(pooled);
+}
+
+/* ------------------------------------------------------------------------- */
+
+#define MAX_BANDS 16
+
+struct band_job {
+	uint32_t        height;
+	uint32_t        align;
+	volatile long   *row_visits;
+	volatile long   band_used[MAX_BANDS];
+	volatile long   bad_band;
+	volatile long   bad_align;
+};
+
+static void band_slice(void *param, uint32_t band, uint32_t start_y,
+		uint32_t end_y)
+{
+	struct band_job *job = param;
+
+	if (band >= MAX_BANDS || os_atomic_inc_long(&job->band_used[band]) != 1)
+		os_atomic_inc_long(&job->bad_band);
+	if (start_y % job->align != 0)
+		os_atomic_inc_long(&job->bad_align);
+
+	for (uint32_t y = start_y; y < end_y; y++)
+		os_atomic_inc_long(&job->row_visits[y]);
+}
+
+static void test_bands(slice_pool_t pool, uint32_t height, uint32_t align)
+{
+	struct band_job job;
+	uint32_t missed = 0;
+
+	memset(&job, 0, sizeof(job));
+	job.height     = height;
+	job.align      = align;
+	job.row_visits = bzalloc(sizeof(long) * height);
+
+	slice_pool_run_bands(pool, band_slice, &job, height, align);
+
+	for (uint32_t y = 0; y < height; y++) {
+		if (job.row_visits[y] != 1)
+			missed++;
+	}
+
+	test_check(missed == 0, "%u threads, height %u: %u rows not run once",
+			slice_pool_num_threads(pool), height, missed);
+	test_check(job.bad_band == 0, "%u threads, height %u: band reused",
+			slice_pool_num_threads(pool), height);
+	test_check(job.bad_align == 0, "%u threads, height %u: misaligned",
+			slice_pool_num_threads(pool), height);
+
+	bfree((void*)job.row_visits);
+}
+
+int main(void)
+{
+	for (size_t t = 0; t < array_size(thread_counts); t++) {
+		slice_pool_t pool;
+
+		if (slice_pool_create(&pool, thread_counts[t]) !=
+				SLICE_POOL_SUCCESS) {
+			test_check(false, "could not create a pool of %u",
+					thread_counts[t]);
+			continue;
+		}
+
+		for (size_t i = 0; i < array_size(sizes); i++) {
+			uint32_t width  = sizes[i].width;
+			uint32_t height = sizes[i].height;
+
+			test_compress(pool, width, height, false);
+			test_compress(pool, width, height, true);
+			test_decompress(pool, width, height, false);
+			test_decompress(pool, width, height, true);
+		}
+
+		test_bands(pool, 1080, 2);
+		test_bands(pool, 17, 1);
+		test_bands(pool, 97, 4);
+
+		slice_pool_destroy(pool);
+	}
+
+	return test_result("test-slice-pool");
+}
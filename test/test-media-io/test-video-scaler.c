@@ -0,0 +1,359 @@
+/*
+ * Checks the native scaler against a floating point reference of the same
+ * filters: bilinear sampling at pixel centers, and a box average for
+ * integer area factors.  The native scaler works in fixed point with 8-bit
+ * weights, and the UYVX path rounds before subsampling chroma, so each
+ * output value may be one level off the rounded reference.  Scaling on a
+ * pool must give the same bytes as scaling on one thread.
+ */
+
+#include "test-media-io.h"
+
+#include <math.h>
+#include <media-io/video-scaler-native.h>
+
+#define BILINEAR_TOLERANCE 1
+#define AREA_TOLERANCE     1
+
+struct scale_case {
+	uint32_t src_width, src_height;
+	uint32_t dst_width, dst_height;
+	bool     area;
+};
+
+static const struct scale_case cases[] = {
+	/* bilinear 2:1, which has its own horizontal pass */
+	{1920, 1080,  960,  540, false},
+	/* bilinear, non-integer factors and an upscale */
+	{1920, 1080, 1280,  720, false},
+	{1000,  562,  642,  362, false},
+	{ 640,  360, 1280,  720, false},
+	/* area 3:1 to 8:1 */
+	{ 288,  162,   96,   54, true},
+	{ 384,  216,   96,   54, true},
+	{ 480,  270,   96,   54, true},
+	{ 576,  324,   96,   54, true},
+	{ 672,  378,   96,   54, true},
+	{ 768,  432,   96,   54, true},
+};
+
+#define array_size(a) (sizeof(a) / sizeof(a[0]))
+
+/* ------------------------------------------------------------------------- */
+/* reference */
+
+static double sample_bilinear(const uint8_t *plane, uint32_t linesize,
+		uint32_t channels, uint32_t c, uint32_t src_width,
+		uint32_t src_height, double fx, double fy)
+{
+	uint32_t x0, y0, x1, y1;
+	double   wx, wy;
+	double   top, bottom;
+
+	fx = fx < 0.0 ? 0.0 : fx;
+	fy = fy < 0.0 ? 0.0 : fy;
+
+	x0 = (uint32_t)fx;
+	y0 = (uint32_t)fy;
+	if (x0 > src_width  - 1) x0 = src_width  - 1;
+	if (y0 > src_height - 1) y0 = src_height - 1;
+	x1 = x0 + 1 < src_width  ? x0 + 1 : x0;
+	y1 = y0 + 1 < src_height ? y0 + 1 : y0;
+	wx = x1 == x0 ? 0.0 : fx - x0;
+	wy = y1 == y0 ? 0.0 : fy - y0;
+
+#define px(x, y) ((double)plane[(y) * linesize + (x) * channels + c])
+	top    = px(x0, y0) * (1.0 - wx) + px(x1, y0) * wx;
+	bottom = px(x0, y1) * (1.0 - wx) + px(x1, y1) * wx;
+#undef px
+
+	return top * (1.0 - wy) + bottom * wy;
+}
+
+static double sample_area(const uint8_t *plane, uint32_t linesize,
+		uint32_t channels, uint32_t c, uint32_t x, uint32_t y,
+		uint32_t fx, uint32_t fy)
+{
+	double sum = 0.0;
+
+	for (uint32_t j = 0; j < fy; j++)
+		for (uint32_t i = 0; i < fx; i++)
+			sum += plane[(y*fy + j) * linesize +
+				(x*fx + i) * channels + c];
+
+	return sum / (double)(fx * fy);
+}
+
+/* scales one channel of a plane to doubles */
+static void scale_ref(double *dst, const uint8_t *src, uint32_t linesize,
+		uint32_t channels, uint32_t c,
+		uint32_t src_width, uint32_t src_height,
+		uint32_t dst_width, uint32_t dst_height, bool area)
+{
+	double rx = (double)src_width  / (double)dst_width;
+	double ry = (double)src_height / (double)dst_height;
+
+	for (uint32_t y = 0; y < dst_height; y++) {
+		for (uint32_t x = 0; x < dst_width; x++) {
+			double val;
+
+			if (area)
+				val = sample_area(src, linesize, channels, c,
+						x, y, src_width / dst_width,
+						src_height / dst_height);
+			else
+				val = sample_bilinear(src, linesize, channels,
+						c, src_width, src_height,
+						(x + 0.5) * rx - 0.5,
+						(y + 0.5) * ry - 0.5);
+
+			dst[y * dst_width + x] = val;
+		}
+	}
+}
+
+static inline uint8_t round_ref(double val)
+{
+	return (uint8_t)floor(val + 0.5);
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct frame {
+	uint8_t  *data;
+	uint8_t  *planes[3];
+	uint32_t linesize[3];
+	size_t   size;
+};
+
+static void frame_init(struct frame *frame, enum video_format format,
+		uint32_t width, uint32_t height, uint32_t *state)
+{
+	uint32_t pad = 12;
+
+	frame->linesize[0] = width + pad;
+	frame->linesize[1] = format == VIDEO_FORMAT_NV12 ?
+		width + pad : width/2 + pad;
+	frame->linesize[2] = format == VIDEO_FORMAT_NV12 ? 0 : width/2 + pad;
+
+	frame->size = (size_t)frame->linesize[0] * height +
+		(size_t)(frame->linesize[1] + frame->linesize[2]) * height/2;
+	frame->data = test_alloc(frame->size, state);
+
+	frame->planes[0] = frame->data;
+	frame->planes[1] = frame->planes[0] + frame->linesize[0] * height;
+	frame->planes[2] = frame->planes[1] + frame->linesize[1] * height/2;
+}
+
+static void frame_free(struct frame *frame)
+{
+	bfree(frame->data);
+}
+
+/* returns the largest difference from the reference */
+static int check_plane(const uint8_t *plane, uint32_t linesize,
+		uint32_t channels, uint32_t c, const double *ref,
+		uint32_t width, uint32_t height)
+{
+	int max_diff = 0;
+
+	for (uint32_t y = 0; y < height; y++) {
+		for (uint32_t x = 0; x < width; x++) {
+			int val  = plane[y * linesize + x * channels + c];
+			int diff = abs(val - round_ref(ref[y * width + x]));
+
+			if (diff > max_diff)
+				max_diff = diff;
+		}
+	}
+
+	return max_diff;
+}
+
+static int check_planar(const struct scale_case *sc, enum video_format format,
+		const struct frame *src, const struct frame *dst)
+{
+	uint32_t dst_w2 = sc->dst_width / 2, dst_h2 = sc->dst_height / 2;
+	double   *ref   = bmalloc(sizeof(double) *
+			sc->dst_width * sc->dst_height);
+	int      max_diff;
+	int      diff;
+
+	scale_ref(ref, src->planes[0], src->linesize[0], 1, 0,
+			sc->src_width, sc->src_height,
+			sc->dst_width, sc->dst_height, sc->area);
+	max_diff = check_plane(dst->planes[0], dst->linesize[0], 1, 0, ref,
+			sc->dst_width, sc->dst_height);
+
+	for (uint32_t i = 0; i < 2; i++) {
+		bool     nv12     = format == VIDEO_FORMAT_NV12;
+		uint32_t plane    = nv12 ? 1 : 1 + i;
+		uint32_t channels = nv12 ? 2 : 1;
+		uint32_t c        = nv12 ? i : 0;
+
+		scale_ref(ref, src->planes[plane], src->linesize[plane],
+				channels, c, sc->src_width / 2,
+				sc->src_height / 2, dst_w2, dst_h2, sc->area);
+		diff = check_plane(dst->planes[plane], dst->linesize[plane],
+				channels, c, ref, dst_w2, dst_h2);
+		if (diff > max_diff)
+			max_diff = diff;
+	}
+
+	bfree(ref);
+	return max_diff;
+}
+
+/* the UYVX image is scaled at full resolution, then subsampled 2x2 */
+static int check_uyvx(const struct scale_case *sc, enum video_format format,
+		const uint8_t *image, uint32_t image_linesize,
+		const struct frame *dst)
+{
+	uint32_t w    = sc->dst_width, h = sc->dst_height;
+	double   *ref = bmalloc(sizeof(double) * w * h);
+	int      max_diff;
+	int      diff;
+
+	scale_ref(ref, image, image_linesize, 4, 1,
+			sc->src_width, sc->src_height, w, h, sc->area);
+	max_diff = check_plane(dst->planes[0], dst->linesize[0], 1, 0, ref,
+			w, h);
+
+	for (uint32_t i = 0; i < 2; i++) {
+		bool     nv12     = format == VIDEO_FORMAT_NV12;
+		uint32_t plane    = nv12 ? 1 : 1 + i;
+		uint32_t channels = nv12 ? 2 : 1;
+		uint32_t c        = nv12 ? i : 0;
+		double   *sub     = bmalloc(sizeof(double) * (w/2) * (h/2));
+
+		/* U is the first byte of a UYVX pixel, V the third */
+		scale_ref(ref, image, image_linesize, 4, i * 2,
+				sc->src_width, sc->src_height, w, h, sc->area);
+
+		for (uint32_t y = 0; y < h/2; y++)
+			for (uint32_t x = 0; x < w/2; x++)
+				sub[y * (w/2) + x] = (
+					ref[(y*2)   * w + x*2] +
+					ref[(y*2)   * w + x*2 + 1] +
+					ref[(y*2+1) * w + x*2] +
+					ref[(y*2+1) * w + x*2 + 1]) / 4.0;
+
+		diff = check_plane(dst->planes[plane], dst->linesize[plane],
+				channels, c, sub, w/2, h/2);
+		if (diff > max_diff)
+			max_diff = diff;
+
+		bfree(sub);
+	}
+
+	bfree(ref);
+	return max_diff;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static struct native_scaler *create_scaler(const struct scale_case *sc,
+		enum video_format format, bool uyvx, slice_pool_t pool)
+{
+	struct video_scale_info src = {
+		format, sc->src_width, sc->src_height, false, VIDEO_CS_601
+	};
+	struct video_scale_info dst = {
+		format, sc->dst_width, sc->dst_height, false, VIDEO_CS_601
+	};
+	enum video_scale_type type = VIDEO_SCALE_FAST_BILINEAR;
+
+	return uyvx ?
+		native_scaler_create_uyvx(&dst, &src, type, pool) :
+		native_scaler_create(&dst, &src, type, pool);
+}
+
+static void test_case(const struct scale_case *sc, enum video_format format,
+		bool uyvx, slice_pool_t pool)
+{
+	const char *format_name = format == VIDEO_FORMAT_NV12 ? "nv12" : "i420";
+	uint32_t   state = sc->src_width * 31 + sc->dst_width;
+	struct native_scaler *scaler = create_scaler(sc, format, uyvx, NULL);
+	struct native_scaler *pooled = create_scaler(sc, format, uyvx, pool);
+	struct frame src, dst, dst_pooled;
+	uint32_t   image_linesize = sc->src_width * 4 + 16;
+	uint8_t    *image = NULL;
+	int        tolerance = sc->area ? AREA_TOLERANCE : BILINEAR_TOLERANCE;
+	int        max_diff;
+
+	test_check(scaler && pooled, "%s%s %ux%u -> %ux%u: not supported",
+			uyvx ? "uyvx to " : "", format_name,
+			sc->src_width, sc->src_height,
+			sc->dst_width, sc->dst_height);
+	if (!scaler || !pooled) {
+		native_scaler_destroy(scaler);
+		native_scaler_destroy(pooled);
+		return;
+	}
+
+	frame_init(&src, format, sc->src_width, sc->src_height, &state);
+	frame_init(&dst, format, sc->dst_width, sc->dst_height, &state);
+	frame_init(&dst_pooled, format, sc->dst_width, sc->dst_height, &state);
+	memcpy(dst_pooled.data, dst.data, dst.size + 64);
+
+	if (uyvx) {
+		const uint8_t *input = image = test_alloc(
+				(size_t)image_linesize * sc->src_height,
+				&state);
+
+		native_scaler_scale(scaler, dst.planes, dst.linesize,
+				&input, &image_linesize);
+		native_scaler_scale(pooled, dst_pooled.planes,
+				dst_pooled.linesize, &input, &image_linesize);
+		max_diff = check_uyvx(sc, format, image, image_linesize, &dst);
+
+	} else {
+		const uint8_t *const *input =
+			(const uint8_t *const*)src.planes;
+
+		native_scaler_scale(scaler, dst.planes, dst.linesize,
+				input, src.linesize);
+		native_scaler_scale(pooled, dst_pooled.planes,
+				dst_pooled.linesize, input, src.linesize);
+		max_diff = check_planar(sc, format, &src, &dst);
+	}
+
+	test_check(max_diff <= tolerance,
+			"%s%s %ux%u -> %ux%u: off by %d, tolerance %d",
+			uyvx ? "uyvx to " : "", format_name,
+			sc->src_width, sc->src_height,
+			sc->dst_width, sc->dst_height, max_diff, tolerance);
+
+	long diff = test_compare(dst.data, dst_pooled.data, dst.size + 64);
+	test_check(diff < 0, "%s%s %ux%u -> %ux%u: pooled differs at %ld",
+			uyvx ? "uyvx to " : "", format_name,
+			sc->src_width, sc->src_height,
+			sc->dst_width, sc->dst_height, diff);
+
+	bfree(image);
+	frame_free(&src);
+	frame_free(&dst);
+	frame_free(&dst_pooled);
+	native_scaler_destroy(scaler);
+	native_scaler_destroy(pooled);
+}
+
+int main(void)
+{
+	slice_pool_t pool;
+
+	if (slice_pool_create(&pool, 4) != SLICE_POOL_SUCCESS) {
+		printf("could not create a slice pool\n");
+		return 1;
+	}
+
+	for (size_t i = 0; i < array_size(cases); i++) {
+		test_case(&cases[i], VIDEO_FORMAT_I420, false, pool);
+		test_case(&cases[i], VIDEO_FORMAT_NV12, false, pool);
+		test_case(&cases[i], VIDEO_FORMAT_I420, true,  pool);
+		test_case(&cases[i], VIDEO_FORMAT_NV12, true,  pool);
+	}
+
+	slice_pool_destroy(pool);
+	return test_result("test-video-scaler");
+}